@@ -33,6 +33,19 @@ void cMarkAdAudio::Clear()
     channels=0;
 }
 
+void cMarkAdAudio::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&framelast,sizeof(framelast));
+    Ckp->Put(&channels,sizeof(channels));
+}
+
+bool cMarkAdAudio::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Get(&framelast,sizeof(framelast));
+    Ckp->Get(&channels,sizeof(channels));
+    return !Ckp->Error();
+}
+
 void cMarkAdAudio::resetmark()
 {
     if (!mark.Type) return;
@@ -9,6 +9,7 @@
 #define __audio_h_
 
 #include "global.h"
+#include "checkpoint.h"
 
 class cMarkAdAudio
 {
@@ -26,6 +27,12 @@ public:
     ~cMarkAdAudio();
     MarkAdMark *Process(int FrameNumber, int FrameNumberBefore);
     void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdAudio *Other)
+    {
+        return ((channels==Other->channels) && (framelast==Other->framelast));
+    }
 };
 
 #endif
@@ -0,0 +1,171 @@
+/*
+ * checkpoint.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "checkpoint.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+#define CKP_MAGIC 0x504b434d // "MCKP"
+
+cMarkAdCheckpoint::cMarkAdCheckpoint(const char *Directory)
+{
+    f=NULL;
+    error=false;
+    mem=NULL;
+    memsize=0;
+    filename=tmpname=NULL;
+    if (!Directory) return;
+    if (asprintf(&filename,"%s/%s",Directory,CKP_FILE)==-1) filename=NULL;
+    if (asprintf(&tmpname,"%s/%s.tmp",Directory,CKP_FILE)==-1) tmpname=NULL;
+}
+
+cMarkAdCheckpoint::~cMarkAdCheckpoint()
+{
+    Close();
+    if (tmpname)
+    {
+        unlink(tmpname);
+        free(tmpname);
+    }
+    if (filename) free(filename);
+    if (mem) free(mem);
+}
+
+bool cMarkAdCheckpoint::Create()
+{
+    Close();
+    if (filename)
+    {
+        if (!tmpname) return false;
+        f=fopen(tmpname,"w");
+        if (!f)
+        {
+            esyslog("failed to create %s (%i)",tmpname,errno);
+            return false;
+        }
+    }
+    else
+    {
+        if (mem) free(mem);
+        mem=NULL;
+        memsize=0;
+        f=open_memstream(&mem,&memsize);
+        if (!f) return false;
+    }
+    error=false;
+    int magic=CKP_MAGIC;
+    Put(&magic,sizeof(magic));
+    int version=CKP_VERSION;
+    Put(&version,sizeof(version));
+    return true;
+}
+
+bool cMarkAdCheckpoint::Commit()
+{
+    if (!f) return false;
+    if (fclose(f)) error=true;
+    f=NULL;
+    if (!filename) return !error;
+    if ((error) || (rename(tmpname,filename)==-1))
+    {
+        esyslog("failed to write %s",filename);
+        unlink(tmpname);
+        return false;
+    }
+    return true;
+}
+
+bool cMarkAdCheckpoint::Open()
+{
+    Close();
+    if (filename)
+    {
+        f=fopen(filename,"r");
+    }
+    else
+    {
+        f=(mem) ? fmemopen(mem,memsize,"r") : NULL;
+    }
+    if (!f) return false;
+    error=false;
+    int magic=0,version=0;
+    if ((!Get(&magic,sizeof(magic))) || (magic!=CKP_MAGIC) ||
+            (!Get(&version,sizeof(version))) || (version!=CKP_VERSION))
+    {
+        if (magic==CKP_MAGIC) isyslog("ignoring checkpoint of layout %i",version);
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void cMarkAdCheckpoint::Close()
+{
+    if (f) fclose(f);
+    f=NULL;
+}
+
+void cMarkAdCheckpoint::Remove()
+{
+    Close();
+    if (filename) unlink(filename);
+}
+
+void cMarkAdCheckpoint::Put(const void *Data, size_t Size)
+{
+    if ((!f) || (error)) return;
+    if (fwrite(Data,1,Size,f)!=Size) error=true;
+}
+
+void cMarkAdCheckpoint::PutString(const char *String)
+{
+    int len=String ? strlen(String) : -1;
+    Put(&len,sizeof(len));
+    if (len>0) Put(String,len);
+}
+
+bool cMarkAdCheckpoint::Get(void *Data, size_t Size)
+{
+    if ((!f) || (error)) return false;
+    if (fread(Data,1,Size,f)!=Size) error=true;
+    return !error;
+}
+
+char *cMarkAdCheckpoint::GetString()
+{
+    // returns NULL on error or for NULL strings, see Error()
+    int len;
+    if (!Get(&len,sizeof(len))) return NULL;
+    if (len<0) return NULL;
+    if (len>4096)
+    {
+        error=true;
+        return NULL;
+    }
+    char *buf=(char *) malloc(len+1);
+    if (!buf)
+    {
+        error=true;
+        return NULL;
+    }
+    if (!Get(buf,len))
+    {
+        free(buf);
+        return NULL;
+    }
+    buf[len]=0;
+    return buf;
+}
@@ -0,0 +1,50 @@
+/*
+ * checkpoint.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __checkpoint_h_
+#define __checkpoint_h_
+
+#include <stdio.h>
+
+#define CKP_FILE "markad.ckp"
+#define CKP_INTERVAL 30 // seconds between checkpoints
+#define CKP_VERSION 5   // layout, increase on every change of what is saved
+
+// --- cMarkAdCheckpoint
+// state of the first pass at an iframe, so an aborted markad can
+// continue there. Written to a temporary file and renamed, so there
+// is always a complete checkpoint. Only valid for the same version
+// and layout (CKP_VERSION).
+// Without a directory the checkpoint is kept in memory.
+class cMarkAdCheckpoint
+{
+private:
+    char *filename;
+    char *tmpname;
+    char *mem;
+    size_t memsize;
+    FILE *f;
+    bool error;
+public:
+    cMarkAdCheckpoint(const char *Directory=NULL);
+    ~cMarkAdCheckpoint();
+    bool Create();
+    bool Commit();
+    bool Open();
+    void Close();
+    void Remove();
+    void Put(const void *Data, size_t Size);
+    void PutString(const char *String);
+    bool Get(void *Data, size_t Size);
+    char *GetString();
+    bool Error()
+    {
+        return error;
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * columns.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "columns.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdColumns::cMarkAdColumns()
+{
+    count=max=0;
+    iframe=NULL;
+    aspect=NULL;
+    channels=NULL;
+}
+
+cMarkAdColumns::~cMarkAdColumns()
+{
+    if (iframe) free(iframe);
+    if (aspect) free(aspect);
+    if (channels) free(channels);
+}
+
+void cMarkAdColumns::Clear()
+{
+    count=0;
+}
+
+bool cMarkAdColumns::grow()
+{
+    int nmax=max ? max*2 : 4096;
+    int *ni=(int *) realloc(iframe,nmax*sizeof(int));
+    if (ni) iframe=ni;
+    short *na=(short *) realloc(aspect,nmax*sizeof(short));
+    if (na) aspect=na;
+    unsigned char *nc=(unsigned char *) realloc(channels,nmax);
+    if (nc) channels=nc;
+    if ((!ni) || (!na) || (!nc))
+    {
+        esyslog("out of memory");
+        return false;
+    }
+    max=nmax;
+    return true;
+}
+
+bool cMarkAdColumns::Append(int IFrame, const MarkAdAspectRatio *AspectRatio, int Channels)
+{
+    if (!AspectRatio) return false;
+    if ((count) && (IFrame<=iframe[count-1])) return false;
+    if ((count>=max) && (!grow())) return false;
+
+    iframe[count]=IFrame;
+    aspect[count]=(short) (((AspectRatio->Num & 0xFF)<<8)|(AspectRatio->Den & 0xFF));
+    channels[count]=(unsigned char) Channels;
+    count++;
+    return true;
+}
+
+void cMarkAdColumns::SetChannels(int Channels)
+{
+    // audio is processed after the picture of the iframe
+    if (count) channels[count-1]=(unsigned char) Channels;
+}
+
+int cMarkAdColumns::Find(int FrameNumber)
+{
+    // last row at or before FrameNumber, -1 if there is none
+    int lo=0,hi=count-1,ret=-1;
+    while (lo<=hi)
+    {
+        int mid=(lo+hi)/2;
+        if (iframe[mid]<=FrameNumber)
+        {
+            ret=mid;
+            lo=mid+1;
+        }
+        else
+        {
+            hi=mid-1;
+        }
+    }
+    return ret;
+}
+
+bool cMarkAdColumns::Range(int From, int To, int *First, int *Last)
+{
+    if ((!count) || (From>To)) return false;
+    int last=Find(To);
+    if (last==-1) return false;
+    int first=Find(From-1)+1;
+    if (first>last) return false;
+    if (First) *First=first;
+    if (Last) *Last=last;
+    return true;
+}
+
+int cMarkAdColumns::dominant(const short *Column, int First, int Last)
+{
+    // most frequent value (0 is unknown), there are only a few
+    // different values, so a short table is enough
+#define MAXVALUES 8
+    short value[MAXVALUES];
+    int cnt[MAXVALUES];
+    int values=0;
+    for (int i=First; i<=Last; i++)
+    {
+        if (!Column[i]) continue;
+        int v;
+        for (v=0; v<values; v++)
+        {
+            if (value[v]==Column[i]) break;
+        }
+        if (v==values)
+        {
+            if (values==MAXVALUES) continue;
+            value[v]=Column[i];
+            cnt[v]=0;
+            values++;
+        }
+        cnt[v]++;
+    }
+    int ret=0,best=0;
+    for (int v=0; v<values; v++)
+    {
+        if (cnt[v]>best)
+        {
+            best=cnt[v];
+            ret=value[v];
+        }
+    }
+    return ret;
+}
+
+bool cMarkAdColumns::Aspect(int From, int To, MarkAdAspectRatio *AspectRatio)
+{
+    int first,last;
+    if (!Range(From,To,&first,&last)) return false;
+    int a=dominant(aspect,first,last);
+    if (!a) return false;
+    if (AspectRatio)
+    {
+        AspectRatio->Num=a>>8;
+        AspectRatio->Den=a & 0xFF;
+    }
+    return true;
+}
+
+int cMarkAdColumns::Channels(int From, int To)
+{
+    int first,last;
+    if (!Range(From,To,&first,&last)) return 0;
+    int cnt[256];
+    memset(cnt,0,sizeof(cnt));
+    for (int i=first; i<=last; i++) cnt[channels[i]]++;
+    // 0 is unknown (no audio yet)
+    int ret=0,best=0;
+    for (int c=1; c<256; c++)
+    {
+        if (cnt[c]>best)
+        {
+            best=cnt[c];
+            ret=c;
+        }
+    }
+    return ret;
+}
+
+void cMarkAdColumns::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&count,sizeof(count));
+    if (!count) return;
+    Ckp->Put(iframe,count*sizeof(int));
+    Ckp->Put(aspect,count*sizeof(short));
+    Ckp->Put(channels,count);
+}
+
+bool cMarkAdColumns::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Clear();
+    int cnt;
+    if (!Ckp->Get(&cnt,sizeof(cnt))) return false;
+    if (cnt<0) return false;
+    while (max<cnt)
+    {
+        if (!grow()) return false;
+    }
+    if (!cnt) return true;
+    bool ok=Ckp->Get(iframe,cnt*sizeof(int));
+    if (ok) ok=Ckp->Get(aspect,cnt*sizeof(short));
+    if (ok) ok=Ckp->Get(channels,cnt);
+    if (!ok) return false;
+    count=cnt;
+    return true;
+}
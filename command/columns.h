@@ -0,0 +1,48 @@
+/*
+ * columns.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __columns_h_
+#define __columns_h_
+
+#include "global.h"
+#include "checkpoint.h"
+
+// --- cMarkAdColumns
+// aspect ratio and audio channels of the processed iframes, one row
+// per iframe, every feature in its own array. Rows are only appended
+// with ascending iframes, so positions are found with a binary search
+// and ranges are scanned without touching the other features. Only
+// features the decisions read are kept.
+class cMarkAdColumns
+{
+private:
+    int count;
+    int max;
+    int *iframe;
+    short *aspect;      // Num<<8|Den, 0 unknown
+    unsigned char *channels;
+    bool grow();
+    int dominant(const short *Column, int First, int Last);
+public:
+    cMarkAdColumns();
+    ~cMarkAdColumns();
+    void Clear();
+    bool Append(int IFrame, const MarkAdAspectRatio *AspectRatio, int Channels);
+    void SetChannels(int Channels);
+    int Count()
+    {
+        return count;
+    }
+    int Find(int FrameNumber);
+    bool Range(int From, int To, int *First, int *Last);
+    bool Aspect(int From, int To, MarkAdAspectRatio *AspectRatio);
+    int Channels(int From, int To);
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+};
+
+#endif
@@ -0,0 +1,660 @@
+/*
+ * daemon.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "markad-standalone.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdDaemon::cMarkAdDaemon(const char *SocketPath, const MarkAdConfig *Config, int MaxRunning)
+{
+    socketPath=SocketPath;
+    config=Config;
+    maxRunning=MaxRunning;
+    if (maxRunning<1) maxRunning=1;
+    lastId=0;
+    abort=false;
+    sock=-1;
+    memset(&jobs,0,sizeof(jobs));
+    memset(&clients,0,sizeof(clients));
+    for (int i=0; i<MAXCLIENTS; i++) clients[i].fd=-1;
+    pthread_mutex_init(&mutex,NULL);
+}
+
+cMarkAdDaemon::~cMarkAdDaemon()
+{
+    for (int i=0; i<MAXCLIENTS; i++) CloseClient(i);
+    if (sock!=-1)
+    {
+        close(sock);
+        unlink(socketPath);
+    }
+    pthread_mutex_destroy(&mutex);
+}
+
+void cMarkAdDaemon::SetAbort()
+{
+    // called from signal handler, just set flags
+    abort=true;
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        if ((jobs[i].State==jRUNNING) && (jobs[i].Worker)) jobs[i].Worker->SetAbort();
+    }
+}
+
+void *cMarkAdDaemon::worker(void *Job)
+{
+    struct job *job=(struct job *) Job;
+    cMarkAdStandalone *cmasta=new cMarkAdStandalone(job->Directory,&job->Config);
+    if (cmasta)
+    {
+        pthread_mutex_lock(&job->Daemon->mutex);
+        job->Worker=cmasta;
+        if (job->Paused) cmasta->SetPause(true);
+        if ((job->Canceled) || (job->Daemon->abort)) cmasta->SetAbort();
+        pthread_mutex_unlock(&job->Daemon->mutex);
+
+        cmasta->Process();
+        if (!job->Pass1Only) cmasta->Process2ndPass();
+
+        // Reap joins the thread, so cmasta is deleted before the job is freed
+        pthread_mutex_lock(&job->Daemon->mutex);
+        job->Worker=NULL;
+        job->State=jDONE;
+        pthread_mutex_unlock(&job->Daemon->mutex);
+        delete cmasta;
+        return NULL;
+    }
+    pthread_mutex_lock(&job->Daemon->mutex);
+    job->State=jDONE;
+    pthread_mutex_unlock(&job->Daemon->mutex);
+    return NULL;
+}
+
+int cMarkAdDaemon::state(int Job)
+{
+    // the worker sets jDONE, all other changes are made here
+    pthread_mutex_lock(&mutex);
+    int ret=jobs[Job].State;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+int cMarkAdDaemon::Get(const char *Directory)
+{
+    if (!Directory) return -1;
+    // jobs are stored with the real path of the recording
+    char *dir=realpath(Directory,NULL);
+    int ret=-1;
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        int st=state(i);
+        if ((st!=jFREE) && (st!=jDONE) &&
+                (!strcmp(jobs[i].Directory,dir ? dir : Directory)))
+        {
+            ret=i;
+            break;
+        }
+    }
+    if (dir) free(dir);
+    return ret;
+}
+
+int cMarkAdDaemon::Running()
+{
+    int cnt=0;
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        // live jobs run beside the recording and are not counted
+        if ((state(i)==jRUNNING) && (!jobs[i].Live)) cnt++;
+    }
+    return cnt;
+}
+
+void cMarkAdDaemon::Reap()
+{
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        if (state(i)!=jDONE) continue;
+        pthread_join(jobs[i].Thread,NULL);
+        isyslog("job %i finished on %s",jobs[i].Id,jobs[i].Directory);
+        free(jobs[i].Directory);
+        memset(&jobs[i],0,sizeof(jobs[i]));
+    }
+}
+
+void cMarkAdDaemon::Schedule()
+{
+    for (;;)
+    {
+        // live jobs are started at once, all others by priority and age
+        int next=-1;
+        for (int i=0; i<MAXJOBS; i++)
+        {
+            if (state(i)!=jQUEUED) continue;
+            if (jobs[i].Live)
+            {
+                next=i;
+                break;
+            }
+            if (Running()>=maxRunning) continue;
+            if ((next==-1) || (jobs[i].Priority>jobs[next].Priority) ||
+                    ((jobs[i].Priority==jobs[next].Priority) && (jobs[i].Id<jobs[next].Id)))
+                next=i;
+        }
+        if (next==-1) return;
+
+        jobs[next].State=jRUNNING;
+        jobs[next].Daemon=this;
+        if (pthread_create(&jobs[next].Thread,NULL,worker,&jobs[next])!=0)
+        {
+            esyslog("failed to start job %i on %s",jobs[next].Id,jobs[next].Directory);
+            free(jobs[next].Directory);
+            memset(&jobs[next],0,sizeof(jobs[next]));
+            return;
+        }
+        isyslog("job %i started on %s",jobs[next].Id,jobs[next].Directory);
+    }
+}
+
+void cMarkAdDaemon::Reply(int fd, int Code, const char *format, ...)
+{
+    // negative codes are used for continued lines of a multi-line reply
+    char buf[2048];
+    int len=snprintf(buf,sizeof(buf),"%03i%c",abs(Code),(Code<0) ? '-' : ' ');
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(buf+len,sizeof(buf)-len-1,format,ap);
+    va_end(ap);
+    strcat(buf,"\n");
+    if (send(fd,buf,strlen(buf),MSG_NOSIGNAL)==-1)
+    {
+        dsyslog("failed to send reply (%i)",errno);
+    }
+}
+
+bool cMarkAdDaemon::ParseFlags(struct job *Job, const char *Flags)
+{
+    // flags are the (short) options of markad, "-" for none
+    if (!strcmp(Flags,"-")) return true;
+    for (const char *f=Flags; *f; f++)
+    {
+        switch (*f)
+        {
+        case 'B':
+            Job->Config.BackupMarks=true;
+            break;
+        case 'G':
+            Job->Config.GenIndex=true;
+            break;
+        case 'I':
+            Job->Config.SaveInfo=true;
+            break;
+        case 'L':
+            // started while recording ("before")
+            Job->Config.Before=true;
+            Job->Live=true;
+            break;
+        case 'M':
+            Job->Config.ignoreInfo|=IGNORE_TIMERINFO;
+            break;
+        case 'O':
+            Job->Config.OSD=true;
+            break;
+        case 'R':
+            // markad.log in the recording, see cMarkAdStandalone
+            Job->Config.Log2Rec=true;
+            break;
+        case 'v':
+            if (Job->Config.Verbose<8) Job->Config.Verbose++;
+            break;
+        case '1':
+            Job->Pass1Only=true;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cMarkAdDaemon::Enqueue(int fd, char *Option)
+{
+    int priority;
+    char flags[32];
+    int n=0;
+    if (sscanf(Option,"%5i %31s %n",&priority,flags,&n)<2 || !n || !Option[n])
+    {
+        Reply(fd,501,"usage: ENQUEUE <priority> <flags> <directory>");
+        return false;
+    }
+
+    char *dir=realpath(Option+n,NULL);
+    if (!dir)
+    {
+        Reply(fd,550,"%s not found",Option+n);
+        return false;
+    }
+    if (access(dir,W_OK|R_OK)==-1)
+    {
+        Reply(fd,550,"cannot access %s",dir);
+        free(dir);
+        return false;
+    }
+    if (Get(dir)!=-1)
+    {
+        Reply(fd,550,"%s already queued",dir);
+        free(dir);
+        return false;
+    }
+
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        if (state(i)!=jFREE) continue;
+        memcpy(&jobs[i].Config,config,sizeof(jobs[i].Config));
+        if (!ParseFlags(&jobs[i],flags))
+        {
+            memset(&jobs[i],0,sizeof(jobs[i]));
+            Reply(fd,501,"invalid flags %s",flags);
+            free(dir);
+            return false;
+        }
+        jobs[i].Directory=dir;
+        jobs[i].Priority=priority;
+        jobs[i].Id=++lastId;
+        jobs[i].State=jQUEUED;
+        isyslog("job %i queued on %s",jobs[i].Id,dir);
+        Reply(fd,250,"%i queued",jobs[i].Id);
+        return true;
+    }
+    Reply(fd,451,"queue full");
+    free(dir);
+    return false;
+}
+
+void cMarkAdDaemon::Progress(int fd, struct job *Job, bool Last)
+{
+    static const char *states[]= { "free","queued","running","done" };
+    int pass=0,percent=0;
+
+    pthread_mutex_lock(&mutex);
+    if (Job->Worker) percent=Job->Worker->GetProgress(&pass);
+    int st=Job->State;
+    pthread_mutex_unlock(&mutex);
+
+    Reply(fd,Last ? 250 : -250,"%i %s %i %i %i %s",Job->Id,
+          ((st==jRUNNING) && (Job->Paused)) ? "paused" : states[st],
+          Job->Priority,pass,percent,Job->Directory);
+}
+
+bool cMarkAdDaemon::Command(int fd, char *Line)
+{
+    char *option=Line;
+    while ((*option) && (!isspace(*option))) option++;
+    if (*option) *option++=0;
+    while (isspace(*option)) option++;
+
+    if (!strcasecmp(Line,"ENQUEUE"))
+    {
+        Enqueue(fd,option);
+        Schedule();
+    }
+    else if ((!strcasecmp(Line,"PAUSE")) || (!strcasecmp(Line,"CONTINUE")))
+    {
+        bool pause=(toupper(*Line)=='P');
+        bool all=(!strcmp(option,"*"));
+        int pos=all ? -1 : Get(option);
+        int cnt=0;
+        for (int i=0; i<MAXJOBS; i++)
+        {
+            int st=state(i);
+            if ((st!=jQUEUED) && (st!=jRUNNING)) continue;
+            if ((!all) && (i!=pos)) continue;
+            pthread_mutex_lock(&mutex);
+            jobs[i].Paused=pause;
+            if (jobs[i].Worker) jobs[i].Worker->SetPause(pause);
+            pthread_mutex_unlock(&mutex);
+            cnt++;
+        }
+        if (cnt)
+        {
+            Reply(fd,250,"%i job(s) %s",cnt,pause ? "paused" : "continued");
+        }
+        else
+        {
+            Reply(fd,550,"%s not found",option);
+        }
+    }
+    else if (!strcasecmp(Line,"CANCEL"))
+    {
+        int pos=Get(option);
+        if (pos==-1)
+        {
+            Reply(fd,550,"%s not found",option);
+        }
+        else
+        {
+            if (state(pos)==jQUEUED)
+            {
+                isyslog("job %i removed from queue",jobs[pos].Id);
+                free(jobs[pos].Directory);
+                memset(&jobs[pos],0,sizeof(jobs[pos]));
+            }
+            else
+            {
+                isyslog("aborting job %i",jobs[pos].Id);
+                pthread_mutex_lock(&mutex);
+                jobs[pos].Paused=false;
+                jobs[pos].Canceled=true;
+                if (jobs[pos].Worker)
+                {
+                    jobs[pos].Worker->SetPause(false);
+                    jobs[pos].Worker->SetAbort();
+                }
+                pthread_mutex_unlock(&mutex);
+            }
+            Reply(fd,250,"%s canceled",option);
+        }
+    }
+    else if (!strcasecmp(Line,"PRIORITY"))
+    {
+        int priority,n=0;
+        if ((sscanf(option,"%5i %n",&priority,&n)<1) || (!n))
+        {
+            Reply(fd,501,"usage: PRIORITY <priority> <directory>");
+        }
+        else
+        {
+            int pos=Get(option+n);
+            if (pos==-1)
+            {
+                Reply(fd,550,"%s not found",option+n);
+            }
+            else
+            {
+                jobs[pos].Priority=priority;
+                Reply(fd,250,"priority of job %i set to %i",jobs[pos].Id,priority);
+            }
+        }
+    }
+    else if (!strcasecmp(Line,"STAT"))
+    {
+        int pos=Get(option);
+        if (pos==-1)
+        {
+            Reply(fd,550,"%s not found",option);
+        }
+        else
+        {
+            Progress(fd,&jobs[pos],true);
+        }
+    }
+    else if (!strcasecmp(Line,"PROGRESS"))
+    {
+        int last=-1;
+        for (int i=0; i<MAXJOBS; i++)
+        {
+            int st=state(i);
+            if ((st==jQUEUED) || (st==jRUNNING)) last=i;
+        }
+        for (int i=0; i<=last; i++)
+        {
+            int st=state(i);
+            if ((st==jQUEUED) || (st==jRUNNING)) Progress(fd,&jobs[i],(i==last));
+        }
+        if (last==-1) Reply(fd,250,"no jobs");
+    }
+    else if (!strcasecmp(Line,"PID"))
+    {
+        Reply(fd,250,"%i",(int) getpid());
+    }
+    else if (!strcasecmp(Line,"QUIT"))
+    {
+        Reply(fd,221,"closing connection");
+        return false;
+    }
+    else if (!strcasecmp(Line,"SHUTDOWN"))
+    {
+        Reply(fd,221,"shutting down");
+        SetAbort();
+        return false;
+    }
+    else
+    {
+        Reply(fd,500,"command unrecognized: \"%s\"",Line);
+    }
+    return true;
+}
+
+void cMarkAdDaemon::CloseClient(int Client)
+{
+    if (clients[Client].fd==-1) return;
+    close(clients[Client].fd);
+    clients[Client].fd=-1;
+    clients[Client].len=0;
+}
+
+bool cMarkAdDaemon::ReadClient(int Client)
+{
+    struct client *c=&clients[Client];
+    int ret=read(c->fd,c->buf+c->len,sizeof(c->buf)-c->len-1);
+    if (ret<=0)
+    {
+        if ((ret==-1) && (errno==EINTR)) return true;
+        return false;
+    }
+    c->len+=ret;
+    c->buf[c->len]=0;
+
+    char *line=c->buf;
+    char *lf;
+    while ((lf=strchr(line,'\n')))
+    {
+        *lf=0;
+        if ((lf>line) && (lf[-1]=='\r')) lf[-1]=0;
+        if (*line)
+        {
+            if (!Command(c->fd,line)) return false;
+        }
+        line=lf+1;
+    }
+    c->len-=(line-c->buf);
+    if (c->len>=(int) sizeof(c->buf)-1)
+    {
+        Reply(c->fd,500,"line too long");
+        return false;
+    }
+    memmove(c->buf,line,c->len);
+    return true;
+}
+
+bool cMarkAdDaemon::SocketDir()
+{
+    // the socket belongs into a directory only we can write to
+    char *dir=strdup(socketPath);
+    if (!dir) return false;
+    char *sl=strrchr(dir,'/');
+    if ((!sl) || (sl==dir))
+    {
+        free(dir);
+        return true;
+    }
+    *sl=0;
+    if ((mkdir(dir,0700)==-1) && (errno!=EEXIST))
+    {
+        esyslog("cannot create %s (%i)",dir,errno);
+        free(dir);
+        return false;
+    }
+    struct stat statbuf;
+    if (stat(dir,&statbuf)==-1)
+    {
+        esyslog("cannot access %s (%i)",dir,errno);
+        free(dir);
+        return false;
+    }
+    if (statbuf.st_mode & (S_IWGRP|S_IWOTH))
+    {
+        isyslog("WARNING: %s is writable by others, use a private directory for the socket",dir);
+    }
+    free(dir);
+    return true;
+}
+
+bool cMarkAdDaemon::AllowedPeer(int fd)
+{
+    // only processes of our own user (and root) may queue recordings
+    struct ucred cred;
+    socklen_t len=sizeof(cred);
+    if (getsockopt(fd,SOL_SOCKET,SO_PEERCRED,&cred,&len)==-1)
+    {
+        esyslog("cannot get credentials of client (%i)",errno);
+        return false;
+    }
+    if ((cred.uid==getuid()) || (cred.uid==0)) return true;
+    isyslog("refused client pid %i uid %i",(int) cred.pid,(int) cred.uid);
+    return false;
+}
+
+int cMarkAdDaemon::Process()
+{
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    if (strlen(socketPath)>=sizeof(addr.sun_path))
+    {
+        esyslog("socket path %s too long",socketPath);
+        return -1;
+    }
+    strcpy(addr.sun_path,socketPath);
+    if (!SocketDir()) return -1;
+
+    sock=socket(AF_UNIX,SOCK_STREAM,0);
+    if (sock==-1)
+    {
+        esyslog("cannot create socket (%i)",errno);
+        return -1;
+    }
+    fcntl(sock,F_SETFD,FD_CLOEXEC);
+
+    if (connect(sock,(struct sockaddr *) &addr,sizeof(addr))==0)
+    {
+        esyslog("another daemon is listening on %s",socketPath);
+        close(sock);
+        sock=-1;
+        return -1;
+    }
+    unlink(socketPath); // stale socket
+
+    mode_t mask=umask(0177);
+    int bound=bind(sock,(struct sockaddr *) &addr,sizeof(addr));
+    umask(mask);
+    if ((bound==-1) || (chmod(socketPath,0600)==-1) || (listen(sock,MAXCLIENTS)==-1))
+    {
+        esyslog("cannot listen on %s (%i)",socketPath,errno);
+        close(sock);
+        sock=-1;
+        return -1;
+    }
+    isyslog("daemon listening on %s",socketPath);
+
+    while (!abort)
+    {
+        struct pollfd fds[MAXCLIENTS+1];
+        fds[0].fd=sock;
+        fds[0].events=POLLIN;
+        fds[0].revents=0;
+        for (int i=0; i<MAXCLIENTS; i++)
+        {
+            fds[i+1].fd=clients[i].fd;
+            fds[i+1].events=POLLIN;
+            fds[i+1].revents=0;
+        }
+
+        int ret=poll(fds,MAXCLIENTS+1,1000);
+        if (ret==-1)
+        {
+            if (errno==EINTR) continue;
+            esyslog("poll failed (%i)",errno);
+            break;
+        }
+
+        for (int i=0; i<MAXCLIENTS; i++)
+        {
+            if (!fds[i+1].revents) continue;
+            if (!ReadClient(i)) CloseClient(i);
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd=accept(sock,NULL,NULL);
+            if ((fd!=-1) && (!AllowedPeer(fd)))
+            {
+                Reply(fd,530,"permission denied");
+                close(fd);
+                fd=-1;
+            }
+            if (fd!=-1)
+            {
+                fcntl(fd,F_SETFD,FD_CLOEXEC);
+                int i;
+                for (i=0; i<MAXCLIENTS; i++)
+                {
+                    if (clients[i].fd==-1) break;
+                }
+                if (i==MAXCLIENTS)
+                {
+                    Reply(fd,421,"too many connections");
+                    close(fd);
+                }
+                else
+                {
+                    clients[i].fd=fd;
+                    clients[i].len=0;
+                }
+            }
+        }
+
+        Reap();
+        Schedule();
+    }
+
+    isyslog("daemon shutting down");
+    SetAbort();
+    for (int i=0; i<MAXJOBS; i++)
+    {
+        pthread_mutex_lock(&mutex);
+        if (jobs[i].Worker) jobs[i].Worker->SetPause(false);
+        pthread_mutex_unlock(&mutex);
+        int st=state(i);
+        if (st==jQUEUED) st=jobs[i].State=jDONE;
+        if ((st==jRUNNING) || (st==jDONE))
+        {
+            if (jobs[i].Thread) pthread_join(jobs[i].Thread,NULL);
+            free(jobs[i].Directory);
+            memset(&jobs[i],0,sizeof(jobs[i]));
+        }
+    }
+    return 0;
+}
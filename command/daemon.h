@@ -0,0 +1,93 @@
+/*
+ * daemon.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __daemon_h_
+#define __daemon_h_
+
+#include <pthread.h>
+
+#include "global.h"
+
+#define DEF_SOCKET "/run/markad/markad.socket"
+
+#define MAXJOBS 64
+#define MAXCLIENTS 8
+
+class cMarkAdStandalone;
+
+// --- cMarkAdDaemon
+// long running markad, recordings are queued over a local (unix) socket
+// protocol is line based, replies are "<code> <text>" like in SVDRP:
+//   ENQUEUE <priority> <flags> <directory>  queue recording
+//   CANCEL <directory>                      remove/abort job
+//   PAUSE <directory>|*                     pause job(s)
+//   CONTINUE <directory>|*                  resume job(s)
+//   PRIORITY <priority> <directory>         change priority of a job
+//   STAT <directory>                        state of one job
+//   PROGRESS                                state of all jobs
+//   PID                                     process id of the daemon
+//   QUIT                                    close connection
+//   SHUTDOWN                                abort all jobs and exit
+class cMarkAdDaemon
+{
+private:
+    enum { jFREE=0, jQUEUED, jRUNNING, jDONE };
+
+    struct job
+    {
+        int State;
+        int Id;
+        int Priority;
+        bool Paused;
+        bool Canceled;
+        bool Live;
+        bool Pass1Only;
+        char *Directory;
+        MarkAdConfig Config;
+        cMarkAdStandalone *Worker;
+        cMarkAdDaemon *Daemon;
+        pthread_t Thread;
+    } jobs[MAXJOBS];
+
+    struct client
+    {
+        int fd;
+        int len;
+        char buf[2048];
+    } clients[MAXCLIENTS];
+
+    const MarkAdConfig *config;
+    const char *socketPath;
+    pthread_mutex_t mutex;
+    int maxRunning;
+    int lastId;
+    int sock;
+    bool abort;
+
+    static void *worker(void *Job);
+    int state(int Job);
+    int Get(const char *Directory);
+    int Running();
+    void Schedule();
+    void Reap();
+    void Reply(int fd, int Code, const char *format, ...) __attribute__ ((format (printf, 4, 5)));
+    bool Command(int fd, char *Line);
+    bool Enqueue(int fd, char *Option);
+    bool ParseFlags(struct job *Job, const char *Flags);
+    void Progress(int fd, struct job *Job, bool Last);
+    void CloseClient(int Client);
+    bool ReadClient(int Client);
+    bool SocketDir();
+    bool AllowedPeer(int fd);
+public:
+    cMarkAdDaemon(const char *SocketPath, const MarkAdConfig *Config, int MaxRunning);
+    ~cMarkAdDaemon();
+    void SetAbort();
+    int Process();
+};
+
+#endif
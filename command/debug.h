@@ -13,11 +13,12 @@
 #endif
 
 extern int SysLogLevel;
+extern __thread int SysLogLevelJob; // added by a daemon job (-v)
 extern void syslog_with_tid(int priority, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 
-#define esyslog(a...) void( (SysLogLevel > 0) ? syslog_with_tid(LOG_ERR, a) : void() )
-#define isyslog(a...) void( (SysLogLevel > 1) ? syslog_with_tid(LOG_ERR, a) : void() )
-#define dsyslog(a...) void( (SysLogLevel > 2) ? syslog_with_tid(LOG_ERR, a) : void() )
-#define tsyslog(a...) void( (SysLogLevel > 3) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define esyslog(a...) void( (SysLogLevel+SysLogLevelJob > 0) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define isyslog(a...) void( (SysLogLevel+SysLogLevelJob > 1) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define dsyslog(a...) void( (SysLogLevel+SysLogLevelJob > 2) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define tsyslog(a...) void( (SysLogLevel+SysLogLevelJob > 3) ? syslog_with_tid(LOG_ERR, a) : void() )
 
 #endif
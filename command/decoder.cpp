@@ -29,6 +29,18 @@
 #define AVMEDIA_TYPE_UNKNOWN CODEC_TYPE_UNKNOWN
 #endif
 
+#if LIBAVUTIL_VERSION_INT < ((51<<16)+(42<<8)+0)
+#define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
+#define AV_PIX_FMT_YUVJ420P PIX_FMT_YUVJ420P
+#define AV_PIX_FMT_YUV422P PIX_FMT_YUV422P
+#define AV_PIX_FMT_YUVJ422P PIX_FMT_YUVJ422P
+#define AV_PIX_FMT_YUV444P PIX_FMT_YUV444P
+#define AV_PIX_FMT_YUVJ444P PIX_FMT_YUVJ444P
+#define AV_PIX_FMT_YUV420P10LE PIX_FMT_YUV420P10LE
+#define AV_PIX_FMT_YUV422P10LE PIX_FMT_YUV422P10LE
+#define AV_PIX_FMT_YUV444P10LE PIX_FMT_YUV444P10LE
+#endif
+
 #if LIBAVCODEC_VERSION_INT < ((52<<16)+(65<<8)+0)
 int avcodec_copy_context(AVCodecContext *dest, const AVCodecContext *src)
 {
@@ -117,7 +129,11 @@ fail:
 #endif
 #endif
 
-cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
+#if LIBAVCODEC_VERSION_INT >= ((55<<16)+(24<<8)+0)
+#define HAVE_HEVC
+#endif
+
+cMarkAdDecoder::cMarkAdDecoder(int VideoType, int Threads)
 {
 #if LIBAVCODEC_VERSION_INT < ((53<<16)+(7<<8)+1)
     avcodec_init();
@@ -129,6 +145,7 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
 
     addPkt=false;
     noticeERRVID=false;
+    lastpixfmt=-1;
 
     cpu_set_t cpumask;
     uint len = sizeof(cpumask);
@@ -162,7 +179,7 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
     tsyslog("libavcodec config: %s",avcodec_configuration());
 #endif
 
-    if (((ver >> 16)<52) && (useH264))
+    if (((ver >> 16)<52) && (VideoType==MARKAD_PIDTYPE_VIDEO_H264))
     {
         esyslog("dont report bugs about H264, use libavcodec >= 52 instead!");
     }
@@ -174,13 +191,22 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
     CodecID video_codecid;
 #endif
 
-    if (useH264)
+    switch (VideoType)
     {
+    case MARKAD_PIDTYPE_VIDEO_H264:
         video_codecid=AV_CODEC_ID_H264;
-    }
-    else
-    {
+        break;
+    case MARKAD_PIDTYPE_VIDEO_H265:
+#ifdef HAVE_HEVC
+        video_codecid=AV_CODEC_ID_HEVC;
+#else
+        esyslog("dont report bugs about H265, use libavcodec >= 55.24 instead!");
+        video_codecid=AV_CODEC_ID_NONE;
+#endif
+        break;
+    default:
         video_codecid=AV_CODEC_ID_MPEG2VIDEO_XVMC;
+        break;
     }
 
     video_codec = avcodec_find_decoder(video_codecid);
@@ -208,9 +234,12 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
 
             if (video_codecid!=AV_CODEC_ID_H264)
             {
-                video_context->skip_frame=AVDISCARD_NONKEY; // just I-frames
+                video_context->skip_frame=AVDISCARD_NONKEY; // just I-frames (IRAP with H265)
             } else {
                 video_context->flags2|=CODEC_FLAG2_CHUNKS;
+            }
+            if ((video_codecid!=AV_CODEC_ID_MPEG2VIDEO_XVMC) && (video_codecid!=AV_CODEC_ID_MPEG2VIDEO))
+            {
 #if LIBAVCODEC_VERSION_INT >= ((52<<16)+(47<<8)+0)
                 av_log_set_level(AV_LOG_FATAL); // silence decoder output
 #else
@@ -256,6 +285,11 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
                 case AV_CODEC_ID_H264:
                     esyslog("could not open codec for H264");
                     break;
+#ifdef HAVE_HEVC
+                case AV_CODEC_ID_HEVC:
+                    esyslog("could not open codec for H265");
+                    break;
+#endif
                 case AV_CODEC_ID_MPEG2VIDEO_XVMC:
                     esyslog("could not open codec MPEG2 (XVMC)");
                     break;
@@ -322,6 +356,11 @@ cMarkAdDecoder::cMarkAdDecoder(bool useH264, int Threads)
         case AV_CODEC_ID_H264:
             esyslog("codec for H264 not found");
             break;
+#ifdef HAVE_HEVC
+        case AV_CODEC_ID_HEVC:
+            esyslog("codec for H265 not found");
+            break;
+#endif
         case AV_CODEC_ID_MPEG2VIDEO_XVMC:
             esyslog("codec for MPEG2 (XVMC) not found");
             break;
@@ -397,9 +436,74 @@ bool cMarkAdDecoder::Clear()
     return ret;
 }
 
+static int PixelFormat(int Pix_Fmt, MarkAdPixelFormat *Format)
+{
+    // 0 = 8 bit 4:2:0 as used by the detectors, 1 = needs
+    // normalization, -1 = unsupported
+    Format->Bytes=1;
+    Format->Depth=8;
+    Format->ShiftX=1;
+    Format->ShiftY=1;
+    switch (Pix_Fmt)
+    {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        return 0;
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:
+        Format->ShiftY=0;
+        return 1;
+    case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_YUVJ444P:
+        Format->ShiftX=Format->ShiftY=0;
+        return 1;
+    case AV_PIX_FMT_YUV420P10LE:
+        Format->Bytes=2;
+        Format->Depth=10;
+        return 1;
+    case AV_PIX_FMT_YUV422P10LE:
+        Format->Bytes=2;
+        Format->Depth=10;
+        Format->ShiftY=0;
+        return 1;
+    case AV_PIX_FMT_YUV444P10LE:
+        Format->Bytes=2;
+        Format->Depth=10;
+        Format->ShiftX=Format->ShiftY=0;
+        return 1;
+    default:
+        return -1;
+    }
+}
+
 bool cMarkAdDecoder::SetVideoInfos(MarkAdContext *maContext,AVCodecContext *Video_Context, AVFrame *Video_Frame)
 {
     if ((!maContext) || (!Video_Context) || (!Video_Frame)) return false;
+    maContext->Video.Info.Height=Video_Context->height;
+    maContext->Video.Info.Width=Video_Context->width;
+    maContext->Video.Info.Pix_Fmt=Video_Context->pix_fmt;
+
+    MarkAdPixelFormat format;
+    int ret=PixelFormat(Video_Context->pix_fmt,&format);
+    if (ret==1)
+    {
+        if (lastpixfmt!=Video_Context->pix_fmt)
+        {
+            isyslog("normalizing pix_fmt %i (%i bit, chroma %i:%i) to 8 bit 4:2:0",
+                    Video_Context->pix_fmt,format.Depth,format.ShiftX,format.ShiftY);
+        }
+        lastpixfmt=Video_Context->pix_fmt;
+        if (normalize.Process(maContext,&format,Video_Frame->data,Video_Frame->linesize,
+                              Video_Context->width,Video_Context->height))
+        {
+            // the detectors see the converted view only
+            maContext->Video.Info.Pix_Fmt=((Video_Context->pix_fmt==AV_PIX_FMT_YUVJ422P) ||
+                                           (Video_Context->pix_fmt==AV_PIX_FMT_YUVJ444P)) ?
+                                          AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+            return true;
+        }
+    }
+    lastpixfmt=Video_Context->pix_fmt;
     for (int i=0; i<4; i++)
     {
         if (Video_Frame->data[i])
@@ -409,9 +513,6 @@ bool cMarkAdDecoder::SetVideoInfos(MarkAdContext *maContext,AVCodecContext *Vide
             maContext->Video.Data.Valid=true;
         }
     }
-    maContext->Video.Info.Height=Video_Context->height;
-    maContext->Video.Info.Width=Video_Context->width;
-    maContext->Video.Info.Pix_Fmt=Video_Context->pix_fmt;
     return true;
 }
 
@@ -428,6 +529,17 @@ bool cMarkAdDecoder::DecodeVideo(MarkAdContext *maContext,uchar *pkt, int plen)
         if (!addPkt) return false;
     }
 
+#ifdef HAVE_HEVC
+    if (video_context->codec_id==AV_CODEC_ID_HEVC) {
+        // start with access units of I slices only (IRAP), skip_frame
+        // drops everything else till the next one
+        if (plen>=7) {
+            if ((((pkt[4]>>1) & 0x3F)==35) && ((pkt[6]>>5)==0)) addPkt=true;
+        }
+        if (!addPkt) return false;
+    }
+#endif
+
     if (video_context->codec_id==AV_CODEC_ID_MPEG2VIDEO) {
         if (plen>=5) {
             if (!pkt[0] && !pkt[1] && (pkt[2]==1) && !pkt[3]  && ((pkt[5] & 8)==8)) addPkt=true;
@@ -35,6 +35,7 @@ extern "C"
 }
 
 #include "global.h"
+#include "normalize.h"
 
 class cMarkAdDecoder
 {
@@ -52,10 +53,12 @@ private:
                        AVFrame *Video_Frame);
     bool noticeERRVID;
     bool addPkt;
+    cMarkAdNormalize normalize;
+    int lastpixfmt;
 public:
     bool DecodeVideo(MarkAdContext *maContext, uchar *pkt, int plen);
     bool Clear();
-    cMarkAdDecoder(bool useH264, int Threads);
+    cMarkAdDecoder(int VideoType, int Threads);
     ~cMarkAdDecoder();
 };
 
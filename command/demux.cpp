@@ -7,6 +7,7 @@
 
 #include <string.h>
 #include "demux.h"
+#include "startcode.h"
 extern "C"
 {
 #include "debug.h"
@@ -108,6 +109,19 @@ int cPaketQueue::findpktheader(int start, int *streamsize,int *headersize, bool
     bool found=false;
     for (i=start; i<inptr; i++)
     {
+        if (i>=start+4)
+        {
+            // scanner holds buffer[i-4..i-1] now, jump to the
+            // next position where a start code can be complete
+            int sc=FindStartCode(&buffer[i-4],inptr-(i-4));
+            int next=(sc==-1) ? inptr : i-4+sc+3;
+            if (next>i)
+            {
+                i=next;
+                scanner=((uint32_t) buffer[i-4]<<24)|(buffer[i-3]<<16)|(buffer[i-2]<<8)|buffer[i-1];
+                if (i==inptr) break;
+            }
+        }
         if (longstartcode)
         {
             if (scanner==1L)
@@ -471,6 +485,7 @@ uchar *cPaketQueue::GetPacket(int *Size, int Type)
             pktinfo.pkthdr=findaudioheader(0,&pktinfo.streamsize,&pktinfo.pktsyncsize,false);
             break;
         case PACKET_H264:
+        case PACKET_H265:
             pktinfo.pkthdr=findpktheader(0,&pktinfo.streamsize,&pktinfo.pktsyncsize,true);
             break;
         default:
@@ -516,6 +531,7 @@ uchar *cPaketQueue::GetPacket(int *Size, int Type)
         pkthdr=findaudioheader(scannerstart,&streamsize,&pktsyncsize,false);
         break;
     case PACKET_H264:
+    case PACKET_H265:
         pkthdr=findpktheader(scannerstart,&streamsize,&pktsyncsize,true);
         break;
     default:
@@ -573,11 +589,11 @@ uchar *cPaketQueue::GetPacket(int *Size, int Type)
 
 // ----------------------------------------------------------------------------
 
-cTS2Pkt::cTS2Pkt(int Pid, const char *QueueName, int QueueSize, bool H264)
+cTS2Pkt::cTS2Pkt(int Pid, const char *QueueName, int QueueSize, int Type)
 {
     queue=new cPaketQueue(QueueName,QueueSize);
     pid=Pid;
-    h264=H264;
+    type=Type;
     firstsync=false;
     Clear();
 }
@@ -752,16 +768,18 @@ bool cTS2Pkt::Process(uchar *TSData, int TSSize, AvPacket *Pkt)
         queue->Put(buf,buflen);
     }
 
-    Pkt->Data=queue->GetPacket(&Pkt->Length,h264 ? PACKET_H264 : PACKET_H262);
+    Pkt->Data=queue->GetPacket(&Pkt->Length,type);
     if (Pkt->Data)
     {
-        Pkt->Type=h264 ? PACKET_H264 : PACKET_H262;
+        Pkt->Type=type;
         Pkt->Stream=pid;
-        if ((h264) && ((Pkt->Data[4] & 0x1F)==0x0C))
+        if (((type==PACKET_H264) && ((Pkt->Data[4] & 0x1F)==0x0C)) ||
+                ((type==PACKET_H265) && (((Pkt->Data[4]>>1) & 0x3F)==38)))
         {
             if (!noticeFILLER)
             {
-                isyslog("H264 video stream with filler nalu (0x%04x)",pid);
+                isyslog("%s video stream with filler nalu (0x%04x)",
+                        (type==PACKET_H265) ? "H265" : "H264",pid);
                 noticeFILLER=true;
             }
             skipped+=Pkt->Length; // thats not accurate!
@@ -852,6 +870,7 @@ bool cPES2ES::Process(uchar *PESData, int PESSize, AvPacket *ESPkt)
             if (peshdr->StreamID!=0xE0) return true; // ignore packets not for us!
             break;
         case PACKET_H264:
+        case PACKET_H265:
             if (peshdr->StreamID!=0xE0) return true; // ignore packets not for us!
             break;
         case PACKET_AC3:
@@ -911,7 +930,7 @@ bool cPES2ES::Process(uchar *PESData, int PESSize, AvPacket *ESPkt)
 
 // ----------------------------------------------------------------------------
 
-cDemux::cDemux(int VPid, int DPid, int APid, bool H264, bool VDRCount, bool RAW)
+cDemux::cDemux(int VPid, int DPid, int APid, int VideoType, bool VDRCount, bool RAW)
 {
     raw=RAW;
     TS=false;
@@ -933,7 +952,7 @@ cDemux::cDemux(int VPid, int DPid, int APid, bool H264, bool VDRCount, bool RAW)
     ts2pkt_vpid=NULL;
     ts2pkt_dpid=NULL;
     ts2pkt_apid=NULL;
-    h264=H264;
+    vtype=VideoType;
     vdrcount=VDRCount;
     queue = new cPaketQueue("DEMUX",5640);
     skipped=0;
@@ -1306,7 +1325,11 @@ int cDemux::Process(uchar *Data, int Count, AvPacket *pkt)
         case 0xE0:
             if (!pes2videoes)
             {
-                if (h264)
+                if (vtype==PACKET_H265)
+                {
+                    pes2videoes=new cPES2ES(PACKET_H265,"PES2H265ES",524288);
+                }
+                else if (vtype==PACKET_H264)
                 {
                     pes2videoes=new cPES2ES(PACKET_H264,"PES2H264ES",524288);
                 }
@@ -1350,9 +1373,13 @@ int cDemux::Process(uchar *Data, int Count, AvPacket *pkt)
         {
             if (!ts2pkt_vpid)
             {
-                if (h264)
+                if (vtype==PACKET_H265)
+                {
+                    ts2pkt_vpid=new cTS2Pkt(vpid,"TS2H265",819200,PACKET_H265);
+                }
+                else if (vtype==PACKET_H264)
                 {
-                    ts2pkt_vpid=new cTS2Pkt(vpid,"TS2H264",819200,true);
+                    ts2pkt_vpid=new cTS2Pkt(vpid,"TS2H264",819200,PACKET_H264);
                 }
                 else
                 {
@@ -1368,7 +1395,11 @@ int cDemux::Process(uchar *Data, int Count, AvPacket *pkt)
                 if (!pes2videoes)
                 {
                     ts2pkt_vpid->Resize(3*tpkt.Length,"TS2PES");
-                    if (h264)
+                    if (vtype==PACKET_H265)
+                    {
+                        pes2videoes=new cPES2ES(PACKET_H265,"PES2H265ES",589824);
+                    }
+                    else if (vtype==PACKET_H264)
                     {
                         pes2videoes=new cPES2ES(PACKET_H264,"PES2H264ES",589824);
                     }
@@ -18,6 +18,7 @@ typedef unsigned char uchar;
 #define PACKET_VIDEO 0x10
 #define PACKET_H262  0x10 // 0x00 0x00 0x01 (PES / H262)
 #define PACKET_H264  0x11 // 0x00 0x00 0x00 0x01 (H264)
+#define PACKET_H265  0x12 // 0x00 0x00 0x00 0x01 (H265)
 #define PACKET_AUDIO 0x20
 #define PACKET_AC3   0x20
 #define PACKET_MP2   0x21
@@ -239,10 +240,10 @@ private:
     int skipped;
     int pid;
     int lasterror;
-    bool h264;
+    int type;
     bool noticeFILLER;
 public:
-    cTS2Pkt(int Pid, const char *QueueName="TS2Pkt", int QueueSize=32768, bool H264=false);
+    cTS2Pkt(int Pid, const char *QueueName="TS2Pkt", int QueueSize=32768, int Type=PACKET_H262);
     ~cTS2Pkt();
     void Clear(AvPacket *Pkt=NULL);
     int Skipped()
@@ -323,7 +324,7 @@ private:
     int stream_or_pid;
     int skipped;
     int lasterror;
-    bool h264;
+    int vtype;
     bool TS;
     uint64_t offset;
     uint64_t rawoffset;
@@ -350,7 +351,8 @@ private:
     bool isvideopes(uchar *data, int count);
     int fillqueue(uchar *data, int count, int &stream_or_pid, int &packetsize, int &readout);
 public:
-    cDemux(int VPid, int DPid, int APid, bool H264=false, bool VDRCount=false, bool RAW=false);
+    // VideoType is PACKET_H262, PACKET_H264 or PACKET_H265
+    cDemux(int VPid, int DPid, int APid, int VideoType=PACKET_H262, bool VDRCount=false, bool RAW=false);
     ~cDemux();
     void DisableDPid();
     void Clear();
@@ -0,0 +1,61 @@
+/*
+ * follow.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+#include "follow.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdFollow::cMarkAdFollow(const char *Directory)
+{
+    wd=-1;
+    fd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if (fd==-1)
+    {
+        esyslog("cannot initialize inotify (%i)",errno);
+        return;
+    }
+    // watching the directory covers index, current and following files
+    wd=inotify_add_watch(fd,Directory,IN_MODIFY|IN_CREATE|IN_MOVED_TO|IN_CLOSE_WRITE);
+    if (wd==-1)
+    {
+        esyslog("cannot watch %s (%i)",Directory,errno);
+        close(fd);
+        fd=-1;
+    }
+}
+
+cMarkAdFollow::~cMarkAdFollow()
+{
+    if (fd!=-1) close(fd);
+}
+
+int cMarkAdFollow::Wait(int Timeout)
+{
+    // returns 1 if something changed, 0 on timeout, -1 on error
+    if (wd==-1) return -1;
+
+    struct pollfd fds;
+    fds.fd=fd;
+    fds.events=POLLIN;
+    fds.revents=0;
+    int ret=poll(&fds,1,Timeout);
+    if (ret==-1) return (errno==EINTR) ? 0 : -1;
+    if (!ret) return 0;
+
+    // we only need to know that something happened
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (read(fd,buf,sizeof(buf))>0) ;
+    return 1;
+}
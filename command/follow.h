@@ -0,0 +1,29 @@
+/*
+ * follow.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __follow_h_
+#define __follow_h_
+
+// --- cMarkAdFollow
+// watches the recording directory (inotify) while the recording is
+// still written, so we can continue as soon as new data arrives
+class cMarkAdFollow
+{
+private:
+    int fd;
+    int wd;
+public:
+    cMarkAdFollow(const char *Directory);
+    ~cMarkAdFollow();
+    bool Available()
+    {
+        return (wd!=-1);
+    }
+    int Wait(int Timeout);
+};
+
+#endif
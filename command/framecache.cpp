@@ -0,0 +1,137 @@
+/*
+ * framecache.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framecache.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdFrameCache::cMarkAdFrameCache(int SizeMB)
+{
+    slots=NULL;
+    maxslots=0;
+    count=0;
+    usecnt=0;
+    maxbytes=(long) SizeMB*1024*1024;
+    bytes=0;
+    hits=0;
+    misses=0;
+}
+
+cMarkAdFrameCache::~cMarkAdFrameCache()
+{
+    Clear();
+    if (slots) free(slots);
+}
+
+void cMarkAdFrameCache::drop(int Slot)
+{
+    free(slots[Slot].Frame.Plane);
+    bytes-=slots[Slot].Size;
+    count--;
+    if (Slot!=count) slots[Slot]=slots[count];
+}
+
+void cMarkAdFrameCache::Clear()
+{
+    while (count) drop(count-1);
+}
+
+const MarkAdFrame *cMarkAdFrameCache::Get(int FrameNumber)
+{
+    for (int i=0; i<count; i++)
+    {
+        if (slots[i].Frame.FrameNumber==FrameNumber)
+        {
+            slots[i].LastUse=++usecnt;
+            hits++;
+            return &slots[i].Frame;
+        }
+    }
+    misses++;
+    return NULL;
+}
+
+const MarkAdFrame *cMarkAdFrameCache::Put(int FrameNumber, MarkAdContext *maContext)
+{
+    if (!maContext) return NULL;
+    if (!maContext->Video.Data.Valid) return NULL;
+    if (!maContext->Video.Data.Plane[0]) return NULL;
+
+    int shift=0;
+    while ((maContext->Video.Info.Width>>shift)>FRAMECACHE_WIDTH) shift++;
+    int width=maContext->Video.Info.Width>>shift;
+    int height=maContext->Video.Info.Height>>shift;
+    int size=width*height;
+    if (size<=0) return NULL;
+
+    for (int i=0; i<count; i++)
+    {
+        if (slots[i].Frame.FrameNumber==FrameNumber)
+        {
+            drop(i);
+            break;
+        }
+    }
+
+    // make room, least recently used first
+    while ((count) && (bytes+size>maxbytes))
+    {
+        int lru=0;
+        for (int i=1; i<count; i++)
+        {
+            if (slots[i].LastUse<slots[lru].LastUse) lru=i;
+        }
+        drop(lru);
+    }
+
+    if (count>=maxslots)
+    {
+        int max=maxslots ? maxslots*2 : 64;
+        struct slot *tmp=(struct slot *) realloc(slots,max*sizeof(struct slot));
+        if (!tmp) return NULL;
+        slots=tmp;
+        maxslots=max;
+    }
+
+    uchar *plane=(uchar *) malloc(size);
+    if (!plane)
+    {
+        esyslog("out of memory");
+        return NULL;
+    }
+    uchar *src=maContext->Video.Data.Plane[0];
+    int linesize=maContext->Video.Data.PlaneLinesize[0];
+    for (int Y=0; Y<height; Y++)
+    {
+        uchar *line=src+((Y<<shift)*linesize);
+        if (!shift)
+        {
+            memcpy(plane+(Y*width),line,width);
+        }
+        else
+        {
+            for (int X=0; X<width; X++) plane[X+(Y*width)]=line[X<<shift];
+        }
+    }
+
+    struct slot *slot=&slots[count++];
+    slot->Frame.FrameNumber=FrameNumber;
+    slot->Frame.Width=width;
+    slot->Frame.Height=height;
+    slot->Frame.Shift=shift;
+    slot->Frame.Plane=plane;
+    slot->Size=size;
+    slot->LastUse=++usecnt;
+    bytes+=size;
+    return &slot->Frame;
+}
@@ -0,0 +1,54 @@
+/*
+ * framecache.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __framecache_h_
+#define __framecache_h_
+
+#include "global.h"
+
+#define FRAMECACHE_SIZE 64  // MB for decoded frames
+#define FRAMECACHE_WIDTH 960 // wider frames are subsampled
+
+// --- cMarkAdFrameCache
+// luma of decoded iframes, least recently used frames are dropped
+// first. Frames wider than FRAMECACHE_WIDTH are subsampled, so
+// HD recordings fit in the same memory. Returned frames are only
+// valid till the next Put().
+class cMarkAdFrameCache
+{
+private:
+    struct slot
+    {
+        MarkAdFrame Frame;
+        int Size;
+        unsigned int LastUse;
+    } *slots;
+    int maxslots;
+    int count;
+    unsigned int usecnt;
+    long maxbytes;
+    long bytes;
+    int hits;
+    int misses;
+    void drop(int Slot);
+public:
+    cMarkAdFrameCache(int SizeMB=FRAMECACHE_SIZE);
+    ~cMarkAdFrameCache();
+    const MarkAdFrame *Get(int FrameNumber);
+    const MarkAdFrame *Put(int FrameNumber, MarkAdContext *maContext);
+    void Clear();
+    int Hits()
+    {
+        return hits;
+    }
+    int Misses()
+    {
+        return misses;
+    }
+};
+
+#endif
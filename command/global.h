@@ -49,6 +49,10 @@ typedef unsigned char uchar;
 #define MT_CHANNELSTART   (unsigned char) 0x61
 #define MT_CHANNELSTOP    (unsigned char) 0x62
 
+#define MT_BLACKCHANGE    (unsigned char) 0x70
+#define MT_BLACKSTART     (unsigned char) 0x71
+#define MT_BLACKSTOP      (unsigned char) 0x72
+
 #define MT_RECORDINGSTART (unsigned char) 0xD1
 #define MT_RECORDINGSTOP  (unsigned char) 0xD2
 #define MT_MOVED          (unsigned char) 0xE0
@@ -60,6 +64,7 @@ typedef struct config
     char LogoDir[1024];
     char markFileName[1024];
     char svdrphost[1024];
+    char dumpFrames[1024];
 
     int logoExtraction;
     int logoWidth;
@@ -68,6 +73,8 @@ typedef struct config
     int svdrpport;
     int threads;
     int astopoffs;
+    int parallel;
+    int Verbose;
 
     bool DecodeVideo;
     bool DecodeAudio;
@@ -77,7 +84,11 @@ typedef struct config
     bool OSD;
     bool Before;
     bool GenIndex;
+    bool IndexOnly;
+    bool IndexSync;
+    bool Pass3Only;
     bool SaveInfo;
+    bool Log2Rec;
 } MarkAdConfig;
 
 typedef struct MarkAdPos
@@ -86,12 +97,40 @@ typedef struct MarkAdPos
     int FrameNumberAfter;
 } MarkAdPos;
 
+typedef struct MarkAdFrame
+{
+    int FrameNumber;
+    int Width;      // of Plane
+    int Height;
+    int Shift;      // Plane is subsampled by 1<<Shift in both directions
+    uchar *Plane;   // luma
+} MarkAdFrame;
+
 typedef struct MarkAdAspectRatio
 {
     int Num;
     int Den;
 } MarkAdAspectRatio;
 
+// what the video detectors measured on one picture, the
+// decisions are made later, see cMarkAdVideo::Decide
+typedef struct MarkAdVideoFeatures
+{
+    int Valid;                     // picture decoded
+    MarkAdAspectRatio AspectRatio;
+    int LogoResult;                // LOGO_VISIBLE if the values below are set
+    int LogoRPixel;                // black pixel in result
+    int LogoMPixel;                // black pixel in mask
+    int LogoPlanes;                // processed planes
+    int LogoIntensity;             // brightness of the logo area
+    int HBorderBottom;             // brightness, -1 not measured
+    int HBorderTop;
+    int VBorderLeft;
+    int VBorderRight;
+    int FrameMean;                 // brightness of the picture, -1 not measured
+    int FrameVariance;
+} MarkAdVideoFeatures;
+
 typedef struct MarkAdMark
 {
     int Type;
@@ -104,13 +143,14 @@ typedef struct MarkAdMark
 
 typedef struct MarkAdMarks
 {
-    static const int maxCount=4;
+    static const int maxCount=6;
     MarkAdMark Number[maxCount];
     int Count;
 } MarkAdMarks;
 
 #define MARKAD_PIDTYPE_VIDEO_H262 0x10
 #define MARKAD_PIDTYPE_VIDEO_H264 0x11
+#define MARKAD_PIDTYPE_VIDEO_H265 0x12
 #define MARKAD_PIDTYPE_AUDIO_AC3  0x20
 #define MARKAD_PIDTYPE_AUDIO_MP2  0x21
 
@@ -0,0 +1,359 @@
+/*
+ * kernels.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "global.h"
+#include "video.h"
+#include "sobel.h"
+#include "startcode.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+// markad-kernels checks the specialized detector kernels and the
+// start code search against the generic code they replaced on random
+// data and measures both
+
+#define KERNELS_WIDTH    1920
+#define KERNELS_HEIGHT   1080
+#define KERNELS_LINESIZE 2048 // with padding like the decoder
+
+int SysLogLevel=1;
+__thread int SysLogLevelJob=0;
+
+void syslog_with_tid(int priority, const char *format, ...)
+{
+    (void) priority;
+    va_list ap;
+    va_start(ap,format);
+    vfprintf(stderr,format,ap);
+    va_end(ap);
+    fputc('\n',stderr);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1000.0+ts.tv_nsec/1e6;
+}
+
+static unsigned int rnd(unsigned int *State)
+{
+    // xorshift, the same pictures on every run
+    unsigned int x=*State;
+    x^=x<<13;
+    x^=x>>17;
+    x^=x<<5;
+    return *State=x;
+}
+
+static void fill(uchar *Plane, int Size, unsigned int *State)
+{
+    // flat areas with noise and hard edges between them
+    int base=rnd(State) & 0xFF;
+    for (int i=0; i<Size; i++)
+    {
+        unsigned int r=rnd(State);
+        if (!(r & 0x3F)) base=(r>>8) & 0xFF;
+        Plane[i]=(uchar) (base+(r>>16)%9);
+    }
+}
+
+// --- sobel
+
+// the operator as cMarkAdLogo::SobelPlane did it before the kernels,
+// per pixel with the boundary test and the 3x3 masks
+static int sobelgeneric(const uchar *Plane, int Linesize, int XStart, int YStart,
+                        int Width, int Height, int PlaneNo, const uchar *Mask,
+                        uchar *Sobel, uchar *Result, int *Intensity)
+{
+    static const int GX[3][3]= { { -1,0,1 }, { -2,0,2 }, { -1,0,1 } };
+    static const int GY[3][3]= { { 1,2,1 }, { 0,0,0 }, { -1,-2,-1 } };
+
+    int boundary=6;
+    int cutval=127;
+    if (PlaneNo>0)
+    {
+        boundary/=2;
+        cutval/=2;
+    }
+    int xend=XStart+Width,yend=YStart+Height;
+    int rpixel=0;
+    *Intensity=0;
+    for (int Y=YStart; Y<=yend-1; Y++)
+    {
+        for (int X=XStart; X<=xend-1; X++)
+        {
+            if (!PlaneNo) *Intensity+=Plane[X+Y*Linesize];
+            int sum=0;
+            if ((Y>=(YStart+boundary)) && (Y<=(yend-boundary)) &&
+                    (X>=(XStart+boundary)) && (X<=(xend-boundary)))
+            {
+                int sumX=0,sumY=0;
+                for (int I=-1; I<=1; I++)
+                {
+                    for (int J=-1; J<=1; J++)
+                    {
+                        sumX+=Plane[X+I+(Y+J)*Linesize]*GX[I+1][J+1];
+                        sumY+=Plane[X+I+(Y+J)*Linesize]*GY[I+1][J+1];
+                    }
+                }
+                sum=abs(sumX)+abs(sumY);
+            }
+            sum=(sum>=cutval) ? 255 : 0;
+            int val=255-sum;
+            int pos=(X-XStart)+(Y-YStart)*Width;
+            Sobel[pos]=val;
+            Result[pos]=(Mask[pos]+val) & 255;
+            if (!Result[pos]) rpixel++;
+        }
+    }
+    return rpixel;
+}
+
+static int sobelspecialized(const uchar *Plane, int Linesize, int XStart, int YStart,
+                            int Width, int Height, int PlaneNo, const uchar *Mask,
+                            uchar *Sobel, uchar *Result, int *Intensity)
+{
+    const uchar *src=Plane+XStart+YStart*Linesize;
+    *Intensity=0;
+    if (!PlaneNo) return sobelkernel<0>(src,Linesize,Width,Height,Mask,Sobel,Result,Intensity);
+    return sobelkernel<1>(src,Linesize,Width,Height,Mask,Sobel,Result,Intensity);
+}
+
+static bool sobel(int Rounds, bool Bench)
+{
+    static uchar planes[3][KERNELS_LINESIZE*KERNELS_HEIGHT];
+    static uchar mask[MAXPIXEL],sobel1[MAXPIXEL],sobel2[MAXPIXEL],result1[MAXPIXEL],result2[MAXPIXEL];
+    // logo sizes of HD and SD
+    const int sizes[2][2]= { { LOGO_DEFHDWIDTH,LOGO_DEFHDHEIGHT }, { LOGO_DEFWIDTH,LOGO_DEFHEIGHT } };
+
+    unsigned int state=0x2545F491;
+    int checked=0,failed=0;
+    for (int round=0; round<Rounds; round++)
+    {
+        fill(planes[0],KERNELS_LINESIZE*KERNELS_HEIGHT,&state);
+        fill(planes[1],KERNELS_LINESIZE/2*KERNELS_HEIGHT/2,&state);
+        fill(planes[2],KERNELS_LINESIZE/2*KERNELS_HEIGHT/2,&state);
+        for (int i=0; i<MAXPIXEL; i++) mask[i]=(rnd(&state) & 1) ? 255 : 0;
+
+        for (int size=0; size<2; size++)
+        {
+            for (int corner=0; corner<4; corner++)
+            {
+                for (int plane=0; plane<3; plane++)
+                {
+                    int width=sizes[size][0],height=sizes[size][1];
+                    int xstart=(corner & 1) ? KERNELS_WIDTH-width : 0;
+                    int ystart=(corner & 2) ? KERNELS_HEIGHT-height : 0;
+                    int linesize=KERNELS_LINESIZE;
+                    if (plane>0)
+                    {
+                        xstart/=2;
+                        ystart/=2;
+                        width/=2;
+                        height/=2;
+                        linesize/=2;
+                    }
+                    int i1,i2;
+                    int r1=sobelgeneric(planes[plane],linesize,xstart,ystart,width,height,plane,
+                                        mask,sobel1,result1,&i1);
+                    int r2=sobelspecialized(planes[plane],linesize,xstart,ystart,width,height,plane,
+                                            mask,sobel2,result2,&i2);
+                    checked++;
+                    if ((r1!=r2) || (i1!=i2) || (memcmp(sobel1,sobel2,width*height)) ||
+                            (memcmp(result1,result2,width*height)))
+                    {
+                        if (!failed)
+                            esyslog("sobel differs in round %i, %ix%i corner %i plane %i: rpixel %i/%i intensity %i/%i",
+                                    round,width,height,corner,plane,r1,r2,i1,i2);
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+    printf("sobel: %i planes, %i differ\n",checked,failed);
+
+    if (Bench)
+    {
+        // HD luma and both chroma planes of the top right corner, like
+        // cMarkAdLogo does for every frame
+        const int loops=2000;
+        double ms[2];
+        for (int k=0; k<2; k++)
+        {
+            int (*fn)(const uchar *,int,int,int,int,int,int,const uchar *,uchar *,uchar *,int *)=
+                k ? sobelspecialized : sobelgeneric;
+            double start=now();
+            int sum=0;
+            for (int l=0; l<loops; l++)
+            {
+                for (int plane=0; plane<3; plane++)
+                {
+                    int s=plane ? 1 : 0;
+                    int width=LOGO_DEFHDWIDTH>>s,height=LOGO_DEFHDHEIGHT>>s;
+                    int intensity;
+                    sum+=fn(planes[plane],KERNELS_LINESIZE>>s,(KERNELS_WIDTH>>s)-width,0,width,height,
+                            plane,mask,sobel1,result1,&intensity);
+                }
+            }
+            ms[k]=now()-start;
+            if (sum==-1) printf("\n"); // keep the loop
+        }
+        printf("sobel: generic %.2f us, specialized %.2f us per frame (%.1fx)\n",
+               ms[0]*1000/loops,ms[1]*1000/loops,(ms[1]>0) ? ms[0]/ms[1] : 0);
+    }
+    return (!failed);
+}
+
+// --- start codes
+
+// byte by byte like the scanner of cPaketQueue before FindStartCode
+static int startcodegeneric(const uchar *Data, int Len)
+{
+    unsigned int scanner=0xFFFFFFFF;
+    for (int i=0; i<Len; i++)
+    {
+        scanner<<=8;
+        scanner|=Data[i];
+        if ((scanner & 0x00FFFFFF)==0x00000001) return i-2;
+    }
+    return -1;
+}
+
+static bool startcode(int Rounds, bool Bench)
+{
+    // short buffers with many zeros hit the tails of the vector loops
+    static uchar buf[4096+64];
+    unsigned int state=0x9E3779B9;
+    int checked=0,failed=0;
+    for (int round=0; round<Rounds*20000; round++)
+    {
+        int len=rnd(&state)%300;
+        int zeros=rnd(&state)%4;
+        for (int i=0; i<len+8; i++)
+        {
+            unsigned int r=rnd(&state)%(zeros+2);
+            buf[i]=(r==0) ? 0 : ((r==1) ? 1 : (uchar) (rnd(&state)>>8));
+        }
+        int off=rnd(&state)%8;
+        if (off>len) off=len;
+        int r1=startcodegeneric(buf+off,len-off);
+        int r2=FindStartCode(buf+off,len-off);
+        checked++;
+        if (r1!=r2)
+        {
+            if (!failed) esyslog("start code differs, length %i offset %i: %i/%i",len,off,r1,r2);
+            failed++;
+        }
+    }
+    printf("startcode: %i buffers, %i differ\n",checked,failed);
+
+    if (Bench)
+    {
+        // TS payload with a start code every 4kB, all of them are searched
+        const int size=8*1024*1024,loops=20;
+        uchar *data=(uchar *) malloc(size);
+        if (!data) return false;
+        for (int i=0; i<size; i++)
+        {
+            data[i]=(uchar) (rnd(&state)>>8);
+            if (data[i]<2) data[i]=2;
+        }
+        for (int i=4096; i+3<size; i+=4096)
+        {
+            data[i]=data[i+1]=0;
+            data[i+2]=1;
+        }
+        double ms[2];
+        for (int k=0; k<2; k++)
+        {
+            int (*fn)(const uchar *,int)=k ? FindStartCode : startcodegeneric;
+            double start=now();
+            int found=0;
+            for (int l=0; l<loops; l++)
+            {
+                int pos=0,ret;
+                while ((ret=fn(data+pos,size-pos))!=-1)
+                {
+                    found++;
+                    pos+=ret+3;
+                }
+            }
+            ms[k]=now()-start;
+            if (found==-1) printf("\n"); // keep the loop
+        }
+        double mb=(double) size*loops/(1024*1024);
+        printf("startcode: generic %.0f MB/s, FindStartCode %.0f MB/s (%.1fx)\n",
+               (ms[0]>0) ? mb*1000/ms[0] : 0,(ms[1]>0) ? mb*1000/ms[1] : 0,
+               (ms[1]>0) ? ms[0]/ms[1] : 0);
+        free(data);
+    }
+    return (!failed);
+}
+
+static int usage()
+{
+    printf("Usage: markad-kernels [options]\n"
+           "options:\n"
+           "-b              --bench\n"
+           "                  measure the kernels after checking them\n"
+           "-r              --rounds=<count>\n"
+           "                  random pictures to check (default 20), 20000\n"
+           "                  buffers for the start codes per round\n"
+           "\n"
+           "checks the specialized detector kernels and the start code\n"
+           "search against the generic code, exits with 1 if they differ\n"
+          );
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds=20;
+    bool bench=false;
+
+    static struct option long_options[] =
+    {
+        {"bench",0,0,'b'},
+        {"rounds",1,0,'r'},
+        {"help",0,0,'h'},
+        {0,0,0,0}
+    };
+
+    int c;
+    while ((c=getopt_long(argc,argv,"br:h",long_options,NULL))!=-1)
+    {
+        switch (c)
+        {
+        case 'b':
+            bench=true;
+            break;
+        case 'r':
+            rounds=atoi(optarg);
+            if (rounds<1) rounds=1;
+            break;
+        default:
+            return usage();
+        }
+    }
+    if (optind<argc) return usage();
+
+    bool ok=sobel(rounds,bench);
+    if (!startcode(rounds,bench)) ok=false;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+ * livestream.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "livestream.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdLiveStream::cMarkAdLiveStream(const char *Directory)
+{
+    ring=NULL;
+    tail=0;
+
+    char name[64];
+    if (!markad_ring_name(Directory,name,sizeof(name))) return;
+    int fd=shm_open(name,O_RDWR,0);
+    if (fd==-1)
+    {
+        if (errno!=ENOENT) esyslog("cannot open live stream %s (%i)",name,errno);
+        return;
+    }
+    void *p=mmap(NULL,sizeof(struct markad_ring),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED)
+    {
+        esyslog("cannot map live stream %s (%i)",name,errno);
+        return;
+    }
+    ring=(struct markad_ring *) p;
+    if ((ring->magic!=MARKAD_RING_MAGIC) || (ring->size!=MARKAD_RING_SIZE))
+    {
+        esyslog("live stream %s has wrong format",name);
+        munmap(p,sizeof(struct markad_ring));
+        ring=NULL;
+        return;
+    }
+    isyslog("found live stream %s",name);
+}
+
+cMarkAdLiveStream::~cMarkAdLiveStream()
+{
+    if (!ring) return;
+    ring->attached=0;
+    munmap(ring,sizeof(struct markad_ring));
+}
+
+bool cMarkAdLiveStream::Attach(const uchar *Packet)
+{
+    // search the last packet we got from disk, the stream
+    // continues right after it
+    if (!ring) return false;
+    if (ring->attached) return true;
+    if (ring->flags & MARKAD_RING_DONE) return false;
+
+    uint64_t head=ring->head;
+    __sync_synchronize();
+    if (head<MARKAD_RING_PACKET) return false;
+    uint64_t start=0;
+    if (head>ring->size-MARKAD_RING_MARGIN) start=head-(ring->size-MARKAD_RING_MARGIN);
+
+    uint64_t pos=head-MARKAD_RING_PACKET;
+    for (;;)
+    {
+        // packets never wrap, size is a multiple of the packet size
+        uchar *p=ring->data+(pos % ring->size);
+        if ((p[1]==Packet[1]) && (p[2]==Packet[2]) && (p[3]==Packet[3]) &&
+                (!memcmp(p,Packet,MARKAD_RING_PACKET))) break;
+        if (pos<start+MARKAD_RING_PACKET) return false;
+        pos-=MARKAD_RING_PACKET;
+    }
+
+    tail=pos+MARKAD_RING_PACKET;
+    ring->tail=tail;
+    __sync_synchronize();
+    ring->attached=1;
+    __sync_synchronize();
+
+    // the writer may have reached the packet meanwhile
+    if ((ring->head+MARKAD_RING_MARGIN-tail>ring->size) ||
+            (memcmp(ring->data+(pos % ring->size),Packet,MARKAD_RING_PACKET)))
+    {
+        ring->attached=0;
+        return false;
+    }
+    dsyslog("attached to live stream, %lli bytes behind",(long long) (ring->head-tail));
+    return true;
+}
+
+int cMarkAdLiveStream::Read(uchar *Data, int Size)
+{
+    // returns number of bytes, 0 if there is no new data,
+    // LIVE_LOST or LIVE_DONE
+    if (!ring) return LIVE_DONE;
+    if (!ring->attached) return LIVE_LOST;
+    uint32_t flags=ring->flags;
+    __sync_synchronize();
+    uint64_t avail=ring->head-tail;
+    if (!avail) return (flags & MARKAD_RING_DONE) ? LIVE_DONE : 0;
+    if (avail>(uint64_t) Size) avail=Size;
+
+    int pos=tail % ring->size;
+    int len=ring->size-pos;
+    if (len>(int) avail) len=(int) avail;
+    memcpy(Data,ring->data+pos,len);
+    if (len<(int) avail) memcpy(Data+len,ring->data,avail-len);
+    __sync_synchronize();
+    // the writer detaches us before overwriting unread data
+    if (!ring->attached) return LIVE_LOST;
+
+    tail+=avail;
+    ring->tail=tail;
+    return (int) avail;
+}
@@ -0,0 +1,35 @@
+/*
+ * livestream.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __livestream_h_
+#define __livestream_h_
+
+#include "global.h"
+#include "ring.h"
+
+#define LIVE_LOST -1 // detached, continue from disk
+#define LIVE_DONE -2 // recording stopped
+
+// --- cMarkAdLiveStream
+// reader of the shared memory ring filled by the plugin
+class cMarkAdLiveStream
+{
+private:
+    struct markad_ring *ring;
+    uint64_t tail;
+public:
+    cMarkAdLiveStream(const char *Directory);
+    ~cMarkAdLiveStream();
+    bool Available()
+    {
+        return (ring!=NULL);
+    }
+    bool Attach(const uchar *Packet);
+    int Read(uchar *Data, int Size);
+};
+
+#endif
@@ -32,12 +32,29 @@
 #include <dirent.h>
 
 #include "markad-standalone.h"
+#include "daemon.h"
 #include "version.h"
 
 bool SYSLOG=false;
 bool LOG2REC=false;
 cMarkAdStandalone *cmasta=NULL;
+cMarkAdDaemon *cmdaemon=NULL;
 int SysLogLevel=2;
+__thread int SysLogLevelJob=0;
+static __thread FILE *LOGFILE=NULL; // markad.log of a daemon job
+
+static const char *VideoTypeName(int Type)
+{
+    switch (Type)
+    {
+    case MARKAD_PIDTYPE_VIDEO_H264:
+        return "H264";
+    case MARKAD_PIDTYPE_VIDEO_H265:
+        return "H265";
+    default:
+        return "H262";
+    }
+}
 
 static inline int ioprio_set(int which, int who, int ioprio)
 {
@@ -63,7 +80,7 @@ static inline int ioprio_set(int which, int who, int ioprio)
 void syslog_with_tid(int priority, const char *format, ...)
 {
     va_list ap;
-    if ((SYSLOG) && (!LOG2REC))
+    if ((SYSLOG) && (!LOG2REC) && (!LOGFILE))
     {
         char fmt[255];
         snprintf(fmt, sizeof(fmt), "[%d] %s", getpid(), format);
@@ -79,12 +96,13 @@ void syslog_with_tid(int priority, const char *format, ...)
             buf[strlen(buf)-6]=0;
         }
         char fmt[255];
-        snprintf(fmt, sizeof(fmt), "%s%s [%d] %s", LOG2REC ? "":"markad: ",buf, getpid(), format);
+        snprintf(fmt, sizeof(fmt), "%s%s [%d] %s", (LOG2REC || LOGFILE) ? "":"markad: ",buf, getpid(), format);
+        FILE *out=LOGFILE ? LOGFILE : stdout;
         va_start(ap, format);
-        vprintf(fmt,ap);
+        vfprintf(out,fmt,ap);
         va_end(ap);
-        printf("\n");
-        fflush(stdout);
+        fprintf(out,"\n");
+        fflush(out);
     }
 }
 
@@ -283,8 +301,22 @@ void cMarkAdStandalone::CheckStart()
     dsyslog("checking start");
     clMark *begin=NULL;
 
-    if ((macontext.Info.Channels) && (macontext.Audio.Info.Channels) &&
-            (macontext.Info.Channels!=macontext.Audio.Info.Channels))
+    // channels and aspectratio seen most since the assumed start,
+    // a short advertisement at chkSTART shouldn't change them
+    int channels=columns.Channels(iStart,lastiframe);
+    if (!channels) channels=macontext.Audio.Info.Channels;
+    MarkAdAspectRatio aspect;
+    if (!columns.Aspect(iStart,lastiframe,&aspect)) aspect=macontext.Video.Info.AspectRatio;
+    if ((channels!=macontext.Audio.Info.Channels) || (aspect.Num!=macontext.Video.Info.AspectRatio.Num) ||
+            (aspect.Den!=macontext.Video.Info.AspectRatio.Den))
+    {
+        dsyslog("since start %i channels with %i:%i, actual %i channels with %i:%i",
+                channels,aspect.Num,aspect.Den,macontext.Audio.Info.Channels,
+                macontext.Video.Info.AspectRatio.Num,macontext.Video.Info.AspectRatio.Den);
+    }
+
+    if ((macontext.Info.Channels) && (channels) &&
+            (macontext.Info.Channels!=channels))
     {
         char as[20];
         switch (macontext.Info.Channels)
@@ -303,7 +335,7 @@ void cMarkAdStandalone::CheckStart()
             break;
         }
         char ad[20];
-        switch (macontext.Audio.Info.Channels)
+        switch (channels)
         {
         case 1:
             strcpy(ad,"mono");
@@ -321,7 +353,7 @@ void cMarkAdStandalone::CheckStart()
         isyslog("audio description in info (%s) wrong, we have %s",as,ad);
     }
 
-    macontext.Info.Channels=macontext.Audio.Info.Channels;
+    macontext.Info.Channels=channels;
     if (macontext.Config->DecodeAudio) {
         if ((macontext.Info.Channels==6) && (macontext.Audio.Options.IgnoreDolbyDetection==false))
         {
@@ -348,31 +380,31 @@ void cMarkAdStandalone::CheckStart()
         }
     }
     if ((macontext.Info.AspectRatio.Num) && ((macontext.Info.AspectRatio.Num!=
-            macontext.Video.Info.AspectRatio.Num) || (macontext.Info.AspectRatio.Den!=
-                    macontext.Video.Info.AspectRatio.Den)))
+            aspect.Num) || (macontext.Info.AspectRatio.Den!=
+                    aspect.Den)))
     {
         isyslog("video aspect description in info (%i:%i) wrong",
                 macontext.Info.AspectRatio.Num,
                 macontext.Info.AspectRatio.Den);
     }
 
-    macontext.Info.AspectRatio.Num=macontext.Video.Info.AspectRatio.Num;
-    macontext.Info.AspectRatio.Den=macontext.Video.Info.AspectRatio.Den;
+    macontext.Info.AspectRatio.Num=aspect.Num;
+    macontext.Info.AspectRatio.Den=aspect.Den;
 
-    if (macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264) {
+    if (macontext.Info.VPid.Type!=MARKAD_PIDTYPE_VIDEO_H262) {
         isyslog("aspectratio of %i:%i detected",
-                macontext.Video.Info.AspectRatio.Num,
-                macontext.Video.Info.AspectRatio.Den);
+                aspect.Num,
+                aspect.Den);
     } else {
         isyslog("aspectratio of %i:%i detected%s",
-                macontext.Video.Info.AspectRatio.Num,
-                macontext.Video.Info.AspectRatio.Den,
-                ((macontext.Video.Info.AspectRatio.Num==4) &&
-                 (macontext.Video.Info.AspectRatio.Den==3)) ?
+                aspect.Num,
+                aspect.Den,
+                ((aspect.Num==4) &&
+                 (aspect.Den==3)) ?
                 ". logo/border detection disabled" : "");
 
-        if ((macontext.Video.Info.AspectRatio.Num==4) &&
-                (macontext.Video.Info.AspectRatio.Den==3))
+        if ((aspect.Num==4) &&
+                (aspect.Den==3))
         {
             bDecodeVideo=false;
             if (macontext.Info.Channels==6) {
@@ -408,8 +440,8 @@ void cMarkAdStandalone::CheckStart()
                 if (begin2->type>begin->type) {
                     if (begin2->type==MT_ASPECTSTART) {
                         // special case, only take this mark if aspectratio is 4:3
-                        if ((macontext.Video.Info.AspectRatio.Num==4) &&
-                                (macontext.Video.Info.AspectRatio.Den==3)) {
+                        if ((aspect.Num==4) &&
+                                (aspect.Den==3)) {
                             isyslog("mark on position %i stronger than mark on position %i as start mark",begin2->position,begin->position);
                             begin=begin2;
                         }
@@ -479,7 +511,19 @@ void cMarkAdStandalone::AddMark(MarkAdMark *Mark)
 {
     if (!Mark) return;
     if (!Mark->Type) return;
+    TRACE_EVENT(addmark,Mark->Position);
     if ((macontext.Config) && (macontext.Config->logoExtraction!=-1)) return;
+    if (parent)
+    {
+        AddSegEvent(sMARK,Mark);
+        return;
+    }
+    if ((Mark->Type & 0xF0)==MT_BLACKCHANGE)
+    {
+        // weak marks, only used to align the others in the 2nd pass
+        blackmarks.Add(Mark->Type,Mark->Position);
+        return;
+    }
     if (gotendmark) return;
 
     char *comment=NULL;
@@ -695,6 +739,7 @@ void cMarkAdStandalone::CheckIndexGrowing()
 #define WAITTIME 15
 
     if (!indexFile) return;
+    if (follow) return; // see WaitForData
     if (macontext.Config->logoExtraction!=-1) return;
     if (sleepcnt>=2) {
         dsyslog("slept too much");
@@ -782,6 +827,398 @@ void cMarkAdStandalone::CheckIndexGrowing()
     return;
 }
 
+bool cMarkAdStandalone::WaitForData(int File, int Number, int *PFrame, bool *Last)
+{
+    // we reached the end of the file, returns true if there is
+    // new data in this file (or the rest of it, if the next file
+    // appeared), false if the file is finished
+    if (!follow) return false;
+
+    char *nbuf;
+    if (isTS)
+    {
+        if (asprintf(&nbuf,"%s/%05i.ts",directory,Number+1)==-1) return false;
+    }
+    else
+    {
+        if (asprintf(&nbuf,"%s/%03i.vdr",directory,Number+1)==-1) return false;
+    }
+
+    marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS);
+
+    bool ret=false;
+    struct stat statbuf;
+    // data written between the last read and now counts too
+    off_t pos=lseek(File,0,SEEK_CUR);
+    time_t idle=0;
+    for (;;)
+    {
+        if (abort) break;
+        if ((live) && (livepktValid) && (live->Attach(livepkt)))
+        {
+            int lret=ProcessLive(Number,PFrame);
+            livepktValid=false;
+            if (lret==LIVE_DONE) liveDone=true;
+            if ((lret==LIVE_LOST) && (!abort)) SeekLivePacket();
+            break;
+        }
+        if (access(nbuf,F_OK)!=-1)
+        {
+            // rollover, read the rest of the current file
+            *Last=true;
+            ret=true;
+            break;
+        }
+        if (fstat(File,&statbuf)==-1) break;
+        if (pos==-1) pos=statbuf.st_size;
+        if (statbuf.st_size>pos)
+        {
+            if (iwaittime)
+            {
+                esyslog("resuming after %is of interrupted recording, marks can be wrong now!",iwaittime);
+                iwaittime=0;
+            }
+            ret=true;
+            break;
+        }
+        if ((difftime(time(NULL),statbuf.st_mtime))>=WAITTIME)
+        {
+            if ((!length) || (!startTime))
+            {
+                dsyslog("assuming old recording - no length and startTime");
+                break;
+            }
+            if (time(NULL)>(startTime+(time_t) length))
+            {
+                tsyslog("assuming old recording, now>startTime+length");
+                break;
+            }
+            if (!iwaittime) esyslog("recording interrupted, waiting for continuation...");
+            if (time(NULL)!=idle)
+            {
+                idle=time(NULL);
+                iwaittime++;
+            }
+        }
+        time_t waitstart=time(NULL);
+        if (follow->Wait(1000)==-1) break;
+        waittime+=(int) difftime(time(NULL),waitstart);
+    }
+    free(nbuf);
+    return ret;
+}
+
+// state of cMarkAdStandalone in the checkpoint
+struct ckpstate
+{
+    int framecnt;
+    int lastiframe;
+    int iframe;
+    int iStart;
+    int iStop;
+    int iStopA;
+    int chkSTART;
+    int chkSTOP;
+    bool iStopinBroadCast;
+    bool inBroadCast;
+    bool bDecodeVideo;
+    int Channels;
+    MarkAdAspectRatio AspectRatio;
+    int DPid;
+};
+
+void cMarkAdStandalone::SaveCheckpoint()
+{
+    // called before the iframe framecnt is processed
+    lastcheckpoint=time(NULL);
+    if (!checkpoint->Create()) return;
+
+    struct ckpstate state;
+    memset(&state,0,sizeof(state));
+    state.framecnt=framecnt;
+    state.lastiframe=lastiframe;
+    state.iframe=iframe;
+    state.iStart=iStart;
+    state.iStop=iStop;
+    state.iStopA=iStopA;
+    state.chkSTART=chkSTART;
+    state.chkSTOP=chkSTOP;
+    state.iStopinBroadCast=iStopinBroadCast;
+    state.inBroadCast=inBroadCast;
+    state.bDecodeVideo=bDecodeVideo;
+    state.Channels=macontext.Info.Channels;
+    state.AspectRatio=macontext.Info.AspectRatio;
+    state.DPid=macontext.Info.DPid.Num;
+
+    checkpoint->PutString(VERSION);
+    checkpoint->Put(&state,sizeof(state));
+    checkpoint->Put(&macontext.Video.Options,sizeof(macontext.Video.Options));
+    checkpoint->Put(&macontext.Audio.Options,sizeof(macontext.Audio.Options));
+    video->SaveState(checkpoint);
+    audio->SaveState(checkpoint);
+    marks.SaveState(checkpoint);
+    blackmarks.SaveState(checkpoint);
+    columns.SaveState(checkpoint);
+    int tlcount=-1;
+    if ((timeline) && (timeline->Flush())) tlcount=timeline->Count();
+    checkpoint->Put(&tlcount,sizeof(tlcount));
+    if (checkpoint->Commit()) tsyslog("checkpoint at frame %i",framecnt);
+}
+
+bool cMarkAdStandalone::LoadCheckpoint()
+{
+    if (!checkpoint) return false;
+    if ((!video) || (!audio)) return false;
+    if (!checkpoint->Open()) return false;
+
+    char *version=checkpoint->GetString();
+    bool ok=((version) && (!strcmp(version,VERSION)));
+    if (version) free(version);
+
+    struct ckpstate state;
+    int number=0;
+    off_t offset=0;
+    if (ok) ok=checkpoint->Get(&state,sizeof(state));
+    if (ok) ok=marks.ReadIndexIFrame(directory,isTS,state.framecnt,&number,&offset);
+    if (ok) ok=checkpoint->Get(&macontext.Video.Options,sizeof(macontext.Video.Options));
+    if (ok) ok=checkpoint->Get(&macontext.Audio.Options,sizeof(macontext.Audio.Options));
+    if (ok) ok=video->LoadState(checkpoint);
+    if (ok) ok=audio->LoadState(checkpoint);
+    if (ok) ok=marks.LoadState(checkpoint);
+    if (ok) ok=blackmarks.LoadState(checkpoint);
+    if (ok) ok=columns.LoadState(checkpoint);
+    int tlcount=-1;
+    if (ok) ok=checkpoint->Get(&tlcount,sizeof(tlcount));
+    checkpoint->Close();
+    if (!ok)
+    {
+        isyslog("ignoring invalid checkpoint");
+        checkpoint->Remove();
+        Reset();
+        return false;
+    }
+
+    framecnt=state.framecnt;
+    lastiframe=state.lastiframe;
+    iframe=state.iframe;
+    iStart=state.iStart;
+    iStop=state.iStop;
+    iStopA=state.iStopA;
+    chkSTART=state.chkSTART;
+    chkSTOP=state.chkSTOP;
+    iStopinBroadCast=state.iStopinBroadCast;
+    inBroadCast=state.inBroadCast;
+    bDecodeVideo=state.bDecodeVideo;
+    if (!bDecodeVideo) macontext.Video.Data.Valid=false;
+    macontext.Info.Channels=state.Channels;
+    macontext.Info.AspectRatio=state.AspectRatio;
+    if ((macontext.Info.DPid.Num) && (!state.DPid))
+    {
+        macontext.Info.DPid.Num=0;
+        demux->DisableDPid();
+    }
+
+    if ((timeline) && (!timeline->Resume(tlcount)))
+    {
+        isyslog("timeline incomplete, --pass3only not possible");
+        delete timeline;
+        timeline=NULL;
+    }
+
+    resumeFile=number;
+    resumeOffset=offset;
+    lastcheckpoint=time(NULL);
+    isyslog("resuming at frame %i (file %05i) from checkpoint",framecnt,number);
+    return true;
+}
+
+int cMarkAdStandalone::LastPacket(const uchar *Data, int Length)
+{
+    // position of the last packet the demuxer uses
+    for (int i=(Length/MARKAD_RING_PACKET-1)*MARKAD_RING_PACKET; i>=0; i-=MARKAD_RING_PACKET)
+    {
+        const uchar *p=Data+i;
+        if (p[0]!=0x47) return -1; // not aligned
+        int pid=((p[1] & 0x1F)<<8) | p[2];
+        if (pid==macontext.Info.VPid.Num) return i;
+        if ((macontext.Info.DPid.Num>0) && (pid==macontext.Info.DPid.Num)) return i;
+        if ((macontext.Info.APid.Num>0) && (pid==macontext.Info.APid.Num)) return i;
+    }
+    return -1;
+}
+
+int cMarkAdStandalone::ProcessLive(int Number, int *PFrame)
+{
+    // read from the live stream till the recording stops
+    // returns LIVE_DONE, LIVE_LOST or 0 on abort
+    const int datalen=MARKAD_RING_PACKET*1702;
+    uchar *data=(uchar *) malloc(datalen);
+    if (!data) return LIVE_LOST;
+
+    isyslog("continuing with live stream");
+    uint64_t bytes=0;
+    int idle=0;
+    int ret=0;
+    while (!abort)
+    {
+        CheckPause();
+        int len=live->Read(data,datalen);
+        if (len<0)
+        {
+            if (len==LIVE_LOST) isyslog("markad too slow for live stream, continuing from disk");
+            ret=len;
+            break;
+        }
+        if (!len)
+        {
+            marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS);
+            usleep(100000);
+            idle+=100;
+            continue;
+        }
+        int pos=LastPacket(data,len);
+        if (pos!=-1)
+        {
+            memcpy(livepkt,data+pos,MARKAD_RING_PACKET);
+            liveBytes=bytes+pos+MARKAD_RING_PACKET;
+        }
+        bytes+=len;
+        if (!ProcessData(data,len,Number,PFrame)) break;
+        if (gotendmark)
+        {
+            ret=LIVE_DONE;
+            break;
+        }
+    }
+    waittime+=idle/1000;
+    free(data);
+    return ret;
+}
+
+void cMarkAdStandalone::SeekLivePacket()
+{
+    // live stream lost, find the last packet we got from it on disk,
+    // it is behind the data of the live stream (disk has more pids)
+    int number=liveFile;
+    off_t pos=liveOffset+(off_t) liveBytes-MARKAD_RING_PACKET;
+    if (pos<liveOffset) pos=liveOffset;
+
+    const int datalen=MARKAD_RING_PACKET*1702;
+    uchar *data=(uchar *) malloc(datalen);
+    time_t lastdata=time(NULL);
+    int f=-1;
+    while ((data) && (!abort))
+    {
+        if (f==-1)
+        {
+            char *fbuf;
+            if (asprintf(&fbuf,"%s/%05i.ts",directory,number)==-1) break;
+            f=open(fbuf,O_RDONLY);
+            free(fbuf);
+            if (f==-1) break;
+            if (lseek(f,pos,SEEK_SET)==-1) break;
+        }
+        int len=read(f,data,datalen);
+        if (len==-1)
+        {
+            if (errno==EINTR) continue;
+            break;
+        }
+        len-=len % MARKAD_RING_PACKET;
+        for (int i=0; i<len; i+=MARKAD_RING_PACKET)
+        {
+            if (!memcmp(data+i,livepkt,MARKAD_RING_PACKET))
+            {
+                resumeFile=number;
+                resumeOffset=pos+i+MARKAD_RING_PACKET;
+                dsyslog("found live stream position in %05i.ts at %lli",number,(long long) resumeOffset);
+                close(f);
+                free(data);
+                return;
+            }
+        }
+        if (len)
+        {
+            pos+=len;
+            lastdata=time(NULL);
+            if (lseek(f,pos,SEEK_SET)==-1) break;
+            continue;
+        }
+
+        // end of file, position is in the next file or not yet written
+        struct stat statbuf;
+        if (fstat(f,&statbuf)==-1) break;
+        char *nbuf;
+        if (asprintf(&nbuf,"%s/%05i.ts",directory,number+1)==-1) break;
+        bool next=(access(nbuf,F_OK)!=-1);
+        free(nbuf);
+        if ((next) && (pos>=statbuf.st_size))
+        {
+            pos-=statbuf.st_size;
+            number++;
+            close(f);
+            f=-1;
+            continue;
+        }
+        if (difftime(time(NULL),lastdata)>=WAITTIME) break;
+        follow->Wait(1000);
+    }
+    if (f!=-1) close(f);
+    if (data) free(data);
+
+    esyslog("cannot find live stream position on disk, marks can be wrong now!");
+    resumeFile=number;
+    resumeOffset=pos;
+}
+
+void cMarkAdStandalone::CheckPause()
+{
+    // pausing inside the daemon, a single process is stopped by signal
+    if (!paused) return;
+    isyslog("paused");
+    while ((paused) && (!abort)) usleep(100000);
+    if (!abort) isyslog("continued");
+}
+
+int cMarkAdStandalone::GetProgress(int *Pass)
+{
+    if (Pass) *Pass=pass;
+    if (!pass) return 0;
+
+    // called for every buffer and iframe, the index grows only while
+    // recording, so look at it at most once a second
+    time_t now=time(NULL);
+    if (now!=progresschecked)
+    {
+        progresschecked=now;
+        int frames=0;
+        struct stat statbuf;
+        if ((indexFile) && (!macontext.Config->GenIndex) && (stat(indexFile,&statbuf)!=-1))
+        {
+            frames=statbuf.st_size/8;
+        }
+        else
+        {
+            if (length) frames=(int) (macontext.Video.Info.FramesPerSecond*(tStart+length));
+        }
+        progressframes=frames;
+    }
+    int frames=progressframes;
+    if (frames<=0) return 0;
+
+    int pos=(pass==1) ? framecnt : iframe;
+    if (pos>=frames) return 100;
+    return (int) (((long long) pos*100)/frames);
+}
+
+void cMarkAdStandalone::UpdateProgress(int File)
+{
+    if (!progress) return;
+    int pass;
+    int percent=GetProgress(&pass);
+    progress->Update(pass,File,(pass==1) ? framecnt : iframe,percent,bytesread);
+}
+
 void cMarkAdStandalone::ChangeMarks(clMark **Mark1, clMark **Mark2, MarkAdPos *NewPos)
 {
     if (!NewPos) return;
@@ -815,161 +1252,244 @@ void cMarkAdStandalone::ChangeMarks(clMark **Mark1, clMark **Mark2, MarkAdPos *N
     if (save) marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS,true);
 }
 
-bool cMarkAdStandalone::ProcessFile2ndPass(clMark **Mark1, clMark **Mark2,int Number, off_t Offset,
-        int Frame, int Frames)
+void cMarkAdStandalone::LoadBlackMarks()
 {
-    if (!directory) return false;
-    if (!Number) return false;
-    if (!Frames) return false;
-    if (!decoder) return false;
-    if (!Mark1) return false;
-    if (!*Mark1) return false;
-
-    int pn; // process number 1=start mark, 2=before mark, 3=after mark
-    if (Mark1 && Mark2)
-    {
-        if (!(*Mark1) || !(*Mark2)) return false;
-        if (*Mark1==*Mark2) pn=mSTART;
-        if (*Mark1!=*Mark2) pn=mAFTER;
-    }
-    else
-    {
-        pn=mBEFORE;
-    }
-
-    if (!Reset(false))
+    // with --pass2only the separator frames come from the timeline
+    if (blackmarks.Count()) return;
+    if ((!timeline) || (!timeline->Load())) return;
+    cMarkAdBlackFrame blackframe(&macontext);
+    for (int i=0; i<timeline->Count(); i++)
     {
-        // reset all, but marks
-        esyslog("failed resetting state");
-        return false;
+        const cMarkAdTimeline::entry *entry=timeline->Get(i);
+        if (entry->Type!=cMarkAdTimeline::tVIDEO) continue;
+        int frame;
+        int ret=blackframe.Decide(entry->LastIFrame,&entry->Video,&frame);
+        if (ret>0) blackmarks.Add(MT_BLACKSTART,frame);
+        if (ret<0) blackmarks.Add(MT_BLACKSTOP,frame);
     }
-    iframe=Frame;
-    int actframe=Frame;
-    int framecounter=0;
-    int pframe=-1;
+}
 
-    MarkAdPos *pos=NULL;
+bool cMarkAdStandalone::AlignMark(clMark **Mark, bool Start)
+{
+    // a stop is moved to the first black picture of the nearest
+    // separator, a start to the first picture after it
+    if ((!Mark) || (!*Mark)) return false;
+    int type=Start ? MT_BLACKSTOP : MT_BLACKSTART;
+    int pos=(*Mark)->position;
+    clMark *before=blackmarks.GetPrev(pos+1,type);
+    clMark *after=blackmarks.GetNext(pos,type);
+    clMark *black=before;
+    if ((!black) || ((after) && ((after->position-pos)<(pos-before->position)))) black=after;
+    if (!black) return false;
+    if (abs(black->position-pos)>(int) (macontext.Video.Info.FramesPerSecond*MAXBLACKDIST)) return false;
+
+    // never beyond the neighbouring marks
+    clMark *prev=(*Mark)->Prev();
+    clMark *next=(*Mark)->Next();
+    if ((prev) && (black->position<=prev->position)) return false;
+    if ((next) && (black->position>=next->position)) return false;
+    if (black->position==pos) return true;
 
-    while (framecounter<Frames)
-    {
-        if (abort) return false;
+    char *buf=NULL;
+    if (asprintf(&buf,"separator near %i, moved to %i",pos,black->position)==-1) return false;
+    isyslog("%s",buf);
+    int newpos=black->position;
+    marks.Del(*Mark);
+    *Mark=marks.Add(MT_MOVED,newpos,buf);
+    free(buf);
+    return (*Mark!=NULL);
+}
 
-        const int datalen=319976;
-        uchar data[datalen];
+void cMarkAdStandalone::CloseDecode()
+{
+    if (decodefd!=-1) close(decodefd);
+    decodefd=-1;
+    decodelast=-1;
+    decodepos=decodelen=0;
+}
 
+const MarkAdFrame *cMarkAdStandalone::DecodeIFrameAt(int FrameNumber)
+{
+    // luma of the iframe at or before FrameNumber
+    if (!directory) return NULL;
+    if ((!decoder) || (!demux) || (!streaminfo)) return NULL;
+    if (!framecache) framecache=new cMarkAdFrameCache();
+    if (!framecache) return NULL;
+
+    const int datalen=65424; // 348 TS packets
+    if (!decodebuf) decodebuf=(uchar *) malloc(datalen);
+    if (!decodebuf) return NULL;
+
+    int ifr,number;
+    off_t offset;
+    if (!marks.ReadIndexIFrameBefore(directory,isTS,FrameNumber,&ifr,&number,&offset)) return NULL;
+    iframe=ifr;
+    const MarkAdFrame *frame=framecache->Get(ifr);
+    if (frame) return frame;
+
+    // the next iframe of the same file follows in the stream, the
+    // decoder skips the frames till it and needs no restart
+    int next;
+    bool cont=((decodefd!=-1) && (decodenumber==number) &&
+               (marks.ReadIndexIFrameAfter(directory,isTS,decodelast+1,&next)) && (next==ifr));
+    if (!cont)
+    {
+        CloseDecode();
         char *fbuf;
         if (isTS)
         {
-            if (asprintf(&fbuf,"%s/%05i.ts",directory,Number)==-1) return false;
+            if (asprintf(&fbuf,"%s/%05i.ts",directory,number)==-1) return NULL;
         }
         else
         {
-            if (asprintf(&fbuf,"%s/%03i.vdr",directory,Number)==-1) return false;
+            if (asprintf(&fbuf,"%s/%03i.vdr",directory,number)==-1) return NULL;
         }
-
-        int f=open(fbuf,O_RDONLY);
+        decodefd=open(fbuf,O_RDONLY);
         free(fbuf);
-        if (f==-1) return false;
-
-        int dataread;
-        if (pn==mSTART)
+        if (decodefd==-1) return NULL;
+        decodenumber=number;
+        if (lseek(decodefd,offset,SEEK_SET)!=offset)
         {
-            dsyslog("processing file %05i (start mark)",Number);
+            CloseDecode();
+            return NULL;
         }
-        else
+
+        // decode from the start of the gop till the first picture
+        if (!decodeclean)
         {
-            if (pn==mBEFORE)
+            if (!decoder->Clear())
             {
-                dsyslog("processing file %05i (before mark %i)",Number,(*Mark1)->position);
-            }
-            else
-            {
-                dsyslog("processing file %05i (after mark %i)",Number,(*Mark2)->position);
+                CloseDecode();
+                return NULL;
             }
+            streaminfo->Clear();
+            demux->Clear();
+            memset(&pkt,0,sizeof(pkt));
         }
+    }
+    decodeclean=false;
 
-        if (lseek(f,Offset,SEEK_SET)!=Offset)
+    int total=0;
+    while ((!frame) && (total<DECODE_MAXREAD))
+    {
+        if (abort) break;
+        if (decodepos>=decodelen)
         {
-            close(f);
-            return false;
+            int dataread=read(decodefd,decodebuf,datalen);
+            if (dataread<=0) break;
+            total+=dataread;
+            __sync_fetch_and_add(&bytesread,(uint64_t) dataread);
+            decodepos=0;
+            decodelen=dataread;
         }
 
-        while ((dataread=read(f,data,datalen))>0)
+        while ((decodepos<decodelen) && (!frame))
         {
-            if (abort) break;
-
-            if ((demux) && (video) && (decoder) && (streaminfo))
+            int tslen=decodelen-decodepos;
+            TRACE_BEGIN(demux,tslen);
+            int len=demux->Process(decodebuf+decodepos,tslen,&pkt);
+            TRACE_END(demux,tslen);
+            if (len<0)
             {
-                uchar *tspkt = data;
-                int tslen = dataread;
-
-                while (tslen>0)
+                esyslog("error demuxing file");
+                CloseDecode();
+                return NULL;
+            }
+            if ((pkt.Data) && ((pkt.Type & PACKET_MASK)==PACKET_VIDEO))
+            {
+                TRACE_EVENT(demux_packet,pkt.Length);
+                TRACE_BEGIN(findvideoinfos,framecnt);
+                streaminfo->FindVideoInfos(&macontext,pkt.Data,pkt.Length);
+                TRACE_END(findvideoinfos,framecnt);
+                TRACE_BEGIN(decodevideo,ifr);
+                bool decoded=decoder->DecodeVideo(&macontext,pkt.Data,pkt.Length);
+                TRACE_END(decodevideo,ifr);
+                if (decoded)
                 {
-                    int len=demux->Process(tspkt,tslen,&pkt);
-                    if (len<0)
-                    {
-                        esyslog("error demuxing file");
-                        abort=true;
-                        break;
-                    }
-                    else
-                    {
-                        if ((pkt.Data) && ((pkt.Type & PACKET_MASK)==PACKET_VIDEO))
-                        {
-                            bool dRes=false;
-                            if (streaminfo->FindVideoInfos(&macontext,pkt.Data,pkt.Length))
-                            {
-                                actframe++;
-                                framecnt2++;
-
-                                if (macontext.Video.Info.Pict_Type==MA_I_TYPE)
-                                {
-                                    lastiframe=iframe;
-                                    iframe=actframe-1;
-                                    dRes=true;
-                                }
-                            }
-                            if (pn>mSTART) dRes=decoder->DecodeVideo(&macontext,pkt.Data,pkt.Length);
-                            if (dRes)
-                            {
-                                if (pframe!=lastiframe)
-                                {
-                                    if (pn>mSTART) pos=video->ProcessOverlap(lastiframe,Frames,(pn==mBEFORE),
-                                                           (macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264));
-                                    framecounter++;
-                                }
-                                if ((pos) && (pn==mAFTER))
-                                {
-                                    // found overlap
-                                    ChangeMarks(Mark1,Mark2,pos);
-                                    close(f);
-                                    return true;
-                                }
-                                pframe=lastiframe;
-                            }
-                        }
-                        tspkt+=len;
-                        tslen-=len;
-                    }
+                    frame=framecache->Put(ifr,&macontext);
                 }
             }
+            decodepos+=len;
+        }
+    }
+    if (frame)
+    {
+        decodelast=ifr;
+    }
+    else
+    {
+        CloseDecode();
+    }
+    UpdateProgress(number);
+    if (!frame) dsyslog("cannot decode iframe %i",ifr);
+    return frame;
+}
 
-            if (abort)
-            {
-                close(f);
-                return false;
-            }
+bool cMarkAdStandalone::ProcessFile2ndPass(clMark **Mark1, clMark **Mark2, int Frame, int Frames)
+{
+    if (!directory) return false;
+    if (!Frames) return false;
+    if (!decoder) return false;
+    if (!video) return false;
+    if (!Mark1) return false;
+    if (!*Mark1) return false;
 
-            if (framecounter>Frames)
-            {
-                break;
-            }
+    int pn; // process number 1=start mark, 2=before mark, 3=after mark
+    if (Mark1 && Mark2)
+    {
+        if (!(*Mark1) || !(*Mark2)) return false;
+        if (*Mark1==*Mark2) pn=mSTART;
+        if (*Mark1!=*Mark2) pn=mAFTER;
+    }
+    else
+    {
+        pn=mBEFORE;
+    }
 
+    if (!Reset(false))
+    {
+        // reset all, but marks
+        esyslog("failed resetting state");
+        return false;
+    }
+
+    if (pn==mSTART)
+    {
+        dsyslog("processing frame %i (start mark)",Frame);
+        return true;
+    }
+    if (pn==mBEFORE)
+    {
+        dsyslog("processing frame %i (before mark %i)",Frame,(*Mark1)->position);
+    }
+    else
+    {
+        dsyslog("processing frame %i (after mark %i)",Frame,(*Mark2)->position);
+    }
+
+    bool H264=(macontext.Info.VPid.Type!=MARKAD_PIDTYPE_VIDEO_H262);
+    int frame=Frame;
+    TRACE_BEGIN(window,Frame);
+    for (int i=0; i<Frames; i++)
+    {
+        if (abort)
+        {
+            TRACE_END(window,Frame);
+            return false;
         }
-        close(f);
-        Number++;
-        Offset=0;
+        CheckPause();
+
+        MarkAdPos *pos=video->ProcessOverlap(DecodeIFrameAt(frame),Frames,(pn==mBEFORE),H264);
+        if ((pos) && (pn==mAFTER))
+        {
+            // found overlap
+            ChangeMarks(Mark1,Mark2,pos);
+            break;
+        }
+        if (!marks.ReadIndexIFrameAfter(directory,isTS,frame+1,&frame)) break;
     }
+    TRACE_END(window,Frame);
+    if (framecache) dsyslog("frame cache: %i hits, %i misses",framecache->Hits(),framecache->Misses());
     return true;
 }
 
@@ -993,10 +1513,12 @@ void cMarkAdStandalone::Process2ndPass()
         marks.Load(directory,macontext.Video.Info.FramesPerSecond,isTS);
     }
 
+    pass=2;
     bool infoheader=false;
     clMark *p1=NULL,*p2=NULL;
 
     if (marks.Count()<4) return; // we cannot do much without marks
+    LoadBlackMarks();
 
     p1=marks.GetFirst();
     if (!p1) return;
@@ -1011,20 +1533,40 @@ void cMarkAdStandalone::Process2ndPass()
             isyslog("2nd pass");
             infoheader=true;
         }
+        int p1pos=p1->position,p2pos=p2->position;
+        bool aligned=AlignMark(&p1,false);
+        if (!AlignMark(&p2,true)) aligned=false;
+        if ((!p1) || (!p2)) break;
+        if ((p1->position!=p1pos) || (p2->position!=p2pos))
+            marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS,true);
+        if (aligned)
+        {
+            // both marks are on separator frames, no overlap windows
+            p1=p2->Next();
+            p2=p1 ? p1->Next() : NULL;
+            continue;
+        }
+
         off_t offset;
         int number,frame,iframes;
         int frange=macontext.Video.Info.FramesPerSecond*120; // 40s + 80s
 	int frange_begin=p1->position-frange; // 120 seconds before first mark
 	if (frange_begin<0) frange_begin=0; // but not before beginning of broadcast
 
-        if (marks.ReadIndex(directory,isTS,frange_begin,frange,&number,&offset,&frame,&iframes))
+        TRACE_BEGIN(readindex,frange_begin);
+        bool found=marks.ReadIndex(directory,isTS,frange_begin,frange,&number,&offset,&frame,&iframes);
+        TRACE_END(readindex,frange_begin);
+        if (found)
         {
-            if (!ProcessFile2ndPass(&p1,NULL,number,offset,frame,iframes)) break;
+            if (!ProcessFile2ndPass(&p1,NULL,frame,iframes)) break;
 
             frange=macontext.Video.Info.FramesPerSecond*320; // 160s + 160s
-            if (marks.ReadIndex(directory,isTS,p2->position,frange,&number,&offset,&frame,&iframes))
+            TRACE_BEGIN(readindex,p2->position);
+            found=marks.ReadIndex(directory,isTS,p2->position,frange,&number,&offset,&frame,&iframes);
+            TRACE_END(readindex,p2->position);
+            if (found)
             {
-                if (!ProcessFile2ndPass(&p1,&p2,number,offset,frame,iframes)) break;
+                if (!ProcessFile2ndPass(&p1,&p2,frame,iframes)) break;
             }
         }
         else
@@ -1045,6 +1587,194 @@ void cMarkAdStandalone::Process2ndPass()
     }
 }
 
+void cMarkAdStandalone::CheckIFrame()
+{
+    // lastiframe changed
+    if ((iStart<0) && (lastiframe>-iStart)) iStart=lastiframe;
+    if ((iStop<0) && (lastiframe>-iStop))
+    {
+        iStop=lastiframe;
+        iStopinBroadCast=inBroadCast;
+    }
+    if ((iStopA<0) && (lastiframe>-iStopA))
+    {
+        iStopA=lastiframe;
+    }
+}
+
+void cMarkAdStandalone::CheckStartStop()
+{
+    // lastiframe was processed by the detectors
+    if (iStart>0)
+    {
+        if ((inBroadCast) && (lastiframe>chkSTART)) CheckStart();
+    }
+    if ((iStop>0) && (iStopA>0))
+    {
+        if (lastiframe>chkSTOP) CheckStop();
+    }
+}
+
+bool cMarkAdStandalone::ProcessData(uchar *Data, int Length, int Number, int *PFrame)
+{
+    // returns false if we are finished (logo extraction)
+    if ((demux) && (video) && (streaminfo))
+    {
+        uchar *tspkt = Data;
+        int tslen = Length;
+        while (tslen>0)
+        {
+            TRACE_BEGIN(demux,tslen);
+            int len=demux->Process(tspkt,tslen,&pkt);
+            TRACE_END(demux,tslen);
+            if (len<0)
+            {
+                esyslog("error demuxing");
+                abort=true;
+                break;
+            }
+            else
+            {
+                if (pkt.Data)
+                {
+                    TRACE_EVENT(demux_packet,pkt.Length);
+                    if ((pkt.Type & PACKET_MASK)==PACKET_VIDEO)
+                    {
+                        bool dRes=false;
+                        TRACE_BEGIN(findvideoinfos,framecnt);
+                        bool found=streaminfo->FindVideoInfos(&macontext,pkt.Data,pkt.Length);
+                        TRACE_END(findvideoinfos,framecnt);
+                        if (found)
+                        {
+                            if ((macontext.Video.Info.Height) && (!noticeHEADER))
+                            {
+                                if ((!isTS) && (!noticeVDR_VID))
+                                {
+                                    isyslog("found %s-video (0x%02X)",
+                                            VideoTypeName(macontext.Info.VPid.Type),
+                                            pkt.Stream);
+                                    noticeVDR_VID=true;
+                                }
+
+                                isyslog("%s %ix%i%c%0.f",(macontext.Video.Info.Height>576) ? "HDTV" : "SDTV",
+                                        macontext.Video.Info.Width,
+                                        macontext.Video.Info.Height,
+                                        macontext.Video.Info.Interlaced ? 'i' : 'p',
+                                        macontext.Video.Info.FramesPerSecond);
+                                noticeHEADER=true;
+                            }
+
+                            if (!framecnt)
+                            {
+                                CalculateCheckPositions(tStart*macontext.Video.Info.FramesPerSecond);
+                            }
+                            if (macontext.Config->GenIndex)
+                            {
+                                marks.WriteIndex(directory,isTS,demux->Offset(),macontext.Video.Info.Pict_Type,Number);
+                            }
+                            if ((checkpoint) && (framecnt) && (macontext.Video.Info.Pict_Type==MA_I_TYPE) &&
+                                    (time(NULL)>=lastcheckpoint+CKP_INTERVAL))
+                            {
+                                SaveCheckpoint();
+                            }
+                            framecnt++;
+                            if ((macontext.Config->logoExtraction!=-1) && (framecnt>=256))
+                            {
+                                isyslog("finished logo extraction, please check /tmp for pgm files");
+                                abort=true;
+                                return false;
+                            }
+
+                            if (macontext.Video.Info.Pict_Type==MA_I_TYPE)
+                            {
+                                lastiframe=iframe;
+                                if (parent)
+                                {
+                                    AddSegEvent(sIFRAME);
+                                }
+                                else
+                                {
+                                    CheckIFrame();
+                                    AddTimeline(cMarkAdTimeline::tIFRAME);
+                                }
+                                iframe=framecnt-1;
+                                dRes=true;
+                            }
+                        }
+                        if ((decoder) && (bDecodeVideo))
+                        {
+                            TRACE_BEGIN(decodevideo,framecnt);
+                            dRes=decoder->DecodeVideo(&macontext,pkt.Data,pkt.Length);
+                            TRACE_END(decodevideo,framecnt);
+                        }
+                        if ((dRes) && (!macontext.Config->IndexOnly))
+                        {
+                            if (*PFrame!=lastiframe)
+                            {
+                                if (dump) dump->Write(&macontext,lastiframe,iframe);
+                                MarkAdVideoFeatures features;
+                                MarkAdMarks *vmarks=video->Process(lastiframe,iframe,&features);
+                                if (vmarks)
+                                {
+                                    for (int i=0; i<vmarks->Count; i++)
+                                    {
+                                        AddMark(&vmarks->Number[i]);
+                                    }
+                                }
+                                //SaveFrame(lastiframe);  // TODO: JUST FOR DEBUGGING!
+                                if (parent)
+                                {
+                                    AddSegEvent(sPROCESSED,NULL,&features);
+                                }
+                                else
+                                {
+                                    AddTimeline(cMarkAdTimeline::tVIDEO,&features);
+                                    CheckStartStop();
+                                }
+                                *PFrame=lastiframe;
+                            }
+                        }
+                    }
+
+                    if ((pkt.Type & PACKET_MASK)==PACKET_AC3)
+                    {
+                        if (streaminfo->FindAC3AudioInfos(&macontext,pkt.Data,pkt.Length))
+                        {
+                            if ((!isTS) && (!noticeVDR_AC3))
+                            {
+                                isyslog("found AC3 (0x%02X)",pkt.Stream);
+                                noticeVDR_AC3=true;
+                            }
+                            if ((framecnt-iframe)<=3)
+                            {
+                                TRACE_BEGIN(audio,lastiframe);
+                                MarkAdMark *amark=audio->Process(lastiframe,iframe);
+                                TRACE_END(audio,lastiframe);
+                                if (amark)
+                                {
+                                    AddMark(amark);
+                                }
+                                if (parent)
+                                {
+                                    AddSegEvent(sAUDIO);
+                                }
+                                else
+                                {
+                                    AddTimeline(cMarkAdTimeline::tAUDIO);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                tspkt+=len;
+                tslen-=len;
+            }
+        }
+    }
+    return true;
+}
+
 bool cMarkAdStandalone::ProcessFile(int Number)
 {
     if (!directory) return false;
@@ -1088,140 +1818,42 @@ bool cMarkAdStandalone::ProcessFile(int Number)
     dsyslog("processing file %05i",Number);
 
     int pframe=-1;
+    bool lastread=false;
+    int lastlen=0;
+
+    if (Number==resumeFile)
+    {
+        // continue after the data we got from the live stream
+        if (lseek(f,resumeOffset,SEEK_SET)==-1)
+        {
+            esyslog("failed to seek in %05i.ts",Number);
+            close(f);
+            return false;
+        }
+        resumeFile=0;
+    }
 
     demux->NewFile();
 again:
     while ((dataread=read(f,data,datalen))>0)
     {
+        lastlen=dataread;
+        // workers read for the parent
+        __sync_fetch_and_add(parent ? &parent->bytesread : &bytesread,(uint64_t) dataread);
+        if (parent)
+        {
+            if (parent->abort) abort=true;
+            paused=parent->paused;
+        }
         if (abort) break;
-        if ((demux) && (video) && (streaminfo))
+        CheckPause();
+        if (!ProcessData(data,dataread,Number,&pframe))
         {
-            uchar *tspkt = data;
-            int tslen = dataread;
-            while (tslen>0)
-            {
-                int len=demux->Process(tspkt,tslen,&pkt);
-                if (len<0)
-                {
-                    esyslog("error demuxing");
-                    abort=true;
-                    break;
-                }
-                else
-                {
-                    if (pkt.Data)
-                    {
-                        if ((pkt.Type & PACKET_MASK)==PACKET_VIDEO)
-                        {
-                            bool dRes=false;
-                            if (streaminfo->FindVideoInfos(&macontext,pkt.Data,pkt.Length))
-                            {
-                                if ((macontext.Video.Info.Height) && (!noticeHEADER))
-                                {
-                                    if ((!isTS) && (!noticeVDR_VID))
-                                    {
-                                        isyslog("found %s-video (0x%02X)",
-                                                macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264 ? "H264": "H262",
-                                                pkt.Stream);
-                                        noticeVDR_VID=true;
-                                    }
-
-                                    isyslog("%s %ix%i%c%0.f",(macontext.Video.Info.Height>576) ? "HDTV" : "SDTV",
-                                            macontext.Video.Info.Width,
-                                            macontext.Video.Info.Height,
-                                            macontext.Video.Info.Interlaced ? 'i' : 'p',
-                                            macontext.Video.Info.FramesPerSecond);
-                                    noticeHEADER=true;
-                                }
-
-                                if (!framecnt)
-                                {
-                                    CalculateCheckPositions(tStart*macontext.Video.Info.FramesPerSecond);
-                                }
-                                if (macontext.Config->GenIndex)
-                                {
-                                    marks.WriteIndex(directory,isTS,demux->Offset(),macontext.Video.Info.Pict_Type,Number);
-                                }
-                                framecnt++;
-                                if ((macontext.Config->logoExtraction!=-1) && (framecnt>=256))
-                                {
-                                    isyslog("finished logo extraction, please check /tmp for pgm files");
-                                    abort=true;
-                                    if (f!=-1) close(f);
-                                    return true;
-                                }
-
-                                if (macontext.Video.Info.Pict_Type==MA_I_TYPE)
-                                {
-                                    lastiframe=iframe;
-                                    if ((iStart<0) && (lastiframe>-iStart)) iStart=lastiframe;
-                                    if ((iStop<0) && (lastiframe>-iStop))
-                                    {
-                                        iStop=lastiframe;
-                                        iStopinBroadCast=inBroadCast;
-                                    }
-                                    if ((iStopA<0) && (lastiframe>-iStopA))
-                                    {
-                                        iStopA=lastiframe;
-                                    }
-                                    iframe=framecnt-1;
-                                    dRes=true;
-                                }
-                            }
-                            if ((decoder) && (bDecodeVideo))
-                                dRes=decoder->DecodeVideo(&macontext,pkt.Data,pkt.Length);
-                            if (dRes)
-                            {
-                                if (pframe!=lastiframe)
-                                {
-                                    MarkAdMarks *vmarks=video->Process(lastiframe,iframe);
-                                    if (vmarks)
-                                    {
-                                        for (int i=0; i<vmarks->Count; i++)
-                                        {
-                                            AddMark(&vmarks->Number[i]);
-                                        }
-                                    }
-                                    //SaveFrame(lastiframe);  // TODO: JUST FOR DEBUGGING!
-                                    if (iStart>0)
-                                    {
-                                        if ((inBroadCast) && (lastiframe>chkSTART)) CheckStart();
-                                    }
-                                    if ((iStop>0) && (iStopA>0))
-                                    {
-                                        if (lastiframe>chkSTOP) CheckStop();
-                                    }
-                                    pframe=lastiframe;
-                                }
-                            }
-                        }
-
-                        if ((pkt.Type & PACKET_MASK)==PACKET_AC3)
-                        {
-                            if (streaminfo->FindAC3AudioInfos(&macontext,pkt.Data,pkt.Length))
-                            {
-                                if ((!isTS) && (!noticeVDR_AC3))
-                                {
-                                    isyslog("found AC3 (0x%02X)",pkt.Stream);
-                                    noticeVDR_AC3=true;
-                                }
-                                if ((framecnt-iframe)<=3)
-                                {
-                                    MarkAdMark *amark=audio->Process(lastiframe,iframe);
-                                    if (amark)
-                                    {
-                                        AddMark(amark);
-                                    }
-                                }
-                            }
-                        }
-                    }
-
-                    tspkt+=len;
-                    tslen-=len;
-                }
-            }
+            if (f!=-1) close(f);
+            return true;
         }
+        if (parent) AddSegEvent(sBUFFER);
+        UpdateProgress(Number);
         if ((gotendmark) && (!macontext.Config->GenIndex))
         {
             if (f!=-1) close(f);
@@ -1235,7 +1867,20 @@ again:
             return false;
         }
     }
-    if ((dataread==-1) && (errno==EINTR)) goto again; // i know this is ugly ;)
+    if ((dataread==-1) && (errno==EINTR)) goto again; // i know this is ugly ;)
+    if ((!dataread) && (live) && (lastlen))
+    {
+        // remember where we are, to continue with the live stream
+        int pos=LastPacket(data,lastlen);
+        if (pos!=-1)
+        {
+            memcpy(livepkt,data+pos,MARKAD_RING_PACKET);
+            livepktValid=true;
+            liveFile=Number;
+            liveOffset=lseek(f,0,SEEK_CUR)-lastlen+pos+MARKAD_RING_PACKET;
+        }
+    }
+    if ((!dataread) && (!abort) && (!lastread) && (WaitForData(f,Number,&pframe,&lastread))) goto again;
 
     close(f);
     return true;
@@ -1258,6 +1903,8 @@ bool cMarkAdStandalone::Reset(bool FirstPass)
     {
         marks.DelAll();
         marks.CloseIndex(directory,isTS);
+        blackmarks.DelAll();
+        columns.Clear();
     }
 
     macontext.Video.Info.Pict_Type=0;
@@ -1273,42 +1920,411 @@ bool cMarkAdStandalone::Reset(bool FirstPass)
     if (demux) demux->Clear();
     if (video) video->Clear();
     if (audio) audio->Clear();
+    // the pipeline lost the state of the 2nd pass stream
+    CloseDecode();
+    decodeclean=((ret) && (!FirstPass));
+    return ret;
+}
+
+void cMarkAdStandalone::AddTimeline(int Type, MarkAdVideoFeatures *Features)
+{
+    if ((Type==cMarkAdTimeline::tVIDEO) && (Features))
+        columns.Append(lastiframe,&Features->AspectRatio,macontext.Audio.Info.Channels);
+    if (Type==cMarkAdTimeline::tAUDIO) columns.SetChannels(macontext.Audio.Info.Channels);
+    if (!timeline) return;
+    cMarkAdTimeline::entry entry;
+    memset(&entry,0,sizeof(entry));
+    entry.Type=Type;
+    entry.Framecnt=framecnt;
+    entry.LastIFrame=lastiframe;
+    entry.IFrame=iframe;
+    entry.Channels=macontext.Audio.Info.Channels;
+    if (Features) entry.Video=*Features;
+    timeline->Add(&entry);
+}
+
+void cMarkAdStandalone::AddSegEvent(int Type, MarkAdMark *Mark, MarkAdVideoFeatures *Features)
+{
+    if (segeventcnt>=segeventmax)
+    {
+        int max=segeventmax ? segeventmax*2 : 1024;
+        struct segevent *tmp=(struct segevent *) realloc(segevents,max*sizeof(struct segevent));
+        if (!tmp)
+        {
+            esyslog("out of memory");
+            abort=true;
+            return;
+        }
+        segevents=tmp;
+        segeventmax=max;
+    }
+    struct segevent *ev=&segevents[segeventcnt++];
+    memset(ev,0,sizeof(*ev));
+    ev->Type=Type;
+    ev->Framecnt=framecnt;
+    ev->LastIFrame=lastiframe;
+    ev->IFrame=iframe;
+    ev->Channels=macontext.Audio.Info.Channels;
+    if (Mark) ev->Mark=*Mark;
+    if (Features) ev->Features=*Features;
+}
+
+void cMarkAdStandalone::Replay(cMarkAdStandalone *Seg)
+{
+    // do what ProcessFile would have done with the data of Seg
+    for (int i=0; i<Seg->segeventcnt; i++)
+    {
+        struct segevent *ev=&Seg->segevents[i];
+        framecnt=ev->Framecnt;
+        lastiframe=ev->LastIFrame;
+        iframe=ev->IFrame;
+        macontext.Audio.Info.Channels=ev->Channels;
+        switch (ev->Type)
+        {
+        case sIFRAME:
+            CheckIFrame();
+            AddTimeline(cMarkAdTimeline::tIFRAME);
+            break;
+        case sPROCESSED:
+            AddTimeline(cMarkAdTimeline::tVIDEO,&ev->Features);
+            CheckStartStop();
+            break;
+        case sMARK:
+            AddMark(&ev->Mark);
+            break;
+        case sAUDIO:
+            AddTimeline(cMarkAdTimeline::tAUDIO);
+            break;
+        case sBUFFER:
+            UpdateProgress(Seg->segfile);
+            if ((gotendmark) && (!macontext.Config->GenIndex)) i=Seg->segeventcnt;
+            break;
+        }
+    }
+    Seg->segeventcnt=0;
+}
+
+void cMarkAdStandalone::SaveSegmentState()
+{
+    if (!segstate->Create()) return;
+    segstate->Put(&framecnt,sizeof(framecnt));
+    segstate->Put(&lastiframe,sizeof(lastiframe));
+    segstate->Put(&iframe,sizeof(iframe));
+    segstate->Put(&macontext.Video.Info.Width,sizeof(macontext.Video.Info.Width));
+    segstate->Put(&macontext.Video.Info.Height,sizeof(macontext.Video.Info.Height));
+    segstate->Put(&macontext.Video.Info.AspectRatio,sizeof(macontext.Video.Info.AspectRatio));
+    segstate->Put(&macontext.Audio.Info.Channels,sizeof(macontext.Audio.Info.Channels));
+    video->SaveState(segstate);
+    audio->SaveState(segstate);
+    segstate->Commit();
+}
+
+bool cMarkAdStandalone::CheckSegmentState(cMarkAdStandalone *Seg)
+{
+    // is our state equal to the state of Seg at the start of its file?
+    cMarkAdCheckpoint *ckp=Seg->segstate;
+    if (!ckp->Open()) return false;
+
+    int fcnt=0,liframe=0,ifr=0,width=0,height=0,channels=0;
+    MarkAdAspectRatio aspectratio;
+    memset(&aspectratio,0,sizeof(aspectratio));
+    ckp->Get(&fcnt,sizeof(fcnt));
+    ckp->Get(&liframe,sizeof(liframe));
+    ckp->Get(&ifr,sizeof(ifr));
+    ckp->Get(&width,sizeof(width));
+    ckp->Get(&height,sizeof(height));
+    ckp->Get(&aspectratio,sizeof(aspectratio));
+    ckp->Get(&channels,sizeof(channels));
+
+    bool ret=((!ckp->Error()) && (fcnt==framecnt) && (liframe==lastiframe) && (ifr==iframe) &&
+              (width==macontext.Video.Info.Width) && (height==macontext.Video.Info.Height) &&
+              (aspectratio.Num==macontext.Video.Info.AspectRatio.Num) &&
+              (aspectratio.Den==macontext.Video.Info.AspectRatio.Den) &&
+              (channels==macontext.Audio.Info.Channels));
+    if (ret)
+    {
+        cMarkAdVideo *svideo=new cMarkAdVideo(&macontext);
+        cMarkAdAudio *saudio=new cMarkAdAudio(&macontext);
+        ret=((svideo->LoadState(ckp)) && (saudio->LoadState(ckp)) &&
+             (video->Equal(svideo)) && (audio->Equal(saudio)));
+        delete svideo;
+        delete saudio;
+    }
+    ckp->Close();
     return ret;
 }
 
+void *cMarkAdStandalone::segworker(void *Seg)
+{
+    cMarkAdStandalone *seg=(cMarkAdStandalone *) Seg;
+    // log like the job of the parent
+    SysLogLevelJob=seg->macontext.Config->Verbose;
+    LOGFILE=seg->parent->logfile;
+    seg->ProcessSegment();
+    return NULL;
+}
+
+void cMarkAdStandalone::ProcessSegment()
+{
+    for (int i=resumeFile; i<=segfile; i++)
+    {
+        if (i==segfile)
+        {
+            // warmup done, from here on it counts
+            SaveSegmentState();
+            segeventcnt=0;
+        }
+        if (!ProcessFile(i)) return;
+        if (abort) return;
+    }
+    segok=true;
+}
+
+void cMarkAdStandalone::StartSegments(int File)
+{
+    // File is finished, the next one is ours, start workers after it
+    if (segnext<File+2) segnext=File+2;
+    int running=0;
+    for (int i=File+1; i<=segfiles; i++)
+    {
+        if (segs[i]) running++;
+    }
+    double fps=macontext.Video.Info.FramesPerSecond;
+    while ((running<macontext.Config->parallel) && (segnext<=segfiles) && (!abort))
+    {
+        int file=segnext++;
+        int start=marks.ReadIndexFileStart(directory,isTS,file);
+        if (start<=0) continue;
+        int frame,number;
+        off_t offset;
+        if (!marks.ReadIndexIFrameBefore(directory,isTS,start-(int) (fps*SEGWARMUP),
+                                         &frame,&number,&offset)) continue;
+        if (number>=file) continue;
+
+        cMarkAdStandalone *seg=new cMarkAdStandalone(this,file,frame,number,offset);
+        if (pthread_create(&seg->segthread,NULL,segworker,(void *) seg)!=0)
+        {
+            esyslog("cannot start worker for file %05i",file);
+            delete seg;
+            continue;
+        }
+        dsyslog("started worker for file %05i at frame %i",file,frame);
+        segs[file]=seg;
+        running++;
+    }
+}
+
+bool cMarkAdStandalone::MergeSegment(cMarkAdStandalone **Cur, int File)
+{
+    cMarkAdStandalone *seg=segs[File];
+    segs[File]=NULL;
+    pthread_join(seg->segthread,NULL);
+
+    if ((abort) || (!seg->segok) || (!(*Cur)->CheckSegmentState(seg)))
+    {
+        if (!abort) isyslog("detector state differs at file %05i, processing it again",File);
+        delete seg;
+        return false;
+    }
+    Replay(seg);
+    dsyslog("merged file %05i",File);
+
+    if (*Cur!=this)
+    {
+        if ((*Cur)->demux) segskipped+=(*Cur)->demux->Skipped();
+        delete *Cur;
+    }
+    *Cur=seg;
+    return true;
+}
+
+void cMarkAdStandalone::StopSegments()
+{
+    if (!segs) return;
+    for (int i=1; i<=segfiles; i++)
+    {
+        if (!segs[i]) continue;
+        segs[i]->abort=true;
+        pthread_join(segs[i]->segthread,NULL);
+        delete segs[i];
+        segs[i]=NULL;
+    }
+}
+
 void cMarkAdStandalone::ProcessFile()
 {
-    for (int i=1; i<=MaxFiles; i++)
+    cMarkAdStandalone *cur=this; // has the state of the stream
+    for (int i=resumeFile ? resumeFile : 1; i<=MaxFiles; i++)
     {
         if (abort) break;
-        if (!ProcessFile(i)) break;
+        if ((!segs) || (i>segfiles) || (!segs[i]) || (!MergeSegment(&cur,i)))
+        {
+            if (!cur->ProcessFile(i)) break;
+            if (cur!=this) Replay(cur);
+        }
         if ((gotendmark) && (!macontext.Config->GenIndex)) break;
+        if (liveDone) break; // everything read from live stream
+        if (resumeFile) i=resumeFile-1;
+        // detector options are fixed after checking the start
+        if ((segs) && (!iStart) && (framecnt)) StartSegments(i);
+    }
+    StopSegments();
+    if (cur!=this)
+    {
+        if (cur->demux) segskipped+=cur->demux->Skipped();
+        delete cur;
     }
 
-    if (!abort)
+    if ((!abort) && (!macontext.Config->IndexOnly)) CheckEnd();
+    if (demux) skipped=demux->Skipped()+segskipped;
+}
+
+void cMarkAdStandalone::CheckEnd()
+{
+    // all frames processed
+    CheckLogoMarks();
+    if ((iStop>0) && (iStopA>0)) CheckStop(); // no stopmark till now?
+    if ((inBroadCast) && (!gotendmark) && (lastiframe))
+    {
+        MarkAdMark tempmark;
+        tempmark.Type=MT_RECORDINGSTOP;
+        tempmark.Position=lastiframe;
+        AddMark(&tempmark);
+    }
+}
+
+void cMarkAdStandalone::Process3rdPass()
+{
+    // make all decisions again with the timeline of the first pass
+    if (abort) return;
+    if ((!timeline) || (!video) || (!audio)) return;
+    if (!timeline->Load())
+    {
+        esyslog("no timeline found, please run the first pass");
+        return;
+    }
+    pass=3;
+    isyslog("3rd pass");
+
+    Reset();
+    macontext.Video.Info.FramesPerSecond=timeline->FramesPerSecond();
+    if (!macontext.Video.Info.FramesPerSecond)
+    {
+        isyslog("WARNING: assuming fps of 25");
+        macontext.Video.Info.FramesPerSecond=25;
+    }
+    if (macontext.Config->BackupMarks) marks.Backup(directory,isTS);
+    CalculateCheckPositions(tStart*macontext.Video.Info.FramesPerSecond);
+
+    for (int i=0; i<timeline->Count(); i++)
+    {
+        if (abort) return;
+        const cMarkAdTimeline::entry *entry=timeline->Get(i);
+        framecnt=entry->Framecnt;
+        lastiframe=entry->LastIFrame;
+        iframe=entry->IFrame;
+        macontext.Audio.Info.Channels=entry->Channels;
+        switch (entry->Type)
+        {
+        case cMarkAdTimeline::tIFRAME:
+            CheckIFrame();
+            UpdateProgress(0);
+            break;
+        case cMarkAdTimeline::tVIDEO:
+        {
+            MarkAdVideoFeatures features=entry->Video;
+            // pictures after switching off video decoding weren't decoded
+            if (!bDecodeVideo) features.Valid=false;
+            macontext.Video.Info.AspectRatio=features.AspectRatio;
+            columns.Append(lastiframe,&features.AspectRatio,macontext.Audio.Info.Channels);
+            MarkAdMarks *vmarks=video->Decide(lastiframe,iframe,&features);
+            if (vmarks)
+            {
+                for (int j=0; j<vmarks->Count; j++)
+                {
+                    AddMark(&vmarks->Number[j]);
+                }
+            }
+            CheckStartStop();
+            break;
+        }
+        case cMarkAdTimeline::tAUDIO:
+        {
+            MarkAdMark *amark=audio->Process(lastiframe,iframe);
+            if (amark) AddMark(amark);
+            columns.SetChannels(macontext.Audio.Info.Channels);
+            break;
+        }
+        }
+        if (gotendmark) break;
+    }
+    CheckEnd();
+
+    // the separator alignment of the 2nd pass works without decoding,
+    // the overlap check needs the pictures and is left out
+    if ((!abort) && (marks.Count()>=4))
     {
-        CheckLogoMarks();
-        if ((iStop>0) && (iStopA>0)) CheckStop(); // no stopmark till now?
-        if ((inBroadCast) && (!gotendmark) && (lastiframe))
+        LoadBlackMarks();
+        clMark *p1=marks.GetFirst();
+        if (p1) p1=p1->Next();
+        clMark *p2=p1 ? p1->Next() : NULL;
+        while ((p1) && (p2))
         {
-            MarkAdMark tempmark;
-            tempmark.Type=MT_RECORDINGSTOP;
-            tempmark.Position=lastiframe;
-            AddMark(&tempmark);
+            AlignMark(&p1,false);
+            AlignMark(&p2,true);
+            if ((!p1) || (!p2)) break;
+            p1=p2->Next();
+            p2=p1 ? p1->Next() : NULL;
         }
     }
-    if (demux) skipped=demux->Skipped();
+    if (!marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS))
+    {
+        esyslog("failed to save marks");
+    }
 }
 
 void cMarkAdStandalone::Process()
 {
     if (abort) return;
 
-    if (macontext.Config->BackupMarks) marks.Backup(directory,isTS);
+    pass=1;
+    if (macontext.Config->IndexOnly)
+    {
+        // just the index, no decoding and no marks
+        ProcessFile();
+        bool ok=marks.CloseIndex(directory,isTS);
+        if (!abort)
+        {
+            if ((ok) && (framecnt) && (RegenerateIndex()))
+            {
+                isyslog("recreated index with %i frames",framecnt);
+            }
+            else
+            {
+                esyslog("failed to recreate index");
+            }
+        }
+        marks.RemoveGeneratedIndex(directory,isTS);
+        return;
+    }
+
+    bool resumed=LoadCheckpoint();
+    if ((macontext.Config->BackupMarks) && (!resumed)) marks.Backup(directory,isTS);
+    if ((timeline) && (!resumed) && (!timeline->Create()))
+    {
+        delete timeline;
+        timeline=NULL;
+    }
 
     ProcessFile();
 
-    marks.CloseIndex(directory,isTS);
+    if ((timeline) && (!abort) && (!timeline->Commit(macontext.Video.Info.FramesPerSecond)))
+    {
+        esyslog("failed to write timeline");
+    }
+
+    if (!marks.CloseIndex(directory,isTS)) esyslog("failed to write index");
+    if ((checkpoint) && (!abort)) checkpoint->Remove();
     if (!abort)
     {
         if (marks.Save(directory,macontext.Video.Info.FramesPerSecond,isTS))
@@ -2084,6 +3100,12 @@ bool cMarkAdStandalone::CheckPATPMT(off_t Offset)
             // just use the first pid
             if (!macontext.Info.VPid.Num) macontext.Info.VPid.Num=pid;
             break;
+
+        case 0x24:
+            macontext.Info.VPid.Type=MARKAD_PIDTYPE_VIDEO_H265;
+            // just use the first pid
+            if (!macontext.Info.VPid.Num) macontext.Info.VPid.Num=pid;
+            break;
         }
 
         i+=(sizeof(struct STREAMINFO)+esinfo_len);
@@ -2116,6 +3138,14 @@ bool cMarkAdStandalone::RegenerateIndex()
     }
     free(oldpath);
     free(newpath);
+
+    // make the rename itself persistent
+    int dfd=open(directory,O_RDONLY|O_DIRECTORY);
+    if (dfd!=-1)
+    {
+        fsync(dfd);
+        close(dfd);
+    }
     return true;
 }
 
@@ -2185,14 +3215,42 @@ const char cMarkAdStandalone::frametypes[8]={'?','I','P','B','D','S','s','b'};
 cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *config)
 {
     setlocale(LC_MESSAGES, "");
+    SysLogLevelJob=config->Verbose;
     directory=Directory;
     abort=false;
+    paused=false;
+    pass=0;
     gotendmark=false;
     inBroadCast=false;
     iStopinBroadCast=false;
     isREEL=false;
 
     indexFile=NULL;
+    follow=NULL;
+    live=NULL;
+    livepktValid=false;
+    liveDone=false;
+    liveFile=0;
+    liveOffset=0;
+    liveBytes=0;
+    resumeFile=0;
+    resumeOffset=0;
+    checkpoint=NULL;
+    framecache=NULL;
+    decodefd=-1;
+    decodenumber=0;
+    decodelast=-1;
+    decodeclean=false;
+    decodebuf=NULL;
+    decodepos=decodelen=0;
+    dump=NULL;
+    timeline=NULL;
+    progress=NULL;
+    logfile=NULL;
+    bytesread=0;
+    progressframes=0;
+    progresschecked=0;
+    lastcheckpoint=0;
     streaminfo=NULL;
     demux=NULL;
     decoder=NULL;
@@ -2200,6 +3258,17 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
     audio=NULL;
     osd=NULL;
 
+    parent=NULL;
+    segs=NULL;
+    segfiles=0;
+    segnext=0;
+    segskipped=0;
+    segfile=0;
+    segok=false;
+    segstate=NULL;
+    segevents=NULL;
+    segeventcnt=segeventmax=0;
+
     memset(&pkt,0,sizeof(pkt));
 
     noticeVDR_VID=false;
@@ -2251,6 +3320,18 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
             free(fbuf);
         }
     }
+    else if (config->Log2Rec)
+    {
+        // daemon job, stdout is shared by all jobs
+        char *fbuf;
+        if (asprintf(&fbuf,"%s/markad.log",directory)!=-1)
+        {
+            logfile=fopen(fbuf,"w+");
+            if (logfile) SetFileUID(fbuf);
+            free(fbuf);
+        }
+        LOGFILE=logfile;
+    }
 
     long lb;
     errno=0;
@@ -2308,6 +3389,7 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
             pos=SeekPATPMT();
             if (pos==(off_t) -2) {
                 sleep(10);
+                if (abort) return;
                 sc++;
                 if (sc>6) break;
             }
@@ -2339,6 +3421,36 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
     }
     macontext.Info.APid.Num=0; // till now we do just nothing with stereo-sound
 
+    if ((config->Before) && (config->logoExtraction==-1))
+    {
+        // follow the recording instead of polling the index
+        follow=new cMarkAdFollow(directory);
+        if (!follow->Available())
+        {
+            delete follow;
+            follow=NULL;
+        }
+    }
+    if ((!config->GenIndex) && (config->logoExtraction==-1) && (!config->Pass3Only))
+    {
+        // needs the index of vdr to continue
+        checkpoint=new cMarkAdCheckpoint(directory);
+    }
+    if ((!config->IndexOnly) && (config->logoExtraction==-1))
+    {
+        timeline=new cMarkAdTimeline(directory);
+    }
+    if ((follow) && (isTS) && (!config->GenIndex))
+    {
+        // read packets directly from vdr (plugin), if available
+        live=new cMarkAdLiveStream(directory);
+        if (!live->Available())
+        {
+            delete live;
+            live=NULL;
+        }
+    }
+
     if (!LoadInfo())
     {
         if (bDecodeVideo)
@@ -2393,17 +3505,26 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
     }
 
     if (config->markFileName[0]) marks.SetFileName(config->markFileName);
+    if (config->dumpFrames[0])
+    {
+        dump=new cMarkAdY4M();
+        if ((dump) && (!dump->Create(config->dumpFrames)))
+        {
+            delete dump;
+            dump=NULL;
+        }
+    }
 
     if (macontext.Info.VPid.Num)
     {
         if (isTS)
         {
             isyslog("found %s-video (0x%04x)",
-                    macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264 ? "H264": "H262",
+                    VideoTypeName(macontext.Info.VPid.Type),
                     macontext.Info.VPid.Num);
         }
         demux=new cDemux(macontext.Info.VPid.Num,macontext.Info.DPid.Num,macontext.Info.APid.Num,
-                         macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264,true);
+                         macontext.Info.VPid.Type,true);
     }
     else
     {
@@ -2422,18 +3543,40 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
             isyslog("found AC3 (0x%04x)",macontext.Info.DPid.Num);
     }
 
+    if ((demux) && (config->IndexOnly)) demux->DisableDPid();
+    marks.SetIndexSync(config->IndexSync);
+
     if (!abort)
     {
-        decoder = new cMarkAdDecoder(macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264,config->threads);
+        progress=new cMarkAdProgress(directory);
+        if (!progress->Open())
+        {
+            delete progress;
+            progress=NULL;
+        }
+        if ((!config->IndexOnly) && (!config->Pass3Only))
+            decoder = new cMarkAdDecoder(macontext.Info.VPid.Type,config->threads);
         video = new cMarkAdVideo(&macontext);
         audio = new cMarkAdAudio(&macontext);
         streaminfo = new cMarkAdStreamInfo;
         if (macontext.Info.ChannelName)
             isyslog("channel %s",macontext.Info.ChannelName);
-        if (macontext.Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264)
+        if (macontext.Info.VPid.Type!=MARKAD_PIDTYPE_VIDEO_H262)
             macontext.Video.Options.IgnoreAspectRatio=true;
     }
 
+    if ((!abort) && (config->parallel) && (!config->Before) && (!config->GenIndex) &&
+            (config->logoExtraction==-1) && (!follow) && (!live))
+    {
+        // only for finished recordings, the index must be complete
+        segfiles=marks.ReadIndexLastFile(directory,isTS);
+        if (segfiles>1)
+        {
+            segs=(cMarkAdStandalone **) calloc(segfiles+1,sizeof(cMarkAdStandalone *));
+            if (segs) isyslog("using up to %i workers for %i files",config->parallel,segfiles);
+        }
+    }
+
     framecnt=0;
     framecnt2=0;
     lastiframe=0;
@@ -2442,6 +3585,103 @@ cMarkAdStandalone::cMarkAdStandalone(const char *Directory, const MarkAdConfig *
     gettimeofday(&tv1,&tz);
 }
 
+cMarkAdStandalone::cMarkAdStandalone(cMarkAdStandalone *Parent, int File, int Frame,
+                                     int Number, off_t Offset)
+{
+    // worker for File, starts with the iframe Frame in file Number
+    parent=Parent;
+    directory=Parent->directory;
+    isTS=Parent->isTS;
+    isREEL=Parent->isREEL;
+    MaxFiles=File;
+    abort=false;
+    paused=false;
+    pass=1;
+    gotendmark=false;
+    inBroadCast=false;
+    iStopinBroadCast=false;
+    duplicate=true; // no pidfile, no messages
+    title[0]=0;
+    ptitle=NULL;
+
+    indexFile=NULL;
+    follow=NULL;
+    live=NULL;
+    livepktValid=false;
+    liveDone=false;
+    liveFile=0;
+    liveOffset=0;
+    liveBytes=0;
+    resumeFile=Number;
+    resumeOffset=Offset;
+    checkpoint=NULL;
+    framecache=NULL;
+    decodefd=-1;
+    decodenumber=0;
+    decodelast=-1;
+    decodeclean=false;
+    decodebuf=NULL;
+    decodepos=decodelen=0;
+    dump=NULL;
+    timeline=NULL;
+    progress=NULL;
+    logfile=NULL;
+    bytesread=0;
+    progressframes=0;
+    progresschecked=0;
+    lastcheckpoint=0;
+    osd=NULL;
+
+    segs=NULL;
+    segfiles=0;
+    segnext=0;
+    segskipped=0;
+    segfile=File;
+    segok=false;
+    segstate=new cMarkAdCheckpoint();
+    segevents=NULL;
+    segeventcnt=segeventmax=0;
+
+    memset(&pkt,0,sizeof(pkt));
+    noticeVDR_VID=noticeVDR_AC3=noticeHEADER=noticeFILLER=true;
+
+    skipped=0;
+    sleepcnt=0;
+    waittime=iwaittime=0;
+
+    // same options the parent has now
+    macontext=Parent->macontext;
+    memset(&macontext.Video.Info,0,sizeof(macontext.Video.Info));
+    memset(&macontext.Video.Data,0,sizeof(macontext.Video.Data));
+    memset(&macontext.Audio.Info,0,sizeof(macontext.Audio.Info));
+    memset(&macontext.Audio.Data,0,sizeof(macontext.Audio.Data));
+    if (Parent->macontext.Info.ChannelName)
+        macontext.Info.ChannelName=strdup(Parent->macontext.Info.ChannelName);
+    bDecodeVideo=Parent->bDecodeVideo;
+    bDecodeAudio=Parent->bDecodeAudio;
+    bIgnoreTimerInfo=Parent->bIgnoreTimerInfo;
+    bLiveRecording=Parent->bLiveRecording;
+    startTime=0;
+    length=0;
+
+    // no start/stop checks, the parent does them
+    tStart=iStart=iStop=iStopA=0;
+    chkSTART=chkSTOP=INT_MAX;
+
+    demux=new cDemux(macontext.Info.VPid.Num,macontext.Info.DPid.Num,macontext.Info.APid.Num,
+                     macontext.Info.VPid.Type,true);
+    decoder=new cMarkAdDecoder(macontext.Info.VPid.Type,macontext.Config->threads);
+    video=new cMarkAdVideo(&macontext);
+    audio=new cMarkAdAudio(&macontext);
+    streaminfo=new cMarkAdStreamInfo;
+
+    framecnt=Frame;
+    framecnt2=0;
+    lastiframe=iframe=Frame;
+    memset(&tv1,0,sizeof(tv1));
+    memset(&tv2,0,sizeof(tv2));
+}
+
 cMarkAdStandalone::~cMarkAdStandalone()
 {
     if ((!abort) && (!duplicate))
@@ -2482,8 +3722,22 @@ cMarkAdStandalone::~cMarkAdStandalone()
         }
     }
 
+    StopSegments();
+    if (segs) free(segs);
+    if (segstate) delete segstate;
+    if (segevents) free(segevents);
+
     if (macontext.Info.ChannelName) free(macontext.Info.ChannelName);
     if (indexFile) free(indexFile);
+    if (follow) delete follow;
+    if (live) delete live;
+    if (checkpoint) delete checkpoint;
+    if (framecache) delete framecache;
+    CloseDecode();
+    if (decodebuf) free(decodebuf);
+    if (dump) delete dump;
+    if (timeline) delete timeline;
+    if (progress) delete progress;
 
     if (demux) delete demux;
     if (decoder) delete decoder;
@@ -2493,6 +3747,11 @@ cMarkAdStandalone::~cMarkAdStandalone()
     if (osd) delete osd;
 
     RemovePidfile();
+    if (logfile)
+    {
+        LOGFILE=NULL;
+        fclose(logfile);
+    }
 }
 
 bool isnumber(const char *s)
@@ -2536,6 +3795,15 @@ int usage(int svdrpport)
            "                  make a backup of existing marks\n"
            "-G              --genindex\n"
            "                  regenerate index file\n"
+           "                --indexonly\n"
+           "                  just regenerate the index file from the stream headers\n"
+           "                  (no decoding, no marks), implies --genindex\n"
+           "                --fsync\n"
+           "                  sync the generated index to disk after each block\n"
+           "                --parallel=<workers>\n"
+           "                  <workers> 0-32, default 0\n"
+           "                  process the files of a finished recording with up\n"
+           "                  to <workers> additional threads\n"
            "-I              --saveinfo\n"
            "                  correct information in info file\n"
            "-L              --extractlogo=<direction>[,width[,height]]\n"
@@ -2573,12 +3841,31 @@ int usage(int svdrpport)
            "                  process only first pass, setting of marks\n"
            "                --pass2only\n"
            "                  process only second pass, fine adjustment of marks\n"
+           "                --pass3only\n"
+           "                  set the marks again from the timeline of the first\n"
+           "                  pass (markad.timeline), without decoding\n"
            "                --svdrphost=<ip/hostname> (default is 127.0.0.1)\n"
            "                  ip/hostname of a remote VDR for OSD messages\n"
            "                --svdrpport=<port> (default is %i)\n"
            "                  port of a remote VDR for OSD messages\n"
            "                --astopoffs=<value> (default is 100)\n"
            "                  assumed stop offset in seconds range from 0 to 240\n"
+           "                --daemon[=<socket>] (default is %s)\n"
+           "                  run as daemon, recordings are queued over the socket\n"
+           "                --jobs=<number> (default is 1)\n"
+           "                  number of jobs the daemon runs at the same time\n"
+           "                --profile\n"
+           "                  print cpu time, IPC, cache and branch misses of the\n"
+           "                  processing stages at exit (perf_event_open)\n"
+           "                --trace=<file>\n"
+           "                  write a trace of the processing stages to <file>\n"
+           "                  (json, for chrome://tracing or Perfetto), not with\n"
+           "                  --daemon\n"
+           "                --dump-frames=<file>\n"
+           "                  write the frames the detectors see to <file> (y4m)\n"
+           "                --replay=<file>\n"
+           "                  run the detectors on the frames of a y4m file\n"
+           "                  instead of a recording and log marks and times\n"
            "\ncmd: one of\n"
            "-                            dummy-parameter if called directly\n"
            "after                        markad starts to analyze the recording\n"
@@ -2588,7 +3875,7 @@ int usage(int svdrpport)
            "\n<record>                     is the name of the directory where the recording\n"
            "                             is stored\n\n",
            LOGO_MAXWIDTH,LOGO_DEFWIDTH,LOGO_DEFHDWIDTH,
-           LOGO_MAXHEIGHT,LOGO_DEFHEIGHT,LOGO_DEFHDHEIGHT,svdrpport
+           LOGO_MAXHEIGHT,LOGO_DEFHEIGHT,LOGO_DEFHDHEIGHT,svdrpport,DEF_SOCKET
           );
     return -1;
 }
@@ -2611,6 +3898,7 @@ static void signal_handler(int sig)
     case SIGABRT:
         esyslog("aborted by signal");
         if (cmasta) cmasta->SetAbort();
+        if (cmdaemon) cmdaemon->SetAbort();
         break;
     case SIGSEGV:
         esyslog("segmentation fault");
@@ -2628,6 +3916,7 @@ static void signal_handler(int sig)
     case SIGINT:
         esyslog("aborted by user");
         if (cmasta) cmasta->SetAbort();
+        if (cmdaemon) cmdaemon->SetAbort();
         break;
     default:
         break;
@@ -2654,6 +3943,11 @@ int main(int argc, char *argv[])
     int online=0;
     bool bPass2Only=false;
     bool bPass1Only=false;
+    const char *daemonSocket=NULL;
+    int maxJobs=1;
+    const char *traceFile=NULL;
+    bool bProfile=false;
+    const char *replayFile=NULL;
 
     struct config config;
     memset(&config,0,sizeof(config));
@@ -2704,6 +3998,15 @@ int main(int argc, char *argv[])
 
             {"asd",0,0,6},
             {"astopoffs",1,0,12},
+            {"daemon",2,0,13},
+            {"jobs",1,0,14},
+            {"indexonly",0,0,15},
+            {"fsync",0,0,16},
+            {"parallel",1,0,17},
+            {"trace",1,0,18},
+            {"profile",0,0,19},
+            {"dump-frames",1,0,20},
+            {"replay",1,0,21},
             {"loglevel",1,0,2},
             {"markfile",1,0,1},
             {"nopid",0,0,5},
@@ -2978,6 +4281,12 @@ int main(int argc, char *argv[])
             break;
 
         case 7: // --pass3only
+            config.Pass3Only=true;
+            if ((bPass1Only) || (bPass2Only))
+            {
+                fprintf(stderr, "markad: you cannot use --pass3only with --pass1only or --pass2only\n");
+                return 2;
+            }
             break;
 
         case 8: // --svdrphost
@@ -2999,18 +4308,18 @@ int main(int argc, char *argv[])
 
         case 10: // --pass2only
             bPass2Only=true;
-            if (bPass1Only)
+            if ((bPass1Only) || (config.Pass3Only))
             {
-                fprintf(stderr, "markad: you cannot use --pass2only with --pass1only\n");
+                fprintf(stderr, "markad: you cannot use --pass2only with --pass1only or --pass3only\n");
                 return 2;
             }
             break;
 
         case 11: // --pass1only
             bPass1Only=true;
-            if (bPass2Only)
+            if ((bPass2Only) || (config.Pass3Only))
             {
-                fprintf(stderr, "markad: you cannot use --pass1only with --pass2only\n");
+                fprintf(stderr, "markad: you cannot use --pass1only with --pass2only or --pass3only\n");
                 return 2;
             }
             break;
@@ -3027,6 +4336,60 @@ int main(int argc, char *argv[])
             }
             break;
 
+        case 13: // --daemon
+            daemonSocket=optarg ? optarg : DEF_SOCKET;
+            bNice=true;
+            break;
+
+        case 14: // --jobs
+            if (isnumber(optarg) && atoi(optarg) > 0 && atoi(optarg) <= MAXJOBS)
+            {
+                maxJobs=atoi(optarg);
+            }
+            else
+            {
+                fprintf(stderr, "markad: invalid jobs value: %s\n", optarg);
+                return 2;
+            }
+            break;
+
+        case 15: // --indexonly
+            config.IndexOnly=config.GenIndex=true;
+            break;
+
+        case 16: // --fsync
+            config.IndexSync=true;
+            break;
+
+        case 17: // --parallel
+            if (isnumber(optarg) && atoi(optarg) >= 0 && atoi(optarg) <= MAXSEGJOBS)
+            {
+                config.parallel=atoi(optarg);
+            }
+            else
+            {
+                fprintf(stderr, "markad: invalid parallel value: %s\n", optarg);
+                return 2;
+            }
+            break;
+
+        case 18: // --trace
+            traceFile=optarg;
+            break;
+
+        case 19: // --profile
+            bProfile=true;
+            break;
+
+        case 20: // --dump-frames
+            strncpy(config.dumpFrames,optarg,sizeof(config.dumpFrames));
+            config.dumpFrames[sizeof(config.dumpFrames)-1]=0;
+            break;
+
+        case 21: // --replay
+            replayFile=optarg;
+            break;
+
         default:
             printf ("? getopt returned character code 0%o ? (option_index %d)\n", c,option_index);
         }
@@ -3068,6 +4431,36 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (replayFile)
+    {
+        // detectors only, no recording needed
+        cMarkAdReplay replay(&config);
+        if (traceFile) cMarkAdTrace::Start(traceFile);
+        if (bProfile) cMarkAdProfile::Start();
+        int ret=replay.Process(replayFile);
+        cMarkAdTrace::Stop();
+        if (bProfile) cMarkAdProfile::Stop();
+        return ret;
+    }
+
+    // the segments would write their frames at the same time
+    if (config.dumpFrames[0])
+    {
+        if (daemonSocket)
+        {
+            fprintf(stderr, "markad: --dump-frames needs a single recording, not --daemon\n");
+            return 2;
+        }
+        config.parallel=0;
+    }
+
+    // the events of all jobs would be kept until the daemon exits
+    if ((traceFile) && (daemonSocket))
+    {
+        fprintf(stderr, "markad: --trace needs a single recording, not --daemon\n");
+        return 2;
+    }
+
     // do nothing if called from vdr before/after the video is cutted
     if (bEdited) return 0;
     if ((bAfter) && (online)) return 0;
@@ -3075,7 +4468,7 @@ int main(int argc, char *argv[])
 
     // we can run, if one of bImmediateCall, bAfter, bBefore or bNice is true
     // and recDir is given
-    if ( (bImmediateCall || config.Before || bAfter || bNice) && recDir )
+    if ( ((bImmediateCall || config.Before || bAfter || bNice) && recDir) || daemonSocket )
     {
         // if bFork is given go in background
         if ( bFork )
@@ -3169,6 +4562,30 @@ int main(int argc, char *argv[])
             }
         }
 
+        if (daemonSocket)
+        {
+            // logfiles in recording directories would mix up all jobs
+            LOG2REC=false;
+            signal(SIGHUP, SIG_IGN);
+            signal(SIGPIPE, SIG_IGN);
+            signal(SIGINT, signal_handler);
+            signal(SIGTERM, signal_handler);
+            signal(SIGSEGV, signal_handler);
+            signal(SIGABRT, signal_handler);
+            signal(SIGTSTP, signal_handler);
+            signal(SIGCONT, signal_handler);
+
+            cmdaemon = new cMarkAdDaemon(daemonSocket,&config,maxJobs);
+            if (!cmdaemon) return -1;
+            if (bProfile) cMarkAdProfile::Start();
+            int ret=cmdaemon->Process();
+            delete cmdaemon;
+            cmdaemon=NULL;
+            cMarkAdTrace::Stop();
+            if (bProfile) cMarkAdProfile::Stop();
+            return ret;
+        }
+
         // now do the work...
         struct stat statbuf;
         if (stat(recDir,&statbuf)==-1)
@@ -3204,9 +4621,20 @@ int main(int argc, char *argv[])
         cmasta = new cMarkAdStandalone(recDir,&config);
         if (!cmasta) return -1;
 
-        if (!bPass2Only) cmasta->Process();
-        if (!bPass1Only) cmasta->Process2ndPass();
+        if (traceFile) cMarkAdTrace::Start(traceFile);
+        if (bProfile) cMarkAdProfile::Start();
+        if (config.Pass3Only)
+        {
+            cmasta->Process3rdPass();
+        }
+        else
+        {
+            if (!bPass2Only) cmasta->Process();
+            if (!bPass1Only) cmasta->Process2ndPass();
+        }
         delete cmasta;
+        cMarkAdTrace::Stop();
+        if (bProfile) cMarkAdProfile::Stop();
         return 0;
     }
     return usage(config.svdrpport);
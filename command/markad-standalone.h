@@ -8,6 +8,8 @@
 #ifndef __markad_standalone_h_
 #define __markad_standalone_h_
 
+#include <signal.h>
+
 #include "global.h"
 #include "demux.h"
 #include "decoder.h"
@@ -15,6 +17,17 @@
 #include "audio.h"
 #include "streaminfo.h"
 #include "marks.h"
+#include "follow.h"
+#include "livestream.h"
+#include "checkpoint.h"
+#include "framecache.h"
+#include "y4m.h"
+#include "replay.h"
+#include "timeline.h"
+#include "columns.h"
+#include "progress.h"
+#include "trace.h"
+#include "profile.h"
 
 #define trcs(c) bind_textdomain_codeset("markad",c)
 #define tr(s) dgettext("markad",s)
@@ -27,6 +40,12 @@
 
 #define MAXRANGE 120 /* range to search for start/stop marks in seconds */
 
+#define MAXBLACKDIST 10 /* max. distance in seconds a mark is moved to a separator frame */
+
+#define SEGWARMUP (MINBORDERSECS+30) /* seconds a segment starts before its file */
+#define DECODE_MAXREAD 8388608 /* bytes read at most to decode one iframe */
+#define MAXSEGJOBS 32
+
 class cOSDMessage
 {
 private:
@@ -188,7 +207,10 @@ unsigned Descriptor_Length:
     int framecnt;
     int framecnt2; // 2nd pass
 
-    bool abort;
+    // set by signals and the daemon, read by the segment workers
+    volatile sig_atomic_t abort;
+    volatile sig_atomic_t paused;
+    int pass;
     bool gotendmark;
     int waittime;
     int iwaittime;
@@ -215,6 +237,8 @@ unsigned Descriptor_Length:
 
     void CheckStop();
     void CheckStart();
+    void CheckIFrame();
+    void CheckStartStop();
     void CalculateCheckPositions(int startframe);
     int chkSTART;
     int chkSTOP;
@@ -224,16 +248,99 @@ unsigned Descriptor_Length:
 
     time_t GetBroadcastStart(time_t start, int fd);
     void CheckIndexGrowing();
+    void CheckPause();
+    bool WaitForData(int File, int Number, int *PFrame, bool *Last);
+    cMarkAdFollow *follow;
+
+    cMarkAdLiveStream *live;
+    uchar livepkt[MARKAD_RING_PACKET]; // last packet we got
+    bool livepktValid;
+    bool liveDone;
+    int liveFile;      // file and position after livepkt when attaching
+    off_t liveOffset;
+    uint64_t liveBytes; // bytes from live stream till livepkt
+    int resumeFile;    // continue in this file after losing the live stream
+    off_t resumeOffset;
+    int LastPacket(const uchar *Data, int Length);
+    int ProcessLive(int Number, int *PFrame);
+    void SeekLivePacket();
+
+    cMarkAdCheckpoint *checkpoint;
+    cMarkAdFrameCache *framecache;
+    // stream the 2nd pass decodes its iframes from, kept open so the next
+    // iframe of the index continues the read instead of a new start
+    int decodefd;
+    int decodenumber;  // file number of decodefd
+    int decodelast;    // iframe decoded last from decodefd, -1 if none
+    bool decodeclean;  // pipeline cleared and nothing fed since
+    uchar *decodebuf;  // read but not demuxed yet
+    int decodepos,decodelen;
+    void CloseDecode();
+    cMarkAdY4M *dump; // --dump-frames
+    cMarkAdTimeline *timeline;
+    cMarkAdProgress *progress;
+    FILE *logfile; // markad.log of a daemon job (-R)
+    uint64_t bytesread; // from the recording, for the progress
+    int progressframes; // frames of the recording, read at most once a second
+    time_t progresschecked;
+    void UpdateProgress(int File);
+    void AddTimeline(int Type, MarkAdVideoFeatures *Features=NULL);
+    time_t lastcheckpoint;
+    void SaveCheckpoint();
+    bool LoadCheckpoint();
     char *indexFile;
     int sleepcnt;
 
     void SaveFrame(int Frame);
 
+    // segment-parallel first pass: workers process the following
+    // files (starting SEGWARMUP seconds before the file) and just
+    // record what happened, we replay it if the detector state of
+    // the worker equals ours at the start of the file
+    enum { sIFRAME=1, sPROCESSED, sMARK, sBUFFER, sAUDIO };
+    struct segevent
+    {
+        int Type;
+        int Framecnt;
+        int LastIFrame;
+        int IFrame;
+        int Channels;
+        MarkAdMark Mark;
+        MarkAdVideoFeatures Features;
+    };
+    cMarkAdStandalone *parent; // set in workers
+    cMarkAdStandalone **segs;
+    int segfiles;
+    int segnext;
+    int segskipped;
+    int segfile;
+    bool segok;
+    pthread_t segthread;
+    cMarkAdCheckpoint *segstate;
+    struct segevent *segevents;
+    int segeventcnt;
+    int segeventmax;
+    cMarkAdStandalone(cMarkAdStandalone *Parent, int File, int Frame, int Number, off_t Offset);
+    static void *segworker(void *Seg);
+    void AddSegEvent(int Type, MarkAdMark *Mark=NULL, MarkAdVideoFeatures *Features=NULL);
+    void SaveSegmentState();
+    bool CheckSegmentState(cMarkAdStandalone *Seg);
+    void StartSegments(int File);
+    bool MergeSegment(cMarkAdStandalone **Cur, int File);
+    void StopSegments();
+    void Replay(cMarkAdStandalone *Seg);
+    void ProcessSegment();
+
     clMarks marks;
+    clMarks blackmarks; // separator frames, not in the marks file
+    cMarkAdColumns columns;
     char *IndexToHMSF(int Index);
     void AddMark(MarkAdMark *Mark);
     bool Reset(bool FirstPass=true);
+    bool ProcessData(uchar *Data, int Length, int Number, int *PFrame);
     void ChangeMarks(clMark **Mark1, clMark **Mark2, MarkAdPos *NewPos);
+    void LoadBlackMarks();
+    bool AlignMark(clMark **Mark, bool Start);
 
     bool CheckVDRHD();
     off_t SeekPATPMT();
@@ -241,11 +348,13 @@ unsigned Descriptor_Length:
     bool CheckTS();
     bool CheckLogo();
     void CheckLogoMarks();
+    void CheckEnd();
     bool LoadInfo();
     bool SaveInfo();
     bool SetFileUID(char *File);
     bool RegenerateIndex();
-    bool ProcessFile2ndPass(clMark **Mark1, clMark **Mark2, int Number, off_t Offset, int Frame, int Frames);
+    const MarkAdFrame *DecodeIFrameAt(int FrameNumber);
+    bool ProcessFile2ndPass(clMark **Mark1, clMark **Mark2, int Frame, int Frames);
     bool ProcessFile(int Number);
     void ProcessFile();
 public:
@@ -255,6 +364,12 @@ public:
     {
         abort=true;
     }
+    void SetPause(bool Pause)
+    {
+        paused=Pause;
+    }
+    int GetProgress(int *Pass);
+    void Process3rdPass();
     void Process2ndPass();
     void Process();
 };
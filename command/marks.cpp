@@ -14,175 +14,271 @@
 #include <string.h>
 #include <stdint.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include "marks.h"
 
-clMark::clMark(int Type, int Position, const char *Comment)
+clMark::clMark()
 {
-    type=Type;
-    position=Position;
-    if (Comment)
-    {
-        comment=strdup(Comment);
-    }
-    else
-    {
-        comment=NULL;
-    }
-    prev=NULL;
-    next=NULL;
+    owner=NULL;
+    nextfree=NULL;
+    type=0;
+    position=0;
+    comment=NULL;
 }
 
-clMark::~clMark()
+clMark *clMark::Next()
 {
-    if (comment) free(comment);
+    if (!owner) return NULL;
+    return owner->GetNeighbour(this,1);
+}
+
+clMark *clMark::Prev()
+{
+    if (!owner) return NULL;
+    return owner->GetNeighbour(this,-1);
 }
 
 // --------------------------------------------------------------------------
 
-clMarks::~clMarks()
+clMarks::clMarks()
 {
-    DelAll();
-    if (indexfd!=-1) close(indexfd);
+    strcpy(filename,"marks");
+    marks=NULL;
+    count=max=0;
+    memset(types,0,sizeof(types));
+    markchunks=NULL;
+    freemarks=NULL;
+    textchunks=NULL;
+    savedcount=0;
+    indexfd=-1;
+    indexbuf=NULL;
+    indexbuflen=0;
+    indexerror=false;
+    indexsync=false;
+    iframes=NULL;
+    iframecnt=iframemax=0;
+    indexframes=0;
 }
 
-int clMarks::Count(int Type, int Mask)
+clMarks::~clMarks()
 {
-    if (Type==0xFF) return count;
-
-    if (!first) return 0;
-
-    int ret=0;
-    clMark *mark=first;
-    while (mark)
+    DelAll();
+    while (markchunks)
     {
-        if ((mark->type & Mask)==Type) ret++;
-        mark=mark->Next();
+        markchunk *next=markchunks->next;
+        delete markchunks;
+        markchunks=next;
     }
-    return ret;
+    while (textchunks)
+    {
+        textchunk *next=textchunks->next;
+        ::free(textchunks);
+        textchunks=next;
+    }
+    for (int t=0; t<256; t++)
+    {
+        if (types[t].marks) ::free(types[t].marks);
+    }
+    if (marks) ::free(marks);
+    if (indexfd!=-1) close(indexfd);
+    if (indexbuf) ::free(indexbuf);
+    if (iframes) ::free(iframes);
 }
 
-void clMarks::Del(int Position)
+clMark *clMarks::newmark()
 {
-    if (!first) return; // no elements yet
-
-    clMark *next,*mark=first;
-    while (mark)
+    if (!freemarks)
     {
-        next=mark->Next();
-        if (mark->position==Position)
+        markchunk *chunk=new markchunk;
+        if (!chunk) return NULL;
+        chunk->next=markchunks;
+        markchunks=chunk;
+        for (int i=MARKCHUNK-1; i>=0; i--)
         {
-            Del(mark);
-            return;
+            chunk->marks[i].nextfree=freemarks;
+            freemarks=&chunk->marks[i];
         }
-        mark=next;
     }
+    clMark *mark=freemarks;
+    freemarks=mark->nextfree;
+    mark->nextfree=NULL;
+    mark->owner=this;
+    mark->comment=NULL;
+    return mark;
 }
 
-void clMarks::Del(unsigned char Type)
+char *clMarks::newtext(const char *Text)
 {
-    if (!first) return; // no elements yet
-
-    clMark *next,*mark=first;
-    while (mark)
+    // comments of deleted marks are kept till DelAll
+    if (!Text) return NULL;
+    int len=strlen(Text)+1;
+    if ((!textchunks) || (textchunks->size-textchunks->used<len))
     {
-        next=mark->Next();
-        if (mark->type==Type) Del(mark);
-        mark=next;
+        int size=(len>TEXTCHUNK) ? len : TEXTCHUNK;
+        textchunk *chunk=(textchunk *) malloc(sizeof(textchunk)+size);
+        if (!chunk) return NULL;
+        chunk->next=textchunks;
+        chunk->size=size;
+        chunk->used=0;
+        textchunks=chunk;
     }
+    char *ret=&textchunks->data[textchunks->used];
+    memcpy(ret,Text,len);
+    textchunks->used+=len;
+    return ret;
 }
 
-void clMarks::DelTill(int Position, bool FromStart)
+int clMarks::lowerbound(clMark **Marks, int Count, int Position)
 {
-    clMark *next,*mark=first;
-    if (!FromStart)
-    {
-        while (mark)
-        {
-            if (mark->position>Position) break;
-            mark=mark->Next();
-        }
-    }
-
-    while (mark)
+    // index of the first mark at or after Position
+    int lo=0,hi=Count;
+    while (lo<hi)
     {
-        next=mark->Next();
-        if (FromStart)
+        int mid=(lo+hi)/2;
+        if (Marks[mid]->position<Position)
         {
-            if (mark->position<Position)
-            {
-                Del(mark);
-            }
+            lo=mid+1;
         }
         else
         {
-            Del(mark);
+            hi=mid;
         }
-        mark=next;
     }
+    return lo;
 }
 
-void clMarks::DelAll()
+bool clMarks::insert(clMark **&Marks, int &Count, int &Max, int Index, clMark *Mark)
 {
-    clMark *next,*mark=first;
-    while (mark)
+    if (Count>=Max)
     {
-        next=mark->Next();
-        Del(mark);
-        mark=next;
+        int nmax=Max ? Max*2 : 64;
+        clMark **tmp=(clMark **) realloc(Marks,nmax*sizeof(clMark *));
+        if (!tmp) return false;
+        Marks=tmp;
+        Max=nmax;
     }
-    first=NULL;
-    last=NULL;
+    memmove(&Marks[Index+1],&Marks[Index],(Count-Index)*sizeof(clMark *));
+    Marks[Index]=Mark;
+    Count++;
+    return true;
 }
 
+void clMarks::remove(clMark **Marks, int &Count, int Index)
+{
+    memmove(&Marks[Index],&Marks[Index+1],(Count-Index-1)*sizeof(clMark *));
+    Count--;
+}
 
-void clMarks::Del(clMark *Mark)
+void clMarks::unindex(clMark *Mark)
 {
-    if (!Mark) return;
+    typeindex *ti=&types[Mark->type & 0xFF];
+    int i=lowerbound(ti->marks,ti->count,Mark->position);
+    if ((i<ti->count) && (ti->marks[i]==Mark)) remove(ti->marks,ti->count,i);
+}
 
-    if (first==Mark)
+void clMarks::release(int First, int Last)
+{
+    // remove marks First..Last (inclusive) from all lists
+    if ((First<0) || (Last>=count) || (First>Last)) return;
+    for (int i=First; i<=Last; i++)
     {
-        // we are the first mark
-        first=Mark->Next();
-        if (first)
-        {
-            first->SetPrev(NULL);
-        }
-        else
-        {
-            last=NULL;
-        }
+        clMark *mark=marks[i];
+        unindex(mark);
+        mark->owner=NULL;
+        mark->comment=NULL;
+        mark->nextfree=freemarks;
+        freemarks=mark;
     }
-    else
+    memmove(&marks[First],&marks[Last+1],(count-Last-1)*sizeof(clMark *));
+    count-=Last-First+1;
+}
+
+int clMarks::Count(int Type, int Mask)
+{
+    if (Type==0xFF) return count;
+
+    int ret=0;
+    for (int t=0; t<256; t++)
     {
-        if (Mark->Next() && (Mark->Prev()))
-        {
-            // there is a next and prev object
-            Mark->Prev()->SetNext(Mark->Next());
-            Mark->Next()->SetPrev(Mark->Prev());
-        }
-        else
+        if ((types[t].count) && ((t & Mask)==Type)) ret+=types[t].count;
+    }
+    return ret;
+}
+
+void clMarks::Del(int Position)
+{
+    Del(Get(Position));
+}
+
+void clMarks::Del(unsigned char Type)
+{
+    typeindex *ti=&types[Type];
+    if (!ti->count) return;
+    int n=0;
+    for (int i=0; i<count; i++)
+    {
+        clMark *mark=marks[i];
+        if (mark->type==Type)
         {
-            // we are the last
-            Mark->Prev()->SetNext(NULL);
-            last=Mark->Prev();
+            mark->owner=NULL;
+            mark->comment=NULL;
+            mark->nextfree=freemarks;
+            freemarks=mark;
+            continue;
         }
+        marks[n++]=mark;
     }
-    delete Mark;
-    count--;
+    count=n;
+    ti->count=0;
 }
 
-clMark *clMarks::Get(int Position)
+void clMarks::DelTill(int Position, bool FromStart)
 {
-    if (!first) return NULL; // no elements yet
+    if (FromStart)
+    {
+        // all marks before Position
+        release(0,lowerbound(marks,count,Position)-1);
+    }
+    else
+    {
+        // all marks after Position
+        release(lowerbound(marks,count,Position+1),count-1);
+    }
+}
 
-    clMark *mark=first;
-    while (mark)
+void clMarks::DelAll()
+{
+    release(0,count-1);
+    // no comment is used anymore
+    while ((textchunks) && (textchunks->next))
     {
-        if (Position==mark->position) break;
-        mark=mark->Next();
+        textchunk *next=textchunks->next;
+        ::free(textchunks);
+        textchunks=next;
     }
-    return mark;
+    if (textchunks) textchunks->used=0;
+}
+
+void clMarks::Del(clMark *Mark)
+{
+    if ((!Mark) || (Mark->owner!=this)) return;
+    int i=lowerbound(marks,count,Mark->position);
+    if ((i<count) && (marks[i]==Mark)) release(i,i);
+}
+
+clMark *clMarks::Get(int Position)
+{
+    int i=lowerbound(marks,count,Position);
+    if ((i<count) && (marks[i]->position==Position)) return marks[i];
+    return NULL;
+}
+
+clMark *clMarks::GetNeighbour(clMark *Mark, int Direction)
+{
+    int i=lowerbound(marks,count,Mark->position)+Direction;
+    if ((i<0) || (i>=count)) return NULL;
+    return marks[i];
 }
 
 clMark *clMarks::GetAround(int Frames, int Position, int Type, int Mask)
@@ -210,140 +306,85 @@ clMark *clMarks::GetAround(int Frames, int Position, int Type, int Mask)
 
 clMark *clMarks::GetPrev(int Position, int Type, int Mask)
 {
-    if (!first) return NULL; // no elements yet
-
-    // first advance
-    clMark *mark=first;
-    while (mark)
-    {
-        if (mark->position>=Position) break;
-        mark=mark->Next();
-    }
+    // last mark before Position
     if (Type==0xFF)
     {
-        if (mark) return mark->Prev();
-        return last;
+        int i=lowerbound(marks,count,Position);
+        return i ? marks[i-1] : NULL;
     }
-    else
+    clMark *ret=NULL;
+    for (int t=0; t<256; t++)
     {
-        if (!mark) mark=last;
-        else mark=mark->Prev();
-        while (mark)
-        {
-            if ((mark->type & Mask)==Type) break;
-            mark=mark->Prev();
-        }
-        return mark;
+        typeindex *ti=&types[t];
+        if ((!ti->count) || ((t & Mask)!=Type)) continue;
+        int i=lowerbound(ti->marks,ti->count,Position);
+        if ((i) && ((!ret) || (ti->marks[i-1]->position>ret->position))) ret=ti->marks[i-1];
     }
+    return ret;
 }
 
 clMark *clMarks::GetNext(int Position, int Type, int Mask)
 {
-    if (!first) return NULL; // no elements yet
-    clMark *mark=first;
-    while (mark)
+    // first mark after Position
+    if (Type==0xFF)
     {
-        if (Type==0xFF)
-        {
-            if (mark->position>Position) break;
-        }
-        else
-        {
-            if ((mark->position>Position) && ((mark->type & Mask)==Type)) break;
-        }
-        mark=mark->Next();
+        int i=lowerbound(marks,count,Position+1);
+        return (i<count) ? marks[i] : NULL;
     }
-    if (mark) return mark;
-    return NULL;
+    clMark *ret=NULL;
+    for (int t=0; t<256; t++)
+    {
+        typeindex *ti=&types[t];
+        if ((!ti->count) || ((t & Mask)!=Type)) continue;
+        int i=lowerbound(ti->marks,ti->count,Position+1);
+        if ((i<ti->count) && ((!ret) || (ti->marks[i]->position<ret->position))) ret=ti->marks[i];
+    }
+    return ret;
 }
 
 clMark *clMarks::Add(int Type, int Position,const char *Comment)
 {
-    clMark *newmark;
-    if ((newmark=Get(Position)))
+    int i=lowerbound(marks,count,Position);
+    if ((i<count) && (marks[i]->position==Position))
     {
-        if ((newmark->comment) && (Comment))
+        clMark *mark=marks[i];
+        if ((mark->comment) && (Comment)) mark->comment=newtext(Comment);
+        if (mark->type!=Type)
         {
-            free(newmark->comment);
-            newmark->comment=strdup(Comment);
+            unindex(mark);
+            mark->type=Type;
+            typeindex *ti=&types[Type & 0xFF];
+            if (!insert(ti->marks,ti->count,ti->max,lowerbound(ti->marks,ti->count,Position),mark))
+            {
+                release(i,i);
+                return NULL;
+            }
         }
-        newmark->type=Type;
-        return newmark;
+        return mark;
     }
 
-    newmark=new clMark(Type, Position,Comment);
-    if (!newmark) return NULL;
-
-    if (!first)
+    clMark *mark=newmark();
+    if (!mark) return NULL;
+    mark->type=Type;
+    mark->position=Position;
+    mark->comment=newtext(Comment);
+    if (!insert(marks,count,max,i,mark))
     {
-        //first element
-        first=last=newmark;
-        count++;
-        return newmark;
+        mark->owner=NULL;
+        mark->nextfree=freemarks;
+        freemarks=mark;
+        return NULL;
     }
-    else
+    typeindex *ti=&types[Type & 0xFF];
+    if (!insert(ti->marks,ti->count,ti->max,lowerbound(ti->marks,ti->count,Position),mark))
     {
-        clMark *mark=first;
-        while (mark)
-        {
-            if (!mark->Next())
-            {
-                if (Position>mark->position)
-                {
-                    // add as last element
-                    newmark->Set(mark,NULL);
-                    mark->SetNext(newmark);
-                    last=newmark;
-                    break;
-                }
-                else
-                {
-                    // add before
-                    if (!mark->Prev())
-                    {
-                        // add as first element
-                        newmark->Set(NULL,mark);
-                        mark->SetPrev(newmark);
-                        first=newmark;
-                        break;
-                    }
-                    else
-                    {
-                        newmark->Set(mark->Prev(),mark);
-                        mark->SetPrev(newmark);
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                if ((Position>mark->position) && (Position<mark->Next()->position))
-                {
-                    // add between two marks
-                    newmark->Set(mark,mark->Next());
-                    mark->SetNext(newmark);
-                    newmark->Next()->SetPrev(newmark);
-                    break;
-                }
-                else
-                {
-                    if ((Position<mark->position) && (mark==first))
-                    {
-                        // add as first mark
-                        first=newmark;
-                        mark->SetPrev(newmark);
-                        newmark->SetNext(mark);
-                        break;
-                    }
-                }
-            }
-            mark=mark->Next();
-        }
-        if (!mark)return NULL;
-        count++;
-        return newmark;
+        remove(marks,count,i);
+        mark->owner=NULL;
+        mark->nextfree=freemarks;
+        freemarks=mark;
+        return NULL;
     }
-    return NULL;
+    return mark;
 }
 
 char *clMarks::IndexToHMSF(int Index, double FramesPerSecond)
@@ -474,9 +515,30 @@ bool clMarks::ReadIndex(const char *Directory, bool isTS, int FrameNumber, int R
     return true;
 }
 
+bool clMarks::FlushIndex()
+{
+    if ((indexfd==-1) || (!indexbuf)) return false;
+    int pos=0;
+    while (pos<indexbuflen)
+    {
+        ssize_t ret=write(indexfd,indexbuf+pos,indexbuflen-pos);
+        if (ret==-1)
+        {
+            if (errno==EINTR) continue;
+            indexerror=true;
+            break;
+        }
+        pos+=ret;
+    }
+    indexbuflen=0;
+    // one sync per block instead of one per frame
+    if ((indexsync) && (!indexerror) && (fdatasync(indexfd)==-1)) indexerror=true;
+    return !indexerror;
+}
+
 void clMarks::WriteIndex(bool isTS, uint64_t Offset, int FrameType, int Number)
 {
-    if (indexfd==-1) return;
+    if ((indexfd==-1) || (indexerror)) return;
     if (isTS)
     {
         struct tIndexTS IndexTS;
@@ -484,7 +546,8 @@ void clMarks::WriteIndex(bool isTS, uint64_t Offset, int FrameType, int Number)
         IndexTS.reserved=0;
         IndexTS.independent=(FrameType==1);
         IndexTS.number=(uint16_t) Number;
-        if (write(indexfd,&IndexTS,sizeof(IndexTS))!=sizeof(IndexTS)) return;
+        memcpy(indexbuf+indexbuflen,&IndexTS,sizeof(IndexTS));
+        indexbuflen+=sizeof(IndexTS);
     }
     else
     {
@@ -493,8 +556,10 @@ void clMarks::WriteIndex(bool isTS, uint64_t Offset, int FrameType, int Number)
         IndexVDR.type=(unsigned char) FrameType;
         IndexVDR.number=(unsigned char) Number;
         IndexVDR.reserved=0;
-        if (write(indexfd,&IndexVDR,sizeof(IndexVDR))!=sizeof(IndexVDR)) return;
+        memcpy(indexbuf+indexbuflen,&IndexVDR,sizeof(IndexVDR));
+        indexbuflen+=sizeof(IndexVDR);
     }
+    if (indexbuflen>INDEXBUFSIZE-16) FlushIndex();
 }
 
 void clMarks::WriteIndex(const char *Directory, bool isTS, uint64_t Offset,
@@ -504,17 +569,256 @@ void clMarks::WriteIndex(const char *Directory, bool isTS, uint64_t Offset,
     {
         char *ipath=NULL;
         if (asprintf(&ipath,"%s/index%s.generated",Directory,isTS ? "" : ".vdr")==-1) return;
+        if (!indexbuf) indexbuf=(char *) malloc(INDEXBUFSIZE);
+        if (!indexbuf)
+        {
+            free(ipath);
+            return;
+        }
         indexfd=open(ipath,O_WRONLY|O_CREAT|O_TRUNC,0644);
         free(ipath);
         if (indexfd==-1) return;
+        indexbuflen=0;
+        indexerror=false;
     }
     WriteIndex(isTS,Offset,FrameType,Number);
     return;
 }
 
-void clMarks::CloseIndex(const char *Directory, bool isTS)
+int clMarks::openindex(const char *Directory, bool isTS)
+{
+    char *ipath=NULL;
+    if (asprintf(&ipath,"%s/index%s",Directory,isTS ? "" : ".vdr")==-1) return -1;
+    int ifd=open(ipath,O_RDONLY);
+    free(ipath);
+    return ifd;
+}
+
+bool clMarks::readindex(int fd, bool isTS, int FrameNumber, int *Number, off_t *Offset, bool *IFrame)
+{
+    if (FrameNumber<0) return false;
+    if (isTS)
+    {
+        struct tIndexTS IndexTS;
+        off_t pos=FrameNumber*sizeof(IndexTS);
+        if (pread(fd,&IndexTS,sizeof(IndexTS),pos)!=sizeof(IndexTS)) return false;
+        *Number=IndexTS.number;
+        *Offset=IndexTS.offset;
+        *IFrame=IndexTS.independent;
+    }
+    else
+    {
+        struct tIndexVDR IndexVDR;
+        off_t pos=FrameNumber*sizeof(IndexVDR);
+        if (pread(fd,&IndexVDR,sizeof(IndexVDR),pos)!=sizeof(IndexVDR)) return false;
+        *Number=IndexVDR.number;
+        *Offset=IndexVDR.offset;
+        *IFrame=(IndexVDR.type==1);
+    }
+    return true;
+}
+
+bool clMarks::ReadIndexIFrame(const char *Directory, bool isTS, int FrameNumber, int *Number, off_t *Offset)
+{
+    // position of FrameNumber, only if it's an iframe
+    int ifd=openindex(Directory,isTS);
+    if (ifd==-1) return false;
+
+    bool iframe=false;
+    bool ret=((readindex(ifd,isTS,FrameNumber,Number,Offset,&iframe)) && (iframe));
+    close(ifd);
+    return ret;
+}
+
+bool clMarks::loadiframes(const char *Directory, bool isTS)
+{
+    int ifd=openindex(Directory,isTS);
+    if (ifd==-1) return false;
+
+    iframecnt=0;
+    indexframes=0;
+    // both index formats have 8 byte entries
+    const int entries=8192;
+    uint64_t buf[entries];
+    ssize_t len;
+    while ((len=read(ifd,buf,sizeof(buf)))>=8)
+    {
+        int cnt=(int) (len/8);
+        for (int i=0; i<cnt; i++)
+        {
+            bool iframe;
+            int number;
+            off_t offset;
+            if (isTS)
+            {
+                struct tIndexTS *IndexTS=(struct tIndexTS *) &buf[i];
+                iframe=IndexTS->independent;
+                number=IndexTS->number;
+                offset=IndexTS->offset;
+            }
+            else
+            {
+                struct tIndexVDR *IndexVDR=(struct tIndexVDR *) &buf[i];
+                iframe=(IndexVDR->type==1);
+                number=IndexVDR->number;
+                offset=IndexVDR->offset;
+            }
+            if (iframe)
+            {
+                if (iframecnt>=iframemax)
+                {
+                    int nmax=iframemax ? iframemax*2 : 4096;
+                    struct indexiframe *n=(struct indexiframe *) realloc(iframes,nmax*sizeof(*iframes));
+                    if (!n)
+                    {
+                        close(ifd);
+                        return false;
+                    }
+                    iframes=n;
+                    iframemax=nmax;
+                }
+                iframes[iframecnt].frame=indexframes+i;
+                iframes[iframecnt].number=number;
+                iframes[iframecnt].offset=offset;
+                iframecnt++;
+            }
+        }
+        indexframes+=cnt;
+        // a partly written entry at the end is read again next time
+        if (len%8) break;
+    }
+    close(ifd);
+    return (iframecnt>0);
+}
+
+bool clMarks::ReadIndexIFrameBefore(const char *Directory, bool isTS, int FrameNumber, int *IFrame,
+                                    int *Number, off_t *Offset)
 {
-    if (indexfd==-1) return;
+    // last iframe at or before FrameNumber
+    if (FrameNumber<0) return false;
+    if (((!iframecnt) || (FrameNumber>=indexframes)) && (!loadiframes(Directory,isTS))) return false;
+    if (FrameNumber>=indexframes) return false;
+
+    int lo=0,hi=iframecnt-1,ret=-1;
+    while (lo<=hi)
+    {
+        int mid=(lo+hi)/2;
+        if (iframes[mid].frame<=FrameNumber)
+        {
+            ret=mid;
+            lo=mid+1;
+        }
+        else
+        {
+            hi=mid-1;
+        }
+    }
+    if (ret==-1) return false;
+    *IFrame=iframes[ret].frame;
+    if (Number) *Number=iframes[ret].number;
+    if (Offset) *Offset=iframes[ret].offset;
+    return true;
+}
+
+bool clMarks::ReadIndexIFrameAfter(const char *Directory, bool isTS, int FrameNumber, int *IFrame,
+                                   int *Number, off_t *Offset)
+{
+    // first iframe at or after FrameNumber
+    if (FrameNumber<0) FrameNumber=0;
+    if ((!iframecnt) || (FrameNumber>iframes[iframecnt-1].frame))
+    {
+        if (!loadiframes(Directory,isTS)) return false;
+        if (FrameNumber>iframes[iframecnt-1].frame) return false;
+    }
+
+    int lo=0,hi=iframecnt-1,ret=iframecnt-1;
+    while (lo<=hi)
+    {
+        int mid=(lo+hi)/2;
+        if (iframes[mid].frame>=FrameNumber)
+        {
+            ret=mid;
+            hi=mid-1;
+        }
+        else
+        {
+            lo=mid+1;
+        }
+    }
+    *IFrame=iframes[ret].frame;
+    if (Number) *Number=iframes[ret].number;
+    if (Offset) *Offset=iframes[ret].offset;
+    return true;
+}
+
+int clMarks::ReadIndexLastFile(const char *Directory, bool isTS)
+{
+    // file number of the last frame in the index
+    int ifd=openindex(Directory,isTS);
+    if (ifd==-1) return -1;
+
+    int ret=-1;
+    struct stat statbuf;
+    if ((fstat(ifd,&statbuf)!=-1) && (statbuf.st_size>=8))
+    {
+        int number;
+        off_t offset;
+        bool iframe;
+        if (readindex(ifd,isTS,(int) (statbuf.st_size/8)-1,&number,&offset,&iframe)) ret=number;
+    }
+    close(ifd);
+    return ret;
+}
+
+int clMarks::ReadIndexFileStart(const char *Directory, bool isTS, int Number)
+{
+    // first frame in file Number, -1 if the index doesn't reach it
+    int ifd=openindex(Directory,isTS);
+    if (ifd==-1) return -1;
+
+    struct stat statbuf;
+    if (fstat(ifd,&statbuf)==-1)
+    {
+        close(ifd);
+        return -1;
+    }
+    // both index formats have 8 byte entries, sorted by file number
+    int lo=0,hi=(int) (statbuf.st_size/8);
+    while (lo<hi)
+    {
+        int mid=lo+(hi-lo)/2;
+        int number;
+        off_t offset;
+        bool iframe;
+        if (!readindex(ifd,isTS,mid,&number,&offset,&iframe))
+        {
+            close(ifd);
+            return -1;
+        }
+        if (number<Number)
+        {
+            lo=mid+1;
+        }
+        else
+        {
+            hi=mid;
+        }
+    }
+    int number;
+    off_t offset;
+    bool iframe;
+    bool ok=readindex(ifd,isTS,lo,&number,&offset,&iframe);
+    close(ifd);
+    if ((!ok) || (number!=Number)) return -1;
+    return lo;
+}
+
+bool clMarks::CloseIndex(const char *Directory, bool isTS)
+{
+    if (indexfd==-1) return true;
+    FlushIndex();
+    // data must be on disk before index.generated is renamed to index
+    if ((!indexerror) && (fsync(indexfd)==-1)) indexerror=true;
 
     if (getuid()==0 || geteuid()!=0)
     {
@@ -532,6 +836,13 @@ void clMarks::CloseIndex(const char *Directory, bool isTS)
     }
     close(indexfd);
     indexfd=-1;
+    if (indexerror)
+    {
+        // never let a partial index replace the old one
+        RemoveGeneratedIndex(Directory,isTS);
+        return false;
+    }
+    return true;
 }
 
 bool clMarks::CheckIndex(const char *Directory, bool isTS, int *FrameCnt, int *IndexError)
@@ -539,7 +850,7 @@ bool clMarks::CheckIndex(const char *Directory, bool isTS, int *FrameCnt, int *I
     if (!IndexError) return false;
     *IndexError=0;
 
-    if (!first) return true;
+    if (!count) return true;
 
     char *ipath=NULL;
     if (asprintf(&ipath,"%s/index%s",Directory,isTS ? "" : ".vdr")==-1) return false;
@@ -576,9 +887,9 @@ bool clMarks::CheckIndex(const char *Directory, bool isTS, int *FrameCnt, int *I
         }
     }
 
-    clMark *mark=first;
-    while (mark)
+    for (int i=0; i<count; i++)
     {
+        clMark *mark=marks[i];
         if (isTS)
         {
             off_t offset = mark->position * sizeof(struct tIndexTS);
@@ -619,7 +930,6 @@ bool clMarks::CheckIndex(const char *Directory, bool isTS, int *FrameCnt, int *I
                 break;
             }
         }
-        mark=mark->Next();
     }
     close(fd);
     return true;
@@ -689,9 +999,39 @@ bool clMarks::Load(const char *Directory, double FrameRate, bool isTS)
     return true;
 }
 
+void clMarks::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&count,sizeof(count));
+    for (int i=0; i<count; i++)
+    {
+        clMark *mark=marks[i];
+        Ckp->Put(&mark->type,sizeof(mark->type));
+        Ckp->Put(&mark->position,sizeof(mark->position));
+        Ckp->PutString(mark->comment);
+    }
+}
+
+bool clMarks::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    DelAll();
+    int cnt;
+    if (!Ckp->Get(&cnt,sizeof(cnt))) return false;
+    for (int i=0; i<cnt; i++)
+    {
+        int type,position;
+        Ckp->Get(&type,sizeof(type));
+        Ckp->Get(&position,sizeof(position));
+        char *comment=Ckp->GetString();
+        if (Ckp->Error()) return false;
+        Add(type,position,comment);
+        if (comment) free(comment);
+    }
+    return true;
+}
+
 bool clMarks::Save(const char *Directory, double FrameRate, bool isTS, bool Force)
 {
-    if (!first) return false;
+    if (!count) return false;
     if ((savedcount==count) && (!Force)) return false;
 
     char *fpath=NULL;
@@ -706,16 +1046,15 @@ bool clMarks::Save(const char *Directory, double FrameRate, bool isTS, bool Forc
         return false;
     }
 
-    clMark *mark=first;
-    while (mark)
+    for (int i=0; i<count; i++)
     {
+        clMark *mark=marks[i];
         char *buf=IndexToHMSF(mark->position,FrameRate);
         if (buf)
         {
             fprintf(mf,"%s %s\n",buf,mark->comment ? mark->comment : "");
             free(buf);
         }
-        mark=mark->Next();
     }
     fclose(mf);
 
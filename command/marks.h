@@ -10,38 +10,23 @@
 
 #include <string.h>
 
+#include "checkpoint.h"
+
+class clMarks;
+
 class clMark
 {
 private:
-    clMark *next;
-    clMark *prev;
+    friend class clMarks;
+    clMarks *owner;    // NULL if not in a list (free)
+    clMark *nextfree;
 public:
     int type;
     int position;
     char *comment;
-    clMark(int Type=0, int Position = 0, const char *Comment = NULL);
-    ~clMark();
-    clMark *Next()
-    {
-        return next;
-    };
-    clMark *Prev()
-    {
-        return prev;
-    };
-    void Set(clMark *Prev, clMark *Next)
-    {
-        prev=Prev;
-        next=Next;
-    }
-    void SetNext(clMark *Next)
-    {
-        next=Next;
-    }
-    void SetPrev(clMark *Prev)
-    {
-        prev=Prev;
-    }
+    clMark();
+    clMark *Next();
+    clMark *Prev();
 };
 
 class clMarks
@@ -68,21 +53,67 @@ uint16_t number:
     };
 
     char filename[1024];
-    clMark *first,*last;
-    char *IndexToHMSF(int Index, double FramesPerSecond);
+    // marks sorted by position, positions are unique
+    clMark **marks;
     int count;
+    int max;
+    // marks of every type sorted by position, for the Type/Mask queries
+    struct typeindex
+    {
+        clMark **marks;
+        int count;
+        int max;
+    } types[256];
+    // nodes and comments are taken from chunks, so pointers to marks
+    // stay valid if other marks are added or deleted
+#define MARKCHUNK 256
+    struct markchunk
+    {
+        markchunk *next;
+        clMark marks[MARKCHUNK];
+    } *markchunks;
+    clMark *freemarks;
+#define TEXTCHUNK 4096
+    struct textchunk
+    {
+        textchunk *next;
+        int size;
+        int used;
+        char data[1];
+    } *textchunks;
+    clMark *newmark();
+    char *newtext(const char *Text);
+    int lowerbound(clMark **Marks, int Count, int Position);
+    bool insert(clMark **&Marks, int &Count, int &Max, int Index, clMark *Mark);
+    void remove(clMark **Marks, int &Count, int Index);
+    void unindex(clMark *Mark);
+    void release(int First, int Last);
+    char *IndexToHMSF(int Index, double FramesPerSecond);
     int savedcount;
     int indexfd;
+#define INDEXBUFSIZE 65536
+    char *indexbuf;
+    int indexbuflen;
+    bool indexerror;
+    bool indexsync;
     void WriteIndex(bool isTS, uint64_t Offset,int FrameType, int Number);
-public:
-    clMarks()
+    bool FlushIndex();
+    int openindex(const char *Directory, bool isTS);
+    bool readindex(int fd, bool isTS, int FrameNumber, int *Number, off_t *Offset, bool *IFrame);
+    // iframes of the index, read once for the random access of the 2nd
+    // pass and read again only if a frame beyond the end is asked for
+    struct indexiframe
     {
-        strcpy(filename,"marks");
-        first=last=NULL;
-        savedcount=0;
-        count=0;
-        indexfd=-1;
-    }
+        int frame;
+        int number;
+        off_t offset;
+    } *iframes;
+    int iframecnt;
+    int iframemax;
+    int indexframes; // frames in the index when the iframes were read
+    bool loadiframes(const char *Directory, bool isTS);
+public:
+    clMarks();
     ~clMarks();
     int Count(int Type=0xFF, int Mask=0xFF);
     void SetFileName(const char *FileName)
@@ -105,15 +136,18 @@ public:
     clMark *GetNext(int Position,int Type=0xFF, int Mask=0xFF);
     clMark *GetFirst()
     {
-        return first;
+        return count ? marks[0] : NULL;
     }
     clMark *GetLast()
     {
-        return last;
+        return count ? marks[count-1] : NULL;
     }
+    clMark *GetNeighbour(clMark *Mark, int Direction);
     bool Backup(const char *Directory, bool isTS);
     bool Load(const char *Directory, double FrameRate, bool isTS);
     bool Save(const char *Directory, double FrameRate, bool isTS, bool Force=false);
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
 #define IERR_NOTFOUND 1
 #define IERR_TOOSHORT 2
 #define IERR_SEEK 3
@@ -122,9 +156,20 @@ public:
     bool CheckIndex(const char *Directory, bool isTS, int *FrameCnt, int *IndexError);
     bool ReadIndex(const char *Directory, bool isTS, int FrameNumber, int Range, int *Number,
                    off_t *Offset, int *Frame, int *iFrames);
+    bool ReadIndexIFrame(const char *Directory, bool isTS, int FrameNumber, int *Number, off_t *Offset);
+    bool ReadIndexIFrameBefore(const char *Directory, bool isTS, int FrameNumber, int *IFrame,
+                               int *Number, off_t *Offset);
+    bool ReadIndexIFrameAfter(const char *Directory, bool isTS, int FrameNumber, int *IFrame,
+                              int *Number=NULL, off_t *Offset=NULL);
+    int ReadIndexFileStart(const char *Directory, bool isTS, int Number);
+    int ReadIndexLastFile(const char *Directory, bool isTS);
+    void SetIndexSync(bool Sync)
+    {
+        indexsync=Sync;
+    }
     void WriteIndex(const char *Directory, bool isTS, uint64_t Offset,
                     int FrameType, int Number);
-    void CloseIndex(const char *Directory, bool isTS);
+    bool CloseIndex(const char *Directory, bool isTS);
     void RemoveGeneratedIndex(const char *Directory,bool isTS);
 };
 
@@ -0,0 +1,247 @@
+/*
+ * normalize.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "normalize.h"
+#include "video.h"
+#include "framecache.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+// --- row conversion, Count pixels from every SrcStep'th sample
+
+static void narrow_c(const uchar *Src, int SrcStep, uchar *Dst, int Count, int Bytes, int Shift)
+{
+    if (Bytes==1)
+    {
+        for (int i=0; i<Count; i++) Dst[i]=Src[i*SrcStep];
+    }
+    else
+    {
+        const uint16_t *s=(const uint16_t *) Src;
+        for (int i=0; i<Count; i++)
+        {
+            int v=s[i*SrcStep]>>Shift;
+            Dst[i]=(v>255) ? 255 : v;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+static int narrow16_sse2(const uint16_t *Src, uchar *Dst, int Count, int Shift)
+{
+    // 16 bit samples to 8 bit, packus saturates out of range values
+    const __m128i shift=_mm_cvtsi32_si128(Shift);
+    int i=0;
+    for (; i+16<=Count; i+=16)
+    {
+        __m128i a=_mm_srl_epi16(_mm_loadu_si128((const __m128i *) (Src+i)),shift);
+        __m128i b=_mm_srl_epi16(_mm_loadu_si128((const __m128i *) (Src+i+8)),shift);
+        _mm_storeu_si128((__m128i *) (Dst+i),_mm_packus_epi16(a,b));
+    }
+    return i;
+}
+
+static int decimate8_sse2(const uchar *Src, uchar *Dst, int Count)
+{
+    // every second byte, the odd ones are masked out
+    const __m128i even=_mm_set1_epi16(0x00FF);
+    int i=0;
+    for (; i+16<=Count; i+=16)
+    {
+        __m128i a=_mm_and_si128(_mm_loadu_si128((const __m128i *) (Src+2*i)),even);
+        __m128i b=_mm_and_si128(_mm_loadu_si128((const __m128i *) (Src+2*i+16)),even);
+        _mm_storeu_si128((__m128i *) (Dst+i),_mm_packus_epi16(a,b));
+    }
+    return i;
+}
+
+static int decimate16_sse2(const uint16_t *Src, uchar *Dst, int Count, int Shift)
+{
+    // every second 16 bit sample, shifted in 32 bit lanes
+    const __m128i even=_mm_set1_epi32(0x0000FFFF);
+    const __m128i shift=_mm_cvtsi32_si128(Shift);
+    int i=0;
+    for (; i+16<=Count; i+=16)
+    {
+        const __m128i *s=(const __m128i *) (Src+2*i);
+        __m128i a=_mm_srl_epi32(_mm_and_si128(_mm_loadu_si128(s),even),shift);
+        __m128i b=_mm_srl_epi32(_mm_and_si128(_mm_loadu_si128(s+1),even),shift);
+        __m128i c=_mm_srl_epi32(_mm_and_si128(_mm_loadu_si128(s+2),even),shift);
+        __m128i d=_mm_srl_epi32(_mm_and_si128(_mm_loadu_si128(s+3),even),shift);
+        _mm_storeu_si128((__m128i *) (Dst+i),_mm_packus_epi16(_mm_packs_epi32(a,b),
+                         _mm_packs_epi32(c,d)));
+    }
+    return i;
+}
+#endif
+
+static void narrow(const uchar *Src, int SrcStep, uchar *Dst, int Count, int Bytes, int Shift)
+{
+    if ((Bytes==1) && (SrcStep==1))
+    {
+        memcpy(Dst,Src,Count);
+        return;
+    }
+#if defined(__SSE2__)
+    int done=0;
+    if (Bytes==1)
+    {
+        done=decimate8_sse2(Src,Dst,Count);
+    }
+    else
+    {
+        if (SrcStep==1) done=narrow16_sse2((const uint16_t *) Src,Dst,Count,Shift);
+        if (SrcStep==2) done=decimate16_sse2((const uint16_t *) Src,Dst,Count,Shift);
+    }
+    Src+=done*SrcStep*Bytes;
+    Dst+=done;
+    Count-=done;
+#endif
+    narrow_c(Src,SrcStep,Dst,Count,Bytes,Shift);
+}
+
+// --- cMarkAdNormalize
+
+cMarkAdNormalize::cMarkAdNormalize()
+{
+    for (int i=0; i<3; i++)
+    {
+        plane[i]=NULL;
+        linesize[i]=0;
+    }
+    width=height=0;
+    memset(&format,0,sizeof(format));
+}
+
+cMarkAdNormalize::~cMarkAdNormalize()
+{
+    for (int i=0; i<3; i++)
+    {
+        if (plane[i]) free(plane[i]);
+    }
+}
+
+bool cMarkAdNormalize::alloc(int Width, int Height)
+{
+    if ((Width==width) && (Height==height) && (plane[0])) return true;
+    for (int i=0; i<3; i++)
+    {
+        if (plane[i]) free(plane[i]);
+        plane[i]=NULL;
+    }
+    width=height=0;
+    // linesize rounded up for the simd stores
+    linesize[0]=(Width+15) & ~15;
+    linesize[1]=linesize[2]=(((Width+1)/2)+15) & ~15;
+    plane[0]=(uchar *) calloc(linesize[0],Height);
+    plane[1]=(uchar *) calloc(linesize[1],(Height+1)/2);
+    plane[2]=(uchar *) calloc(linesize[2],(Height+1)/2);
+    if ((!plane[0]) || (!plane[1]) || (!plane[2]))
+    {
+        esyslog("out of memory");
+        return false;
+    }
+    width=Width;
+    height=Height;
+    return true;
+}
+
+void cMarkAdNormalize::convert(int Plane, int X, int Y, int Width, int Height, int Step)
+{
+    // X, Y, Width and Height in pixels of the 4:2:0 plane, only every
+    // Step'th row. Whole rows are faster than single pixels with simd.
+    int pw=Plane ? (width+1)/2 : width;
+    int ph=Plane ? (height+1)/2 : height;
+    if (X<0) X=0;
+    if (Y<0) Y=0;
+    if (X+Width>pw) Width=pw-X;
+    if (Y+Height>ph) Height=ph-Y;
+    if ((Width<=0) || (Height<=0)) return;
+
+    int sx=1,sy=1;
+    if (Plane)
+    {
+        // position in the source chroma plane
+        sx=2>>format.ShiftX;
+        sy=2>>format.ShiftY;
+    }
+    int shift=format.Depth-8;
+    if (shift<0) shift=0;
+    for (int y=Y; y<Y+Height; y+=Step)
+    {
+        const uchar *s=src[Plane]+(y*sy)*srclinesize[Plane]+X*sx*format.Bytes;
+        uchar *d=plane[Plane]+y*linesize[Plane]+X;
+        narrow(s,sx,d,Width,format.Bytes,shift);
+    }
+}
+
+void cMarkAdNormalize::convertLuma(int X, int Y, int Width, int Height)
+{
+    // area of luma and the matching chroma
+    convert(0,X,Y,Width,Height);
+    convert(1,X/2,Y/2,(Width+1)/2,(Height+1)/2);
+    convert(2,X/2,Y/2,(Width+1)/2,(Height+1)/2);
+}
+
+bool cMarkAdNormalize::Process(MarkAdContext *maContext, const MarkAdPixelFormat *Format,
+                               uchar **Data, int *Linesize, int Width, int Height)
+{
+    if ((!maContext) || (!Format) || (!Data) || (!Linesize)) return false;
+    if ((Width<=0) || (Height<=0)) return false;
+    if ((!Data[0]) || (!Data[1]) || (!Data[2])) return false;
+    if ((Format->Bytes<1) || (Format->Bytes>2)) return false;
+    if (!alloc(Width,Height)) return false;
+    format=*Format;
+    for (int i=0; i<3; i++)
+    {
+        src[i]=Data[i];
+        srclinesize[i]=Linesize[i];
+    }
+
+    // logo corners, mask sizes are limited to LOGO_MAXWIDTH x LOGO_MAXHEIGHT
+    int lw=LOGO_MAXWIDTH,lh=LOGO_MAXHEIGHT;
+    convertLuma(0,0,lw,lh);
+    convertLuma(Width-lw,0,lw,lh);
+    convertLuma(0,Height-lh,lw,lh);
+    convertLuma(Width-lw,Height-lh,lw,lh);
+
+    // border strips, luma only
+    convert(0,0,HBORDER_OFFSET,Width,HBORDER_HEIGHT);
+    convert(0,0,Height-HBORDER_OFFSET-HBORDER_HEIGHT,Width,HBORDER_HEIGHT);
+    convert(0,VBORDER_OFFSET,VBORDER_MARGIN,VBORDER_WIDTH,Height-2*VBORDER_MARGIN);
+    convert(0,Width-VBORDER_OFFSET-VBORDER_WIDTH,VBORDER_MARGIN,VBORDER_WIDTH,
+            Height-2*VBORDER_MARGIN);
+
+    // grid of the frame cache (overlap detection)
+    int shift=0;
+    while ((Width>>shift)>FRAMECACHE_WIDTH) shift++;
+    convert(0,0,0,Width,Height,1<<shift);
+
+    // rows of the separator frame detector, if the grid misses them
+    if (BLACKFRAME_STEP % (1<<shift)) convert(0,0,0,Width,Height,BLACKFRAME_STEP);
+
+    for (int i=0; i<3; i++)
+    {
+        maContext->Video.Data.Plane[i]=plane[i];
+        maContext->Video.Data.PlaneLinesize[i]=linesize[i];
+    }
+    maContext->Video.Data.Plane[3]=NULL;
+    maContext->Video.Data.PlaneLinesize[3]=0;
+    maContext->Video.Data.Valid=true;
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+ * normalize.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __normalize_h_
+#define __normalize_h_
+
+#include "global.h"
+
+// planar yuv format of a decoded frame
+typedef struct MarkAdPixelFormat
+{
+    int Bytes;  // per sample, 1 or 2 (little endian)
+    int Depth;  // bits per sample
+    int ShiftX; // chroma subsampling, 1 for 4:2:x, 0 for 4:4:4
+    int ShiftY; // 1 for 4:2:0
+} MarkAdPixelFormat;
+
+// --- cMarkAdNormalize
+// 8 bit 4:2:0 view of frames with a higher bit depth or another
+// chroma layout. Only the areas read by the detectors are converted:
+// the logo corners, the border strips, the rows of the separator
+// frame detector and the grid of the frame cache, the rest of the
+// planes is undefined.
+class cMarkAdNormalize
+{
+private:
+    uchar *plane[3];
+    int linesize[3];
+    int width;
+    int height;
+    const uchar *src[3];
+    int srclinesize[3];
+    MarkAdPixelFormat format;
+    bool alloc(int Width, int Height);
+    void convert(int Plane, int X, int Y, int Width, int Height, int Step=1);
+    void convertLuma(int X, int Y, int Width, int Height);
+public:
+    cMarkAdNormalize();
+    ~cMarkAdNormalize();
+    bool Process(MarkAdContext *maContext, const MarkAdPixelFormat *Format,
+                 uchar **Data, int *Linesize, int Width, int Height);
+};
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * profile.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "profile.h"
+#include "trace.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+struct cMarkAdProfile::counters *cMarkAdProfile::list=NULL;
+__thread struct cMarkAdProfile::counters *cMarkAdProfile::local=NULL;
+
+static int perfopen(unsigned int Type, unsigned long long Config, int Group)
+{
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=Type;
+    attr.config=Config;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+    attr.read_format=PERF_FORMAT_GROUP;
+    // the calling thread on any cpu
+    return (int) syscall(SYS_perf_event_open,&attr,0,-1,Group,0);
+}
+
+bool cMarkAdProfile::Start()
+{
+    cMarkAdTrace::Profile(true);
+    return true;
+}
+
+struct cMarkAdProfile::counters *cMarkAdProfile::attach()
+{
+    struct counters *cnt=(struct counters *) calloc(1,sizeof(struct counters));
+    if (!cnt) return NULL;
+    cnt->tid=(pid_t) syscall(SYS_gettid);
+
+    static const struct
+    {
+        unsigned int type;
+        unsigned long long config;
+    } events[cMAX]=
+    {
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
+    // task clock as leader, it is always there
+    cnt->leader=-1;
+    for (int i=0; i<cMAX; i++)
+    {
+        cnt->fd[i]=perfopen(events[i].type,events[i].config,cnt->leader);
+        if (cnt->fd[i]==-1) continue;
+        if (cnt->leader==-1) cnt->leader=cnt->fd[i];
+        cnt->kind[cnt->nr++]=i;
+    }
+    if (cnt->leader==-1) dsyslog("profile: no counters for thread %i",(int) cnt->tid);
+
+    do
+    {
+        cnt->next=list;
+    }
+    while (!__sync_bool_compare_and_swap(&list,cnt->next,cnt));
+    return cnt;
+}
+
+bool cMarkAdProfile::sample(struct counters *Cnt, uint64_t *Wall, uint64_t *Value)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    *Wall=(uint64_t) now.tv_sec*1000000000+now.tv_nsec;
+    memset(Value,0,cMAX*sizeof(uint64_t));
+    if (Cnt->leader==-1) return true;
+
+    uint64_t buf[1+cMAX];
+    if (read(Cnt->leader,buf,sizeof(buf))<(ssize_t) sizeof(uint64_t)) return false;
+    for (int i=0; (i<(int) buf[0]) && (i<Cnt->nr); i++) Value[Cnt->kind[i]]=buf[1+i];
+    return true;
+}
+
+struct cMarkAdProfile::stage *cMarkAdProfile::find(struct stage *Stages, int *Count, const char *Name)
+{
+    // the names are literals, the same name may be at different
+    // addresses in different files
+    for (int i=0; i<*Count; i++)
+    {
+        if ((Stages[i].name==Name) || (!strcmp(Stages[i].name,Name))) return &Stages[i];
+    }
+    if (*Count>=PROFILE_MAXSTAGES) return NULL;
+    struct stage *st=&Stages[(*Count)++];
+    memset(st,0,sizeof(*st));
+    st->name=Name;
+    return st;
+}
+
+void cMarkAdProfile::Add(char Phase, const char *Name)
+{
+    if (Phase=='i') return;
+    if (!local) local=attach();
+    struct counters *cnt=local;
+    if (!cnt) return;
+
+    if (Phase=='B')
+    {
+        if (cnt->depth>=PROFILE_MAXDEPTH) return;
+        struct frame *fr=&cnt->stack[cnt->depth++];
+        fr->name=Name;
+        sample(cnt,&fr->wall,fr->value);
+        return;
+    }
+
+    if (!cnt->depth) return;
+    struct frame *fr=&cnt->stack[cnt->depth-1];
+    if ((fr->name!=Name) && (strcmp(fr->name,Name))) return;
+    cnt->depth--;
+    uint64_t wall,value[cMAX];
+    if (!sample(cnt,&wall,value)) return;
+    struct stage *st=find(cnt->stages,&cnt->stagecnt,Name);
+    if (!st) return;
+    st->calls++;
+    st->wall+=wall-fr->wall;
+    for (int i=0; i<cMAX; i++) st->value[i]+=value[i]-fr->value[i];
+}
+
+void cMarkAdProfile::Stop()
+{
+    cMarkAdTrace::Profile(false);
+    if (!list) return;
+
+    // all threads together
+    struct stage total[PROFILE_MAXSTAGES];
+    int count=0;
+    bool have[cMAX];
+    memset(have,0,sizeof(have));
+    for (struct counters *cnt=list; cnt; cnt=cnt->next)
+    {
+        for (int i=0; i<cnt->nr; i++) have[cnt->kind[i]]=true;
+        for (int s=0; s<cnt->stagecnt; s++)
+        {
+            struct stage *st=find(total,&count,cnt->stages[s].name);
+            if (!st) continue;
+            st->calls+=cnt->stages[s].calls;
+            st->wall+=cnt->stages[s].wall;
+            for (int i=0; i<cMAX; i++) st->value[i]+=cnt->stages[s].value[i];
+        }
+    }
+
+    if (!have[cCYCLES]) isyslog("profile: no hardware counters, only times");
+    isyslog("profile: %-16s %9s %10s %10s %6s %6s %7s","stage","calls","wall ms","cpu ms",
+            "IPC","MPKI","brmiss%");
+    // highest cpu time first
+    bool done[PROFILE_MAXSTAGES];
+    memset(done,0,sizeof(done));
+    for (int n=0; n<count; n++)
+    {
+        int best=-1;
+        for (int s=0; s<count; s++)
+        {
+            if (done[s]) continue;
+            if ((best==-1) || (total[s].value[cTASKCLOCK]>total[best].value[cTASKCLOCK]) ||
+                    ((total[s].value[cTASKCLOCK]==total[best].value[cTASKCLOCK]) &&
+                     (total[s].wall>total[best].wall))) best=s;
+        }
+        done[best]=true;
+        struct stage *st=&total[best];
+        uint64_t *v=st->value;
+
+        char cpu[16]="-",ipc[16]="-",mpki[16]="-",brmiss[16]="-";
+        if (have[cTASKCLOCK]) snprintf(cpu,sizeof(cpu),"%.1f",v[cTASKCLOCK]/1e6);
+        if ((have[cCYCLES]) && (have[cINSTRUCTIONS]) && (v[cCYCLES]))
+            snprintf(ipc,sizeof(ipc),"%.2f",(double) v[cINSTRUCTIONS]/v[cCYCLES]);
+        // cache misses per 1000 instructions
+        if ((have[cCACHEMISSES]) && (have[cINSTRUCTIONS]) && (v[cINSTRUCTIONS]))
+            snprintf(mpki,sizeof(mpki),"%.2f",v[cCACHEMISSES]*1000.0/v[cINSTRUCTIONS]);
+        if ((have[cBRANCHMISSES]) && (have[cBRANCHES]) && (v[cBRANCHES]))
+            snprintf(brmiss,sizeof(brmiss),"%.2f",v[cBRANCHMISSES]*100.0/v[cBRANCHES]);
+        isyslog("profile: %-16s %9llu %10.1f %10s %6s %6s %7s",st->name,
+                (unsigned long long) st->calls,st->wall/1e6,cpu,ipc,mpki,brmiss);
+    }
+
+    while (list)
+    {
+        struct counters *next=list->next;
+        for (int i=0; i<cMAX; i++)
+        {
+            if (list->fd[i]!=-1) close(list->fd[i]);
+        }
+        free(list);
+        list=next;
+    }
+    local=NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * profile.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __profile_h_
+#define __profile_h_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PROFILE_MAXSTAGES 32
+#define PROFILE_MAXDEPTH 8
+
+// --- cMarkAdProfile
+// counts cpu time, cycles, instructions, cache and branch misses of
+// the stages marked with TRACE_BEGIN/TRACE_END (see trace.h) with
+// perf_event_open, every thread with its own counters. Nested
+// stages are included in the outer ones. Hardware counters which
+// can't be opened (no PMU in virtual machines) are left out.
+class cMarkAdProfile
+{
+public:
+    enum { cTASKCLOCK, cCYCLES, cINSTRUCTIONS, cCACHEMISSES, cBRANCHES, cBRANCHMISSES, cMAX };
+private:
+    struct stage
+    {
+        const char *name;
+        uint64_t calls;
+        uint64_t wall;         // nanoseconds
+        uint64_t value[cMAX];
+    };
+    struct frame
+    {
+        const char *name;
+        uint64_t wall;
+        uint64_t value[cMAX];
+    };
+    struct counters
+    {
+        pid_t tid;
+        int fd[cMAX];          // -1 not available
+        int leader;
+        int nr;                // counters in the group
+        int kind[cMAX];        // counter of each value in the group
+        struct frame stack[PROFILE_MAXDEPTH];
+        int depth;
+        struct stage stages[PROFILE_MAXSTAGES];
+        int stagecnt;
+        struct counters *next;
+    };
+    static struct counters *list;
+    static __thread struct counters *local;
+    static struct counters *attach();
+    static bool sample(struct counters *Cnt, uint64_t *Wall, uint64_t *Value);
+    static struct stage *find(struct stage *Stages, int *Count, const char *Name);
+public:
+    static bool Start();
+    static void Stop();
+    static void Add(char Phase, const char *Name);
+};
+
+#endif
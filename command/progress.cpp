@@ -0,0 +1,160 @@
+/*
+ * progress.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "progress.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+cMarkAdProgress::cMarkAdProgress(const char *Directory)
+{
+    rec=NULL;
+    last=passstart=0;
+    lastpass=0;
+    lastframe=0;
+    lastbytes=0;
+    if (asprintf(&filename,"%s/%s",Directory,PROGRESS_FILE)==-1) filename=NULL;
+}
+
+cMarkAdProgress::~cMarkAdProgress()
+{
+    if (rec)
+    {
+        // readers still having the file mapped see that we're gone
+        begin();
+        rec->Pass=-1;
+        rec->Eta=-1;
+        rec->Updated=(int64_t) time(NULL);
+        end();
+        munmap(rec,sizeof(*rec));
+        if (filename) unlink(filename);
+    }
+    if (filename) free(filename);
+}
+
+void cMarkAdProgress::begin()
+{
+    rec->Seq++;
+    __sync_synchronize();
+}
+
+void cMarkAdProgress::end()
+{
+    __sync_synchronize();
+    rec->Seq++;
+}
+
+bool cMarkAdProgress::Open()
+{
+    if (rec) return true;
+    if (!filename) return false;
+
+    // the file is complete before it's visible under its name,
+    // readers never map a short file
+    char *tmpname;
+    if (asprintf(&tmpname,"%s.tmp",filename)==-1) return false;
+    int fd=open(tmpname,O_RDWR|O_CREAT|O_TRUNC,0644);
+    if (fd==-1)
+    {
+        dsyslog("cannot create %s (%i)",tmpname,errno);
+        free(tmpname);
+        return false;
+    }
+    bool ok=(ftruncate(fd,sizeof(MarkAdProgress))==0);
+    void *map=MAP_FAILED;
+    if (ok) map=mmap(NULL,sizeof(MarkAdProgress),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (map==MAP_FAILED)
+    {
+        unlink(tmpname);
+        free(tmpname);
+        return false;
+    }
+    rec=(MarkAdProgress *) map;
+    memset(rec,0,sizeof(*rec));
+    rec->Magic=PROGRESS_MAGIC;
+    rec->Version=PROGRESS_VERSION;
+    rec->Pid=(int) getpid();
+    rec->Eta=-1;
+    rec->Updated=(int64_t) time(NULL);
+    if (rename(tmpname,filename)==-1)
+    {
+        munmap(rec,sizeof(*rec));
+        rec=NULL;
+        unlink(tmpname);
+    }
+    free(tmpname);
+    return (rec!=NULL);
+}
+
+void cMarkAdProgress::Update(int Pass, int File, int Frame, int Percent, uint64_t Bytes)
+{
+    if (!rec) return;
+    time_t now=time(NULL);
+    if (Pass!=lastpass)
+    {
+        lastpass=Pass;
+        passstart=last=now;
+        lastframe=Frame;
+        lastbytes=Bytes;
+        begin();
+        rec->Pass=Pass;
+        rec->FramesPerSecond=0;
+        rec->KBytesPerSecond=0;
+        rec->Eta=-1;
+        end();
+    }
+    // rates once per second, the rest is cheap
+    if (now==last)
+    {
+        if ((rec->Frame==Frame) && (rec->Percent==Percent)) return;
+        begin();
+        rec->File=File;
+        rec->Frame=Frame;
+        rec->Percent=Percent;
+        end();
+        return;
+    }
+
+    int secs=(int) (now-last);
+    int fps=(Frame-lastframe)/secs;
+    if (fps<0) fps=0;
+    int kbps=(int) ((Bytes-lastbytes)/1024/secs);
+    int eta=-1;
+    if ((Percent>0) && (Percent<100))
+    {
+        eta=(int) (((long long) (now-passstart)*(100-Percent))/Percent);
+    }
+    else if (Percent>=100)
+    {
+        eta=0;
+    }
+
+    begin();
+    rec->File=File;
+    rec->Frame=Frame;
+    rec->Percent=Percent;
+    rec->FramesPerSecond=fps;
+    rec->KBytesPerSecond=kbps;
+    rec->Eta=eta;
+    rec->Updated=(int64_t) now;
+    end();
+
+    last=now;
+    lastframe=Frame;
+    lastbytes=Bytes;
+}
@@ -0,0 +1,38 @@
+/*
+ * progress.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __progress_h_
+#define __progress_h_
+
+#include <time.h>
+#include <stdint.h>
+
+#include "progressrec.h"
+
+// --- cMarkAdProgress
+// publishes the state of markad in an mmapped file in the recording
+// directory, so it can be shown without asking markad
+class cMarkAdProgress
+{
+private:
+    char *filename;
+    MarkAdProgress *rec;
+    time_t last;
+    time_t passstart;
+    int lastpass;
+    int lastframe;
+    uint64_t lastbytes;
+    void begin();
+    void end();
+public:
+    cMarkAdProgress(const char *Directory);
+    ~cMarkAdProgress();
+    bool Open();
+    void Update(int Pass, int File, int Frame, int Percent, uint64_t Bytes);
+};
+
+#endif
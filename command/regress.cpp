@@ -0,0 +1,786 @@
+/*
+ * regress.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "global.h"
+#include "marks.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+#define REGRESS_MARKFILE "marks.regress" // marks written by markad, the reference stays
+#define REGRESS_MAXDEPTH 4
+#define REGRESS_MAXARGS 32
+
+// markad-regress runs markad on every recording below a directory
+// which has a reference marks file and compares the marks
+
+int SysLogLevel=1;
+__thread int SysLogLevelJob=0;
+
+void syslog_with_tid(int priority, const char *format, ...)
+{
+    (void) priority;
+    va_list ap;
+    va_start(ap,format);
+    vfprintf(stderr,format,ap);
+    va_end(ap);
+    fputc('\n',stderr);
+}
+
+typedef struct result
+{
+    char *Directory;
+    int Status;        // exit status of markad, -1 not started
+    int RefCount;      // marks in the reference
+    int Count;         // marks found
+    int Matched;
+    int Missed;        // reference marks without a mark found
+    int Extra;         // marks found without a reference mark
+    int StartCount;
+    double StartDev;   // sum of the absolute deviations in seconds
+    double StartMax;
+    int StopCount;
+    double StopDev;
+    double StopMax;
+    double Wall;       // seconds
+    double Hours;      // length of the recording
+    long RSS;          // peak resident set size in kB
+} result;
+
+static struct
+{
+    const char *markad;
+    char *args[REGRESS_MAXARGS];
+    int argcnt;
+    double tolerance;
+    const char *json;
+    bool verbose;
+} config;
+
+static result *results=NULL;
+static int resultcnt=0;
+static int resultmax=0;
+
+// --- recordings
+
+static bool isRecording(const char *Directory, bool *isTS)
+{
+    char *buf=NULL;
+    struct stat st;
+    bool ret=false;
+    for (int ts=1; ts>=0; ts--)
+    {
+        if (asprintf(&buf,"%s/%s",Directory,ts ? "marks" : "marks.vdr")==-1) return false;
+        bool marks=(stat(buf,&st)==0);
+        free(buf);
+        if (asprintf(&buf,"%s/%s",Directory,ts ? "index" : "index.vdr")==-1) return false;
+        bool index=(stat(buf,&st)==0);
+        free(buf);
+        if ((marks) && (index))
+        {
+            *isTS=(ts==1);
+            ret=true;
+            break;
+        }
+    }
+    return ret;
+}
+
+static double framesPerSecond(const char *Directory, bool isTS)
+{
+    // F line of the info file, VDR before 1.7 only knows 25 fps
+    double fps=25;
+    char *buf=NULL;
+    if (asprintf(&buf,"%s/%s",Directory,isTS ? "info" : "info.vdr")==-1) return fps;
+    FILE *f=fopen(buf,"r");
+    free(buf);
+    if (!f) return fps;
+    char *line=NULL;
+    size_t length;
+    while (getline(&line,&length,f)!=-1)
+    {
+        double val;
+        if ((line[0]=='F') && (sscanf(line+1,"%lf",&val)==1) && (val>0)) fps=val;
+    }
+    if (line) free(line);
+    fclose(f);
+    return fps;
+}
+
+static int frames(const char *Directory, bool isTS)
+{
+    // both index formats have 8 bytes per frame
+    char *buf=NULL;
+    if (asprintf(&buf,"%s/%s",Directory,isTS ? "index" : "index.vdr")==-1) return 0;
+    struct stat st;
+    int ret=(stat(buf,&st)==0) ? (int) (st.st_size/8) : 0;
+    free(buf);
+    return ret;
+}
+
+// --- running markad
+
+static bool runMarkad(const char *Directory, result *Res)
+{
+    char markfile[64];
+    snprintf(markfile,sizeof(markfile),"--markfile=%s",REGRESS_MARKFILE);
+
+    const char *argv[REGRESS_MAXARGS+8];
+    int argc=0;
+    argv[argc++]=config.markad;
+    for (int i=0; i<config.argcnt; i++) argv[argc++]=config.args[i];
+    argv[argc++]=markfile;
+    argv[argc++]="--nopid";
+    argv[argc++]="-";
+    argv[argc++]=Directory;
+    argv[argc]=NULL;
+
+    struct timespec start,end;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    pid_t pid=fork();
+    if (pid==-1)
+    {
+        fprintf(stderr,"cannot fork: %s\n",strerror(errno));
+        return false;
+    }
+    if (!pid)
+    {
+        if (!config.verbose)
+        {
+            int fd=open("/dev/null",O_WRONLY);
+            if (fd!=-1)
+            {
+                dup2(fd,STDOUT_FILENO);
+                dup2(fd,STDERR_FILENO);
+                close(fd);
+            }
+        }
+        execvp(argv[0],(char **) argv);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    memset(&usage,0,sizeof(usage));
+    while (wait4(pid,&status,0,&usage)==-1)
+    {
+        if (errno!=EINTR) return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    Res->Wall=(end.tv_sec-start.tv_sec)+(end.tv_nsec-start.tv_nsec)/1e9;
+    Res->RSS=usage.ru_maxrss;
+    Res->Status=WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+    return (Res->Status==0);
+}
+
+// --- comparing
+
+static void compare(clMarks *Ref, clMarks *Found, double FramesPerSecond, result *Res)
+{
+    // odd marks are starts, even marks stops. Every reference mark
+    // takes the nearest unused mark of the same kind within the
+    // tolerance, the rest are missed and extra marks.
+    int tolerance=(int) (config.tolerance*FramesPerSecond);
+    Res->RefCount=Ref->Count();
+    Res->Count=Found->Count();
+    bool *used=(bool *) calloc(Res->Count ? Res->Count : 1,sizeof(bool));
+    if (!used) return;
+
+    int i=0;
+    for (clMark *r=Ref->GetFirst(); r; r=r->Next(),i++)
+    {
+        int best=-1,bestpos=0,j=0;
+        for (clMark *m=Found->GetFirst(); m; m=m->Next(),j++)
+        {
+            if ((used[j]) || ((j & 1)!=(i & 1))) continue;
+            if (abs(m->position-r->position)>tolerance) continue;
+            if ((best==-1) || (abs(m->position-r->position)<abs(bestpos-r->position)))
+            {
+                best=j;
+                bestpos=m->position;
+            }
+        }
+        if (best==-1)
+        {
+            Res->Missed++;
+            continue;
+        }
+        used[best]=true;
+        Res->Matched++;
+        double dev=fabs(bestpos-r->position)/FramesPerSecond;
+        if (i & 1)
+        {
+            Res->StopCount++;
+            Res->StopDev+=dev;
+            if (dev>Res->StopMax) Res->StopMax=dev;
+        }
+        else
+        {
+            Res->StartCount++;
+            Res->StartDev+=dev;
+            if (dev>Res->StartMax) Res->StartMax=dev;
+        }
+    }
+    Res->Extra=Res->Count-Res->Matched;
+    free(used);
+}
+
+static result *newResult(const char *Directory)
+{
+    if (resultcnt==resultmax)
+    {
+        int nmax=resultmax ? resultmax*2 : 16;
+        result *nres=(result *) realloc(results,nmax*sizeof(result));
+        if (!nres) return NULL;
+        results=nres;
+        resultmax=nmax;
+    }
+    result *res=&results[resultcnt++];
+    memset(res,0,sizeof(*res));
+    res->Directory=strdup(Directory);
+    res->Status=-1;
+    return res;
+}
+
+static void processRecording(const char *Directory, bool isTS)
+{
+    result *res=newResult(Directory);
+    if (!res) return;
+    double fps=framesPerSecond(Directory,isTS);
+    res->Hours=frames(Directory,isTS)/fps/3600;
+
+    clMarks ref,found;
+    ref.SetFileName("marks");
+    found.SetFileName(REGRESS_MARKFILE);
+    ref.Load(Directory,fps,isTS);
+
+    char *buf=NULL;
+    if (asprintf(&buf,"%s/%s%s",Directory,REGRESS_MARKFILE,isTS ? "" : ".vdr")!=-1)
+    {
+        unlink(buf);
+        free(buf);
+    }
+    if (config.verbose) printf("%s\n",Directory);
+    runMarkad(Directory,res);
+    found.Load(Directory,fps,isTS);
+    compare(&ref,&found,fps,res);
+}
+
+static void scan(const char *Directory, int Depth)
+{
+    bool isTS;
+    if (isRecording(Directory,&isTS))
+    {
+        processRecording(Directory,isTS);
+        return;
+    }
+    if (Depth>=REGRESS_MAXDEPTH) return;
+
+    struct dirent **names;
+    int n=scandir(Directory,&names,NULL,alphasort);
+    if (n<0) return;
+    for (int i=0; i<n; i++)
+    {
+        if (names[i]->d_name[0]!='.')
+        {
+            char *buf=NULL;
+            struct stat st;
+            if ((asprintf(&buf,"%s/%s",Directory,names[i]->d_name)!=-1) &&
+                    (stat(buf,&st)==0) && (S_ISDIR(st.st_mode))) scan(buf,Depth+1);
+            if (buf) free(buf);
+        }
+        free(names[i]);
+    }
+    free(names);
+}
+
+// --- output
+
+static double mean(double Sum, int Count)
+{
+    return Count ? Sum/Count : 0;
+}
+
+static double secsPerHour(result *Res)
+{
+    return (Res->Hours>0) ? Res->Wall/Res->Hours : 0;
+}
+
+static void printTable()
+{
+    printf("%-32s %4s %5s %5s %5s %6s %6s %6s %6s %8s %7s %4s\n","recording","ref","found",
+           "miss","extra","start","max","stop","max","s/hour","rss MB","exit");
+    result total;
+    memset(&total,0,sizeof(total));
+    for (int i=0; i<resultcnt; i++)
+    {
+        result *r=&results[i];
+        const char *name=r->Directory;
+        if (strlen(name)>32) name+=strlen(name)-32;
+        printf("%-32s %4i %5i %5i %5i %6.2f %6.2f %6.2f %6.2f %8.1f %7.1f %4i\n",name,
+               r->RefCount,r->Count,r->Missed,r->Extra,mean(r->StartDev,r->StartCount),r->StartMax,
+               mean(r->StopDev,r->StopCount),r->StopMax,secsPerHour(r),r->RSS/1024.0,r->Status);
+        total.RefCount+=r->RefCount;
+        total.Count+=r->Count;
+        total.Missed+=r->Missed;
+        total.Extra+=r->Extra;
+        total.StartCount+=r->StartCount;
+        total.StartDev+=r->StartDev;
+        if (r->StartMax>total.StartMax) total.StartMax=r->StartMax;
+        total.StopCount+=r->StopCount;
+        total.StopDev+=r->StopDev;
+        if (r->StopMax>total.StopMax) total.StopMax=r->StopMax;
+        total.Wall+=r->Wall;
+        total.Hours+=r->Hours;
+        if (r->RSS>total.RSS) total.RSS=r->RSS;
+    }
+    printf("%-32s %4i %5i %5i %5i %6.2f %6.2f %6.2f %6.2f %8.1f %7.1f\n","total",
+           total.RefCount,total.Count,total.Missed,total.Extra,mean(total.StartDev,total.StartCount),
+           total.StartMax,mean(total.StopDev,total.StopCount),total.StopMax,secsPerHour(&total),
+           total.RSS/1024.0);
+}
+
+static void jsonString(FILE *F, const char *S)
+{
+    fputc('"',F);
+    for (; *S; S++)
+    {
+        if ((*S=='"') || (*S=='\\')) fputc('\\',F);
+        if ((unsigned char) *S<0x20)
+        {
+            fprintf(F,"\\u%04x",*S);
+            continue;
+        }
+        fputc(*S,F);
+    }
+    fputc('"',F);
+}
+
+static bool writeJSON(const char *File)
+{
+    FILE *f=fopen(File,"w");
+    if (!f)
+    {
+        fprintf(stderr,"cannot create %s: %s\n",File,strerror(errno));
+        return false;
+    }
+    fprintf(f,"{\"tolerance\":%g,\"recordings\":[",config.tolerance);
+    for (int i=0; i<resultcnt; i++)
+    {
+        result *r=&results[i];
+        fprintf(f,"%s\n{\"directory\":",i ? "," : "");
+        jsonString(f,r->Directory);
+        fprintf(f,",\"exit\":%i,\"reference\":%i,\"found\":%i,\"matched\":%i,\"missed\":%i,"
+                "\"extra\":%i,\"start_dev_mean\":%.3f,\"start_dev_max\":%.3f,"
+                "\"stop_dev_mean\":%.3f,\"stop_dev_max\":%.3f,\"wall\":%.3f,\"hours\":%.4f,"
+                "\"secs_per_hour\":%.2f,\"peak_rss_kb\":%li}",r->Status,r->RefCount,r->Count,
+                r->Matched,r->Missed,r->Extra,mean(r->StartDev,r->StartCount),r->StartMax,
+                mean(r->StopDev,r->StopCount),r->StopMax,r->Wall,r->Hours,secsPerHour(r),r->RSS);
+    }
+    fprintf(f,"\n]}\n");
+    return (fclose(f)==0);
+}
+
+// --- synthetic recordings
+
+// three files of six minutes, the broadcast is 60-300s, 396-720s
+// and 816-1020s, in between are ads. The seconds are multiples of
+// the gop length, so the marks are on iframes.
+#define SYN_FPS 25
+#define SYN_GOP 12
+#define SYN_FILESECS 360
+#define SYN_FILES 3
+static const int synBroadcast[][2]= { { 60,300 }, { 396,720 }, { 816,1020 } };
+#define SYN_PARTS (int) (sizeof(synBroadcast)/sizeof(synBroadcast[0]))
+
+class cSynthetic
+{
+private:
+    FILE *f;
+    int cc[0x2000];
+    static uint32_t crc32(const uchar *Data, int Len);
+    void ts(int Pid, const uchar *Payload, int Len);
+    void psi(int Pid, int TableId, const uchar *Body, int Len);
+    static int pts(uchar *Dst, int64_t Pts);
+    void pes(int Pid, int StreamId, const uchar *Data, int Len, int64_t Pts);
+    static bool broadcast(int Frame);
+public:
+    cSynthetic()
+    {
+        f=NULL;
+        memset(cc,0,sizeof(cc));
+    }
+    bool Write(const char *Directory, bool Aspect);
+};
+
+uint32_t cSynthetic::crc32(const uchar *Data, int Len)
+{
+    uint32_t crc=0xffffffff;
+    for (int i=0; i<Len; i++)
+    {
+        crc^=(uint32_t) Data[i]<<24;
+        for (int b=0; b<8; b++) crc=(crc & 0x80000000) ? (crc<<1)^0x04c11db7 : crc<<1;
+    }
+    return crc;
+}
+
+void cSynthetic::ts(int Pid, const uchar *Payload, int Len)
+{
+    bool first=true;
+    while ((Len>0) || (first))
+    {
+        uchar pkt[188];
+        int chunk=(Len>184) ? 184 : Len;
+        pkt[0]=0x47;
+        pkt[1]=(first ? 0x40 : 0)|(Pid>>8);
+        pkt[2]=Pid & 0xff;
+        int c=cc[Pid];
+        cc[Pid]=(c+1) & 15;
+        if (chunk<184)
+        {
+            // adaptation field with stuffing
+            int st=184-chunk;
+            pkt[3]=0x30|c;
+            pkt[4]=st-1;
+            if (st>1)
+            {
+                pkt[5]=0;
+                memset(pkt+6,0xff,st-2);
+            }
+        }
+        else
+        {
+            pkt[3]=0x10|c;
+        }
+        memcpy(pkt+188-chunk,Payload,chunk);
+        fwrite(pkt,1,188,f);
+        Payload+=chunk;
+        Len-=chunk;
+        first=false;
+    }
+}
+
+void cSynthetic::psi(int Pid, int TableId, const uchar *Body, int Len)
+{
+    uchar sec[184];
+    memset(sec,0xff,sizeof(sec));
+    sec[0]=0; // pointer field
+    sec[1]=TableId;
+    sec[2]=0xb0|((Len+4)>>8);
+    sec[3]=(Len+4) & 0xff;
+    memcpy(sec+4,Body,Len);
+    uint32_t crc=crc32(sec+1,Len+3);
+    sec[4+Len]=crc>>24;
+    sec[5+Len]=crc>>16;
+    sec[6+Len]=crc>>8;
+    sec[7+Len]=crc;
+    ts(Pid,sec,sizeof(sec));
+}
+
+int cSynthetic::pts(uchar *Dst, int64_t Pts)
+{
+    Dst[0]=0x21|((Pts>>29) & 0xe);
+    Dst[1]=(Pts>>22) & 0xff;
+    Dst[2]=((Pts>>14) & 0xfe)|1;
+    Dst[3]=(Pts>>7) & 0xff;
+    Dst[4]=((Pts<<1) & 0xfe)|1;
+    return 5;
+}
+
+void cSynthetic::pes(int Pid, int StreamId, const uchar *Data, int Len, int64_t Pts)
+{
+    uchar buf[512];
+    int hdr=9+5;
+    if (Len+hdr>(int) sizeof(buf)) return;
+    buf[0]=buf[1]=0;
+    buf[2]=1;
+    buf[3]=StreamId;
+    int plen=(StreamId==0xe0) ? 0 : Len+8;
+    buf[4]=plen>>8;
+    buf[5]=plen & 0xff;
+    buf[6]=0x80;
+    buf[7]=0x80;
+    buf[8]=5;
+    pts(buf+9,Pts);
+    memcpy(buf+hdr,Data,Len);
+    ts(Pid,buf,hdr+Len);
+}
+
+bool cSynthetic::broadcast(int Frame)
+{
+    for (int i=0; i<SYN_PARTS; i++)
+    {
+        if ((Frame>=synBroadcast[i][0]*SYN_FPS) && (Frame<synBroadcast[i][1]*SYN_FPS)) return true;
+    }
+    return false;
+}
+
+bool cSynthetic::Write(const char *Directory, bool Aspect)
+{
+    // Aspect: broadcast in 4:3 between 16:9 ads, otherwise
+    // broadcast with 6 audio channels between stereo ads
+    if ((mkdir(Directory,0755)==-1) && (errno!=EEXIST)) return false;
+    int total=SYN_FILESECS*SYN_FILES*SYN_FPS;
+    uint64_t *index=(uint64_t *) malloc(total*sizeof(uint64_t));
+    if (!index) return false;
+
+    bool ok=true;
+    int fileno=0;
+    int audioms=0;
+    for (int frame=0; (frame<total) && (ok); frame++)
+    {
+        bool iframe=((frame % SYN_GOP)==0);
+        if ((iframe) && (frame>=fileno*SYN_FILESECS*SYN_FPS))
+        {
+            if (f) fclose(f);
+            fileno++;
+            char *buf=NULL;
+            if (asprintf(&buf,"%s/%05i.ts",Directory,fileno)==-1)
+            {
+                ok=false;
+                break;
+            }
+            f=fopen(buf,"w");
+            free(buf);
+            if (!f)
+            {
+                ok=false;
+                break;
+            }
+            static const uchar pat[]= { 0,1,0xc1,0,0,0,1,0xe0,0x20 };
+            static const uchar pmt[]=
+            {
+                0,1,0xc1,0,0,0xe1,0x00,0xf0,0,
+                0x02,0xe1,0x00,0xf0,0,            // mpeg-2 video on pid 0x100
+                0x06,0xe1,0x01,0xf0,3,0x6a,1,0    // ac3 on pid 0x101
+            };
+            psi(0,0,pat,sizeof(pat));
+            psi(0x20,2,pmt,sizeof(pmt));
+        }
+        bool bc=broadcast(frame);
+
+        // sequence header (aspect ratio), picture header and a slice
+        // without real picture data, only the headers are needed
+        uchar es[128];
+        int len=0;
+        if (iframe)
+        {
+            int asp=(Aspect && bc) ? 2 : 3;
+            const uchar seq[]= { 0,0,1,0xb3,720>>4,((720 & 15)<<4)|(576>>8),576 & 255,
+                                 (uchar) ((asp<<4)|3),0xff,0xff,0xe0,0x18,
+                                 0,0,1,0xb5,0x14,0x8a,0,1,0,0,
+                                 0,0,1,0xb8,0,8,0,0
+                               };
+            memcpy(es,seq,sizeof(seq));
+            len=sizeof(seq);
+        }
+        int tr=frame % SYN_GOP;
+        const uchar pic[]= { 0,0,1,0,(uchar) (tr>>2),(uchar) (((tr & 3)<<6)|((iframe ? 1 : 2)<<3)|7),
+                             0xff,0xf8,0,0,1,1
+                           };
+        memcpy(es+len,pic,sizeof(pic));
+        len+=sizeof(pic);
+        for (int i=0; i<60; i++) es[len++]=((frame*7+i) & 0x7f)|0x80;
+
+        index[frame]=(uint64_t) ftell(f)|((uint64_t) (iframe ? 1 : 0)<<47)|((uint64_t) fileno<<48);
+        pes(0x100,0xe0,es,len,(int64_t) frame*3600);
+
+        // ac3 frame every 32ms
+        while (audioms<=(frame+1)*1000/SYN_FPS)
+        {
+            uchar ac3[256];
+            memset(ac3,0,sizeof(ac3));
+            bool surround=(!Aspect) && (broadcast(audioms*SYN_FPS/1000));
+            ac3[0]=0x0b;
+            ac3[1]=0x77;
+            ac3[4]=0x08;
+            ac3[5]=0x40;
+            ac3[6]=surround ? 0xe1 : 0x40;
+            pes(0x101,0xbd,ac3,sizeof(ac3),(int64_t) audioms*90);
+            audioms+=32;
+        }
+        if (ferror(f)) ok=false;
+    }
+    if (f)
+    {
+        if (fclose(f)!=0) ok=false;
+        f=NULL;
+    }
+
+    char *buf=NULL;
+    if ((ok) && (asprintf(&buf,"%s/index",Directory)!=-1))
+    {
+        FILE *idx=fopen(buf,"w");
+        free(buf);
+        if ((!idx) || (fwrite(index,sizeof(uint64_t),total,idx)!=(size_t) total)) ok=false;
+        if ((idx) && (fclose(idx)!=0)) ok=false;
+        // a finished recording, otherwise markad waits for the index to grow
+        struct timeval tv[2];
+        gettimeofday(&tv[0],NULL);
+        tv[0].tv_sec-=3600;
+        tv[1]=tv[0];
+        if ((ok) && (asprintf(&buf,"%s/index",Directory)!=-1))
+        {
+            utimes(buf,tv);
+            free(buf);
+        }
+    }
+    free(index);
+    if (!ok) return false;
+
+    // reference marks, the broadcast starts on the first frame of a
+    // part and ends on the last one
+    clMarks ref;
+    ref.SetFileName("marks");
+    for (int i=0; i<SYN_PARTS; i++)
+    {
+        ref.Add(MT_START,synBroadcast[i][0]*SYN_FPS);
+        ref.Add(MT_STOP,synBroadcast[i][1]*SYN_FPS-1);
+    }
+    return ref.Save(Directory,SYN_FPS,true,true);
+}
+
+static bool synthetic(const char *Directory)
+{
+    if ((mkdir(Directory,0755)==-1) && (errno!=EEXIST))
+    {
+        fprintf(stderr,"cannot create %s: %s\n",Directory,strerror(errno));
+        return false;
+    }
+    static const struct
+    {
+        const char *name;
+        bool aspect;
+    } recs[]= { { "aspect.rec", true }, { "channels.rec", false } };
+    for (unsigned int i=0; i<sizeof(recs)/sizeof(recs[0]); i++)
+    {
+        char *buf=NULL;
+        if (asprintf(&buf,"%s/%s",Directory,recs[i].name)==-1) return false;
+        cSynthetic syn;
+        bool ok=syn.Write(buf,recs[i].aspect);
+        if (!ok) fprintf(stderr,"cannot write %s\n",buf);
+        else printf("wrote %s\n",buf);
+        free(buf);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static int usage()
+{
+    printf("usage: markad-regress [options] <directory>\n"
+           "runs markad on every recording below <directory> with a reference marks\n"
+           "file and compares the marks found (written to " REGRESS_MARKFILE ")\n"
+           "with the reference\n\n"
+           "--markad=<file>    markad binary (default ./markad)\n"
+           "--args=<args>      further arguments for markad, separated by blanks\n"
+           "--tolerance=<s>    max. distance of a mark from the reference mark\n"
+           "                   in seconds (default 60)\n"
+           "--json=<file>      write the results as JSON to <file>\n"
+           "--synthetic        write synthetic recordings with reference marks\n"
+           "                   to <directory> and exit\n"
+           "--verbose          show the output of markad\n\n"
+           "exits with 1 if markad failed on a recording or marks were missed\n"
+           "or extra, 2 on invalid arguments\n");
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    config.markad="./markad";
+    config.tolerance=60;
+    bool bSynthetic=false;
+
+    static struct option long_options[]=
+    {
+        {"markad",1,0,1},
+        {"args",1,0,2},
+        {"tolerance",1,0,3},
+        {"json",1,0,4},
+        {"synthetic",0,0,5},
+        {"verbose",0,0,6},
+        {0,0,0,0}
+    };
+
+    int c;
+    while ((c=getopt_long(argc,argv,"",long_options,NULL))!=-1)
+    {
+        switch (c)
+        {
+        case 1: // --markad
+            config.markad=optarg;
+            break;
+        case 2: // --args
+        {
+            char *args=strdup(optarg);
+            if (!args) return 2;
+            for (char *a=strtok(args," "); a; a=strtok(NULL," "))
+            {
+                if (config.argcnt>=REGRESS_MAXARGS) return usage();
+                config.args[config.argcnt++]=a;
+            }
+            break;
+        }
+        case 3: // --tolerance
+            config.tolerance=atof(optarg);
+            if (config.tolerance<=0) return usage();
+            break;
+        case 4: // --json
+            config.json=optarg;
+            break;
+        case 5: // --synthetic
+            bSynthetic=true;
+            break;
+        case 6: // --verbose
+            config.verbose=true;
+            break;
+        default:
+            return usage();
+        }
+    }
+    if (optind!=argc-1) return usage();
+    const char *dir=argv[optind];
+
+    if (bSynthetic) return synthetic(dir) ? 0 : 1;
+
+    scan(dir,0);
+    if (!resultcnt)
+    {
+        fprintf(stderr,"no recordings with marks found in %s\n",dir);
+        return 1;
+    }
+    printTable();
+    if ((config.json) && (!writeJSON(config.json))) return 1;
+
+    int ret=0;
+    for (int i=0; i<resultcnt; i++)
+    {
+        if ((results[i].Status) || (results[i].Missed) || (results[i].Extra)) ret=1;
+        free(results[i].Directory);
+    }
+    free(results);
+    return ret;
+}
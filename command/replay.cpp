@@ -0,0 +1,134 @@
+/*
+ * replay.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "replay.h"
+#include "y4m.h"
+#include "video.h"
+#include "framecache.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+static double elapsed(const struct timespec *Start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (now.tv_sec-Start->tv_sec)*1000.0+(now.tv_nsec-Start->tv_nsec)/1e6;
+}
+
+cMarkAdReplay::cMarkAdReplay(const MarkAdConfig *Config)
+{
+    config=Config;
+}
+
+const char *cMarkAdReplay::markname(int Type)
+{
+    switch (Type)
+    {
+    case MT_LOGOSTART:
+        return "logo start";
+    case MT_LOGOSTOP:
+        return "logo stop";
+    case MT_HBORDERSTART:
+        return "horiz. borders start";
+    case MT_HBORDERSTOP:
+        return "horiz. borders stop";
+    case MT_VBORDERSTART:
+        return "vert. borders start";
+    case MT_VBORDERSTOP:
+        return "vert. borders stop";
+    case MT_ASPECTSTART:
+        return "aspectratio start";
+    case MT_ASPECTSTOP:
+        return "aspectratio stop";
+    case MT_BLACKSTART:
+        return "separator start";
+    case MT_BLACKSTOP:
+        return "separator stop";
+    default:
+        return "mark";
+    }
+}
+
+int cMarkAdReplay::Process(const char *File)
+{
+    cMarkAdY4M y4m;
+    if (!y4m.Open(File)) return -1;
+
+    MarkAdContext macontext;
+    memset(&macontext,0,sizeof(macontext));
+    macontext.Config=config;
+    if (y4m.Channel()) macontext.Info.ChannelName=strdup(y4m.Channel());
+
+    cMarkAdVideo *video=new cMarkAdVideo(&macontext);
+    // enough for the subsampled luma, see FRAMECACHE_WIDTH
+    cMarkAdFrameCache *framecache=new cMarkAdFrameCache(REPLAY_OVERLAPFRAMES);
+    int overlapframe[REPLAY_OVERLAPFRAMES];
+    int overlapcnt=0;
+
+    int ret=0,marks=0;
+    double ms=0;
+    int fn,fnext,res;
+    while ((res=y4m.Read(&macontext,&fn,&fnext))==1)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        MarkAdMarks *vmarks=video->Process(fn,fnext);
+        ms+=elapsed(&start);
+        if (vmarks)
+        {
+            for (int i=0; i<vmarks->Count; i++)
+            {
+                isyslog("%s (%i)",markname(vmarks->Number[i].Type),vmarks->Number[i].Position);
+                marks++;
+            }
+        }
+        if ((overlapcnt<REPLAY_OVERLAPFRAMES) && (fnext>0) && (framecache->Put(fnext,&macontext)))
+            overlapframe[overlapcnt++]=fnext;
+    }
+    if (res==-1)
+    {
+        esyslog("error reading %s after frame %i",File,y4m.Frames());
+        ret=-1;
+    }
+    int frames=y4m.Frames();
+    isyslog("replayed %i frames, %i marks, detectors %.1f ms (%.0f frames/s)",frames,marks,ms,
+            (ms>0) ? frames*1000.0/ms : 0);
+
+    if (overlapcnt>1)
+    {
+        // the frames before and after an ad are the same sequence
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        MarkAdPos *pos=NULL;
+        for (int i=0; i<overlapcnt; i++)
+            video->ProcessOverlap(framecache->Get(overlapframe[i]),overlapcnt,true,false);
+        for (int i=0; (i<overlapcnt) && (!pos); i++)
+            pos=video->ProcessOverlap(framecache->Get(overlapframe[i]),overlapcnt,false,false);
+        double oms=elapsed(&start);
+        if (pos)
+        {
+            isyslog("overlap of %i frames %i-%i, %.1f ms",overlapcnt,pos->FrameNumberBefore,
+                    pos->FrameNumberAfter,oms);
+        }
+        else
+        {
+            isyslog("no overlap in %i frames, %.1f ms",overlapcnt,oms);
+        }
+    }
+
+    delete framecache;
+    delete video;
+    if (macontext.Info.ChannelName) free(macontext.Info.ChannelName);
+    return ret;
+}
@@ -0,0 +1,30 @@
+/*
+ * replay.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __replay_h_
+#define __replay_h_
+
+#include "global.h"
+
+#define REPLAY_OVERLAPFRAMES 128 // frames for the overlap detection
+
+// --- cMarkAdReplay
+// feeds the frames of a YUV4MPEG2 stream (see y4m.h) into
+// cMarkAdVideo and cMarkAdOverlap without demuxer and decoder, so
+// the detectors can be benchmarked and profiled alone. The marks
+// found and the time spent in the detectors are logged.
+class cMarkAdReplay
+{
+private:
+    const MarkAdConfig *config;
+    static const char *markname(int Type);
+public:
+    cMarkAdReplay(const MarkAdConfig *Config);
+    int Process(const char *File);
+};
+
+#endif
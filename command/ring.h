@@ -0,0 +1 @@
+../ring.h
\ No newline at end of file
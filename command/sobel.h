@@ -0,0 +1,80 @@
+/*
+ * sobel.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __sobel_h_
+#define __sobel_h_
+
+#include <stdlib.h>
+
+#include "global.h"
+
+// Sobel operator on a logo corner of a plane, Shift is the
+// subsampling of the plane. Pixels in the boundary are white in the
+// sobel picture, inside pixels with a gradient magnitude below the
+// cut value are white, others black. Returns the black pixels of the
+// result (sobel plus mask), the intensity is only summed up for luma.
+// Used by cMarkAdLogo and checked against the generic operator by
+// markad-kernels.
+template<int Shift>
+static inline int sobelkernel(const uchar *Src, int Linesize, int Width, int Height,
+                              const uchar *Mask, uchar *Sobel, uchar *Result, int *Intensity)
+{
+    const int boundary=6>>Shift;
+    const int cutval=127>>Shift;
+    int rpixel=0;
+
+    if (!Shift)
+    {
+        int intensity=0;
+        for (int y=0; y<Height; y++)
+        {
+            const uchar *s=Src+y*Linesize;
+            for (int x=0; x<Width; x++) intensity+=s[x];
+        }
+        *Intensity=intensity;
+    }
+
+    for (int y=0; y<Height; y++)
+    {
+        uchar *sobel=Sobel+y*Width;
+        uchar *result=Result+y*Width;
+        const uchar *mask=Mask+y*Width;
+        // the rows and columns in the boundary are outside the convolution
+        int xin=boundary,xout=Width-boundary+1;
+        if ((y<boundary) || (y>Height-boundary)) xin=xout=Width;
+        if (xout>Width) xout=Width;
+
+        for (int x=0; x<xin; x++)
+        {
+            sobel[x]=255;
+            result[x]=mask[x]+255;
+            rpixel+=(result[x]==0);
+        }
+        const uchar *a=Src+(y-1)*Linesize; // above
+        const uchar *c=Src+y*Linesize;
+        const uchar *b=Src+(y+1)*Linesize; // below
+        for (int x=xin; x<xout; x++)
+        {
+            int gy=(b[x-1]+2*b[x]+b[x+1])-(a[x-1]+2*a[x]+a[x+1]);
+            int gx=(a[x-1]+2*c[x-1]+b[x-1])-(a[x+1]+2*c[x+1]+b[x+1]);
+            int sum=abs(gx)+abs(gy);
+            uchar val=(sum>=cutval) ? 0 : 255;
+            sobel[x]=val;
+            result[x]=mask[x]+val;
+            rpixel+=(result[x]==0);
+        }
+        for (int x=xout; x<Width; x++)
+        {
+            sobel[x]=255;
+            result[x]=mask[x]+255;
+            rpixel+=(result[x]==0);
+        }
+    }
+    return rpixel;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * startcode.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "startcode.h"
+
+typedef int (*findstartcode_t)(const uchar *Data, int Len);
+
+static int findstartcode_c(const uchar *Data, int Len)
+{
+    // search for the 0x01 and look back, memchr is vectorized in libc
+    const uchar *p=Data+2;
+    const uchar *end=Data+Len;
+    while (p<end)
+    {
+        p=(const uchar *) memchr(p,1,end-p);
+        if (!p) return -1;
+        if ((!p[-1]) && (!p[-2])) return (p-Data)-2;
+        // the next 0x01 needs two zeros after this one
+        p+=3;
+    }
+    return -1;
+}
+
+#if defined(__SSE2__)
+static int findstartcode_sse2(const uchar *Data, int Len)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i one=_mm_set1_epi8(1);
+    int i=0;
+    for (; i+18<=Len; i+=16)
+    {
+        __m128i b0=_mm_loadu_si128((const __m128i *) (Data+i));
+        __m128i b1=_mm_loadu_si128((const __m128i *) (Data+i+1));
+        __m128i b2=_mm_loadu_si128((const __m128i *) (Data+i+2));
+        __m128i m=_mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0,zero),
+                                              _mm_cmpeq_epi8(b1,zero)),
+                                _mm_cmpeq_epi8(b2,one));
+        int mask=_mm_movemask_epi8(m);
+        if (mask) return i+__builtin_ctz(mask);
+    }
+    if (Len-i<3) return -1;
+    int ret=findstartcode_c(Data+i,Len-i);
+    return (ret==-1) ? -1 : i+ret;
+}
+
+__attribute__ ((target ("avx2")))
+static int findstartcode_avx2(const uchar *Data, int Len)
+{
+    const __m256i zero=_mm256_setzero_si256();
+    const __m256i one=_mm256_set1_epi8(1);
+    int i=0;
+    for (; i+34<=Len; i+=32)
+    {
+        __m256i b0=_mm256_loadu_si256((const __m256i *) (Data+i));
+        __m256i b1=_mm256_loadu_si256((const __m256i *) (Data+i+1));
+        __m256i b2=_mm256_loadu_si256((const __m256i *) (Data+i+2));
+        __m256i m=_mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0,zero),
+                                   _mm256_cmpeq_epi8(b1,zero)),
+                                   _mm256_cmpeq_epi8(b2,one));
+        unsigned int mask=(unsigned int) _mm256_movemask_epi8(m);
+        if (mask) return i+__builtin_ctz(mask);
+    }
+    if (Len-i<3) return -1;
+    int ret=findstartcode_sse2(Data+i,Len-i);
+    return (ret==-1) ? -1 : i+ret;
+}
+
+static findstartcode_t select_findstartcode()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return findstartcode_avx2;
+    return findstartcode_sse2;
+}
+#else
+static findstartcode_t select_findstartcode()
+{
+    return findstartcode_c;
+}
+#endif
+
+static findstartcode_t findstartcode=select_findstartcode();
+
+int FindStartCode(const uchar *Data, int Len)
+{
+    if ((!Data) || (Len<3)) return -1;
+    return findstartcode(Data,Len);
+}
@@ -0,0 +1,17 @@
+/*
+ * startcode.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __startcode_h_
+#define __startcode_h_
+
+#include "global.h"
+
+// returns the offset of the first 0x00 0x00 0x01 sequence within
+// Data[0..Len-1] or -1, uses SSE2/AVX2 if available
+int FindStartCode(const uchar *Data, int Len);
+
+#endif
@@ -118,6 +118,9 @@ bool cMarkAdStreamInfo::FindVideoInfos(MarkAdContext *maContext, uchar *pkt, int
     case MARKAD_PIDTYPE_VIDEO_H262:
         return FindH262VideoInfos(maContext, pkt, len);
         break;
+    case MARKAD_PIDTYPE_VIDEO_H265:
+        return FindH265VideoInfos(maContext, pkt, len);
+        break;
     }
     return false;
 }
@@ -164,10 +167,7 @@ bool cMarkAdStreamInfo::FindH264VideoInfos(MarkAdContext *maContext, uchar *pkt,
 
     if ((nalu==NAL_SLICE) || (nalu==NAL_IDR_SLICE))
     {
-        uint8_t *nal_data=(uint8_t*) alloca(len);
-        if (!nal_data) return false;
-        int nal_len = nalUnescape(nal_data, pkt + 5, len - 5);
-        cBitStream bs(nal_data, nal_len);
+        cBitStream bs(pkt + 5, len - 5, true);
 
         bs.skipUeGolomb(); // first_mb_in_slice
         bs.skipUeGolomb(); // slice_type
@@ -191,10 +191,7 @@ bool cMarkAdStreamInfo::FindH264VideoInfos(MarkAdContext *maContext, uchar *pkt,
 
     if (nalu==NAL_SPS)
     {
-        uint8_t *nal_data=(uint8_t*) alloca(len);
-        if (!nal_data) return false;
-        int nal_len = nalUnescape(nal_data, pkt + 5, len - 5);
-        cBitStream bs(nal_data, nal_len);
+        cBitStream bs(pkt + 5, len - 5, true);
 
         uint32_t width=0;
         uint32_t height=0;
@@ -674,78 +671,392 @@ unsigned BitRateExtL:
     return false;
 }
 
-// taken from femon
-int cMarkAdStreamInfo::nalUnescape(uint8_t *dst, const uint8_t *src, int len)
+// skips profile_tier_level(1,MaxSubLayersMinus1) of VPS/SPS,
+// returns general_interlaced_source_flag
+static bool H265ProfileTierLevel(cBitStream &bs, int MaxSubLayersMinus1)
 {
-    int s = 0, d = 0;
+    bs.skipBits(8);                                  // general_profile_space, tier, profile_idc
+    bs.skipBits(32);                                 // general_profile_compatibility_flags
+    bs.skipBit();                                    // general_progressive_source_flag
+    bool interlaced=bs.getBit();                     // general_interlaced_source_flag
+    bs.skipBits(46);                                 // non_packed, frame_only and reserved bits
+    bs.skipBits(8);                                  // general_level_idc
+    bool sub_layer_profile_present[8];
+    bool sub_layer_level_present[8];
+    for (int i=0; i<MaxSubLayersMinus1; i++)
+    {
+        sub_layer_profile_present[i]=bs.getBit();    // sub_layer_profile_present_flag
+        sub_layer_level_present[i]=bs.getBit();      // sub_layer_level_present_flag
+    }
+    if (MaxSubLayersMinus1>0)
+    {
+        for (int i=MaxSubLayersMinus1; i<8; i++)
+            bs.skipBits(2);                          // reserved_zero_2bits
+    }
+    for (int i=0; i<MaxSubLayersMinus1; i++)
+    {
+        if (sub_layer_profile_present[i]) bs.skipBits(88);
+        if (sub_layer_level_present[i]) bs.skipBits(8);
+    }
+    return interlaced;
+}
+
+bool cMarkAdStreamInfo::FindH265VideoInfos(MarkAdContext *maContext, uchar *pkt, int len)
+{
+    if ((!maContext) || (!pkt) || (len<7)) return false;
+
+    int nalu=(pkt[4]>>1) & 0x3F;
+
+    maContext->Video.Info.Pict_Type=0;
+    if (nalu==H265_NAL_AUD)
+    {
+        // pic_type 0 -> only I slices, in broadcasts these are the
+        // IRAP pictures (IDR/CRA), all others are skipped by the decoder
+        if ((pkt[6]>>5)==0) maContext->Video.Info.Pict_Type=MA_I_TYPE;
+        return true;
+    }
+
+    if (nalu==H265_NAL_VPS)
+    {
+        cBitStream bs(pkt + 6, len - 6, true);
+
+        bs.skipBits(4);                              // vps_video_parameter_set_id
+        bs.skipBits(2);                              // vps_base_layer_internal/available_flag
+        bs.skipBits(6);                              // vps_max_layers_minus1
+        int max_sub_layers_minus1=bs.getBits(3);     // vps_max_sub_layers_minus1
+        bs.skipBit();                                // vps_temporal_id_nesting_flag
+        bs.skipBits(16);                             // vps_reserved_0xffff_16bits
+        H265ProfileTierLevel(bs,max_sub_layers_minus1);
+        bool ordering_info=bs.getBit();              // vps_sub_layer_ordering_info_present_flag
+        for (int i=ordering_info ? 0 : max_sub_layers_minus1; i<=max_sub_layers_minus1; i++)
+        {
+            bs.skipUeGolomb();                       // vps_max_dec_pic_buffering_minus1
+            bs.skipUeGolomb();                       // vps_max_num_reorder_pics
+            bs.skipUeGolomb();                       // vps_max_latency_increase_plus1
+        }
+        int max_layer_id=bs.getBits(6);              // vps_max_layer_id
+        uint32_t num_layer_sets_minus1=bs.getUeGolomb(); // vps_num_layer_sets_minus1
+        if (num_layer_sets_minus1>1023) return false;
+        bs.skipBits(num_layer_sets_minus1*(max_layer_id+1)); // layer_id_included_flag
+        if (bs.getBit())                             // vps_timing_info_present_flag
+        {
+            uint32_t num_units_in_tick=bs.getU32();  // vps_num_units_in_tick
+            uint32_t time_scale=bs.getU32();         // vps_time_scale
+            // the sps (vui) may override this
+            if ((num_units_in_tick) && (time_scale) && (!bs.isEOF()))
+                maContext->Video.Info.FramesPerSecond=(double) time_scale/num_units_in_tick;
+        }
+    }
 
-    while (s < len)
+    if (nalu==H265_NAL_SPS)
     {
-        if (!src[s] && !src[s + 1])
+        cBitStream bs(pkt + 6, len - 6, true);
+
+        bs.skipBits(4);                              // sps_video_parameter_set_id
+        int max_sub_layers_minus1=bs.getBits(3);     // sps_max_sub_layers_minus1
+        bs.skipBit();                                // sps_temporal_id_nesting_flag
+
+        bool interlaced=H265ProfileTierLevel(bs,max_sub_layers_minus1);
+
+        bs.skipUeGolomb();                           // sps_seq_parameter_set_id
+        int chroma_format_idc=bs.getUeGolomb();      // chroma_format_idc
+        if (chroma_format_idc==3)
+            bs.skipBit();                            // separate_colour_plane_flag
+        uint32_t width=bs.getUeGolomb();             // pic_width_in_luma_samples
+        uint32_t height=bs.getUeGolomb();            // pic_height_in_luma_samples
+        if (bs.getBit())                             // conformance_window_flag
+        {
+            int sub_width=(chroma_format_idc==1 || chroma_format_idc==2) ? 2 : 1;
+            int sub_height=(chroma_format_idc==1) ? 2 : 1;
+            uint32_t crop_left   = bs.getUeGolomb(); // conf_win_left_offset
+            uint32_t crop_right  = bs.getUeGolomb(); // conf_win_right_offset
+            uint32_t crop_top    = bs.getUeGolomb(); // conf_win_top_offset
+            uint32_t crop_bottom = bs.getUeGolomb(); // conf_win_bottom_offset
+            width-=sub_width*(crop_left+crop_right);
+            height-=sub_height*(crop_top+crop_bottom);
+        }
+        bs.skipUeGolomb();                           // bit_depth_luma_minus8
+        bs.skipUeGolomb();                           // bit_depth_chroma_minus8
+        int log2_max_poc_lsb=bs.getUeGolomb()+4;     // log2_max_pic_order_cnt_lsb_minus4
+        bool ordering_info=bs.getBit();              // sps_sub_layer_ordering_info_present_flag
+        for (int i=ordering_info ? 0 : max_sub_layers_minus1; i<=max_sub_layers_minus1; i++)
+        {
+            bs.skipUeGolomb();                       // sps_max_dec_pic_buffering_minus1
+            bs.skipUeGolomb();                       // sps_max_num_reorder_pics
+            bs.skipUeGolomb();                       // sps_max_latency_increase_plus1
+        }
+        bs.skipUeGolomb();                           // log2_min_luma_coding_block_size_minus3
+        bs.skipUeGolomb();                           // log2_diff_max_min_luma_coding_block_size
+        bs.skipUeGolomb();                           // log2_min_luma_transform_block_size_minus2
+        bs.skipUeGolomb();                           // log2_diff_max_min_luma_transform_block_size
+        bs.skipUeGolomb();                           // max_transform_hierarchy_depth_inter
+        bs.skipUeGolomb();                           // max_transform_hierarchy_depth_intra
+        if (bs.getBit())                             // scaling_list_enabled_flag
         {
-            // hit 00 00 xx
-            dst[d] = dst[d + 1] = 0;
-            s += 2;
-            d += 2;
-            if (src[s] == 3)
+            if (bs.getBit())                         // sps_scaling_list_data_present_flag
             {
-                s++; // 00 00 03 xx --> 00 00 xx
-                if (s >= len)
-                    return d;
+                for (int sizeId=0; sizeId<4; sizeId++)
+                {
+                    for (int matrixId=0; matrixId<6; matrixId+=(sizeId==3) ? 3 : 1)
+                    {
+                        if (!bs.getBit())            // scaling_list_pred_mode_flag
+                        {
+                            bs.skipUeGolomb();       // scaling_list_pred_matrix_id_delta
+                        }
+                        else
+                        {
+                            int coefNum=1<<(4+(sizeId<<1));
+                            if (coefNum>64) coefNum=64;
+                            if (sizeId>1) bs.skipSeGolomb(); // scaling_list_dc_coef_minus8
+                            for (int i=0; i<coefNum; i++)
+                                bs.skipSeGolomb();   // scaling_list_delta_coef
+                        }
+                    }
+                }
             }
         }
-        dst[d++] = src[s++];
-    }
+        bs.skipBit();                                // amp_enabled_flag
+        bs.skipBit();                                // sample_adaptive_offset_enabled_flag
+        if (bs.getBit())                             // pcm_enabled_flag
+        {
+            bs.skipBits(4);                          // pcm_sample_bit_depth_luma_minus1
+            bs.skipBits(4);                          // pcm_sample_bit_depth_chroma_minus1
+            bs.skipUeGolomb();                       // log2_min_pcm_luma_coding_block_size_minus3
+            bs.skipUeGolomb();                       // log2_diff_max_min_pcm_luma_coding_block_size
+            bs.skipBit();                            // pcm_loop_filter_disabled_flag
+        }
+        uint32_t num_short_term_ref_pic_sets=bs.getUeGolomb();
+        if (num_short_term_ref_pic_sets>64) return false;
+        int num_delta_pocs[64];
+        for (uint32_t i=0; i<num_short_term_ref_pic_sets; i++)
+        {
+            // st_ref_pic_set(i)
+            bool inter_ref_pic_set_prediction_flag=false;
+            if (i) inter_ref_pic_set_prediction_flag=bs.getBit();
+            if (inter_ref_pic_set_prediction_flag)
+            {
+                bs.skipBit();                        // delta_rps_sign
+                bs.skipUeGolomb();                   // abs_delta_rps_minus1
+                num_delta_pocs[i]=0;
+                for (int j=0; j<=num_delta_pocs[i-1]; j++)
+                {
+                    bool used_by_curr_pic_flag=bs.getBit();
+                    bool use_delta_flag=true;
+                    if (!used_by_curr_pic_flag) use_delta_flag=bs.getBit();
+                    if (use_delta_flag) num_delta_pocs[i]++;
+                }
+            }
+            else
+            {
+                uint32_t num_negative_pics=bs.getUeGolomb();
+                uint32_t num_positive_pics=bs.getUeGolomb();
+                if (num_negative_pics+num_positive_pics>32) return false;
+                for (uint32_t j=0; j<num_negative_pics+num_positive_pics; j++)
+                {
+                    bs.skipUeGolomb();               // delta_poc_sX_minus1
+                    bs.skipBit();                    // used_by_curr_pic_sX_flag
+                }
+                num_delta_pocs[i]=num_negative_pics+num_positive_pics;
+            }
+        }
+        if (bs.getBit())                             // long_term_ref_pics_present_flag
+        {
+            uint32_t num_long_term_ref_pics_sps=bs.getUeGolomb();
+            if (num_long_term_ref_pics_sps>32) return false;
+            for (uint32_t i=0; i<num_long_term_ref_pics_sps; i++)
+            {
+                bs.skipBits(log2_max_poc_lsb);       // lt_ref_pic_poc_lsb_sps
+                bs.skipBit();                        // used_by_curr_pic_lt_sps_flag
+            }
+        }
+        bs.skipBit();                                // sps_temporal_mvp_enabled_flag
+        bs.skipBit();                                // strong_intra_smoothing_enabled_flag
 
-    return d;
-}
+        int sar_width=1,sar_height=1;
+        if (bs.getBit())                             // vui_parameters_present_flag
+        {
+            if (bs.getBit())                         // aspect_ratio_info_present_flag
+            {
+                // Table E-1, same as H264
+                static const int sar[17][2] =
+                {
+                    {0,0},{1,1},{12,11},{10,11},{16,11},{40,33},{24,11},{20,11},{32,11},
+                    {80,33},{18,11},{15,11},{64,33},{160,99},{4,3},{3,2},{2,1}
+                };
+                int aspect_ratio_idc=bs.getU8();     // aspect_ratio_idc
+                if (aspect_ratio_idc==255)
+                {
+                    sar_width=bs.getBits(16);        // sar_width
+                    sar_height=bs.getBits(16);       // sar_height
+                }
+                else if ((aspect_ratio_idc>0) && (aspect_ratio_idc<17))
+                {
+                    sar_width=sar[aspect_ratio_idc][0];
+                    sar_height=sar[aspect_ratio_idc][1];
+                }
+            }
+            if (bs.getBit())                         // overscan_info_present_flag
+                bs.skipBit();                        // overscan_appropriate_flag
+            if (bs.getBit())                         // video_signal_type_present_flag
+            {
+                bs.skipBits(3);                      // video_format
+                bs.skipBit();                        // video_full_range_flag
+                if (bs.getBit())                     // colour_description_present_flag
+                {
+                    bs.skipBits(8);                  // colour_primaries
+                    bs.skipBits(8);                  // transfer_characteristics
+                    bs.skipBits(8);                  // matrix_coeffs
+                }
+            }
+            if (bs.getBit())                         // chroma_loc_info_present_flag
+            {
+                bs.skipUeGolomb();                   // chroma_sample_loc_type_top_field
+                bs.skipUeGolomb();                   // chroma_sample_loc_type_bottom_field
+            }
+            bs.skipBit();                            // neutral_chroma_indication_flag
+            if (bs.getBit()) interlaced=true;        // field_seq_flag
+            bs.skipBit();                            // frame_field_info_present_flag
+            if (bs.getBit())                         // default_display_window_flag
+            {
+                bs.skipUeGolomb();                   // def_disp_win_left_offset
+                bs.skipUeGolomb();                   // def_disp_win_right_offset
+                bs.skipUeGolomb();                   // def_disp_win_top_offset
+                bs.skipUeGolomb();                   // def_disp_win_bottom_offset
+            }
+            if (bs.getBit())                         // vui_timing_info_present_flag
+            {
+                uint32_t num_units_in_tick=bs.getU32(); // vui_num_units_in_tick
+                uint32_t time_scale=bs.getU32();     // vui_time_scale
+                // one tick per picture (frame or field)
+                if ((num_units_in_tick) && (time_scale))
+                    maContext->Video.Info.FramesPerSecond=(double) time_scale/num_units_in_tick;
+            }
+        }
 
+        if ((bs.isEOF()) || (!width) || (!height)) return false;
+
+        maContext->Video.Info.Interlaced=interlaced;
+        maContext->Video.Info.Width=width;
+        maContext->Video.Info.Height=height;
+
+        // display aspect ratio, snapped to the usual ones
+        if ((!sar_width) || (!sar_height)) sar_width=sar_height=1;
+        double dar=(double) (width*sar_width)/(height*sar_height);
+        if ((dar>1.74) && (dar<1.81))
+        {
+            maContext->Video.Info.AspectRatio.Num=16;
+            maContext->Video.Info.AspectRatio.Den=9;
+        }
+        else if ((dar>1.30) && (dar<1.37))
+        {
+            maContext->Video.Info.AspectRatio.Num=4;
+            maContext->Video.Info.AspectRatio.Den=3;
+        }
+        else
+        {
+            maContext->Video.Info.AspectRatio.Num=width*sar_width;
+            maContext->Video.Info.AspectRatio.Den=height*sar_height;
+        }
+    }
+    return false;
+}
 
-cBitStream::cBitStream(const uint8_t *buf, const int len)
+cBitStream::cBitStream(const uint8_t *buf, const int len, bool Escaped)
         : data(buf),
-        count(len*8),
-        index(0)
+        end(buf+len),
+        cache(0),
+        bits(0),
+        count(0),
+        index(0),
+        zeros(0),
+        escaped(Escaped)
 {
+    refill();
 }
 
 cBitStream::~cBitStream()
 {
 }
 
-int cBitStream::getBit()
+void cBitStream::refill()
 {
-    if (index >= count)
-        return (1); // -> no infinite colomb's ...
-
-    int r = (data[index >> 3] >> (7 - (index & 7))) & 1;
-    ++index;
+    while (bits<=56)
+    {
+        if (data>=end)
+        {
+            // behind the end only ones -> no infinite colomb's ...
+            cache|=(uint64_t) 0xff << (56-bits);
+            bits+=8;
+            continue;
+        }
+        uint8_t byte=*data++;
+        if ((escaped) && (zeros>=2) && (byte==3))
+        {
+            // 00 00 03 xx --> 00 00 xx
+            zeros=0;
+            continue;
+        }
+        if (byte) zeros=0;
+        else zeros++;
+        cache|=(uint64_t) byte << (56-bits);
+        bits+=8;
+        count+=8;
+    }
+}
 
-    return (r);
+int cBitStream::getBit()
+{
+    if (bits<1) refill();
+    int r=(int) (cache >> 63);
+    cache<<=1;
+    bits--;
+    index++;
+    return r;
 }
 
 uint32_t cBitStream::getBits(uint32_t n)
 {
-    uint32_t r = 0;
-
-    while (n--)
-        r = (r | (getBit() << n));
-
-    return (r);
+    if (!n) return 0;
+    if (n>32) n=32;
+    if (bits<(int) n) refill();
+    uint32_t r=(uint32_t) (cache >> (64-n));
+    cache<<=n;
+    bits-=n;
+    index+=n;
+    return r;
 }
 
 void cBitStream::skipBits(uint32_t n)
 {
-    index += n;
+    while (n>32)
+    {
+        getBits(32);
+        n-=32;
+    }
+    getBits(n);
 }
 
 uint32_t cBitStream::getUeGolomb()
 {
-    int n = 0;
-
-    while (!getBit() && (n < 32))
-        n++;
-
-    return (n ? ((1 << n) - 1) + getBits(n) : 0);
+    if (bits<=56) refill();
+    // refill leaves at least 57 bits in cache, so cache is never 0 here
+    int n=__builtin_clzll(cache);
+    if (n>=32)
+    {
+        // invalid (more than 32 zeros)
+        skipBits(32);
+        return 0xffffffff;
+    }
+    if (2*n+1<=bits)
+    {
+        uint32_t r=(uint32_t) (cache >> (63-2*n));
+        cache<<=2*n+1;
+        bits-=2*n+1;
+        index+=2*n+1;
+        return r-1;
+    }
+    skipBits(n);
+    return getBits(n+1)-1;
 }
 
 int32_t cBitStream::getSeGolomb()
@@ -757,12 +1068,7 @@ int32_t cBitStream::getSeGolomb()
 
 void cBitStream::skipGolomb()
 {
-    int n = 0;
-
-    while (!getBit() && (n < 32))
-        n++;
-
-    skipBits(n);
+    getUeGolomb();
 }
 
 void cBitStream::skipUeGolomb()
@@ -28,6 +28,15 @@ private:
         NAL_AUX_SLICE = 0x19  // Auxilary Slice
     };
 
+    enum
+    {
+        H265_NAL_VPS        = 32, // Video Parameter Set
+        H265_NAL_SPS        = 33, // Sequence Parameter Set
+        H265_NAL_PPS        = 34, // Picture Parameter Set
+        H265_NAL_AUD        = 35, // Access Unit Delimiter
+        H265_NAL_FD         = 38  // Filler data
+    };
+
     struct H264
     {
       bool separate_colour_plane_flag;
@@ -35,9 +44,9 @@ private:
       bool use_field;
     } H264;
     
-    int nalUnescape(uint8_t *dst, const uint8_t *src, int len);
     bool FindH264VideoInfos(MarkAdContext *maContext, uchar *pkt, int len);
     bool FindH262VideoInfos(MarkAdContext *maContext, uchar *pkt, int len);
+    bool FindH265VideoInfos(MarkAdContext *maContext, uchar *pkt, int len);
 public:
     cMarkAdStreamInfo();
     void Clear();
@@ -45,16 +54,24 @@ public:
     bool FindAC3AudioInfos(MarkAdContext *maContext, uchar *espkt, int eslen);
 };
 
-// taken from femon
+// based on femon, reads 64 bits at once and removes
+// emulation prevention bytes (00 00 03) only from the
+// bytes actually read
 class cBitStream
 {
 private:
     const uint8_t *data;
-    int            count; // in bits
+    const uint8_t *end;
+    uint64_t       cache; // next bits, msb first
+    int            bits;  // valid bits in cache
+    int            count; // in bits, read from data till now
     int            index; // in bits
+    int            zeros; // zero bytes before data
+    bool           escaped;
+    void           refill();
 
 public:
-    cBitStream(const uint8_t *buf, const int len);
+    cBitStream(const uint8_t *buf, const int len, bool Escaped=false);
     ~cBitStream();
 
     int            getBit();
@@ -77,32 +94,24 @@ public:
     }
     uint32_t       getU16()
     {
-        return ((getBits(8) << 8) | getBits(8));
+        return getBits(16);
     }
     uint32_t       getU24()
     {
-        return ((getBits(8) << 16) | (getBits(8) << 8) | getBits(8));
+        return getBits(24);
     }
     uint32_t       getU32()
     {
-        return ((getBits(8) << 24) | (getBits(8) << 16) | (getBits(8) << 8) | getBits(8));
+        return getBits(32);
     }
     bool           isEOF()
     {
-        return (index >= count);
-    }
-    void           reset()
-    {
-        index = 0;
+        return ((index >= count) && (data >= end));
     }
     int            getIndex()
     {
         return (isEOF() ? count : index);
     }
-    const uint8_t *getData()
-    {
-        return (isEOF() ? NULL : data + (index / 8));
-    }
 };
 
 #endif
@@ -0,0 +1,174 @@
+/*
+ * timeline.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "timeline.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+#define TL_MAGIC 0x4c544d4d // "MMTL"
+#define TL_VERSION 2
+
+cMarkAdTimeline::cMarkAdTimeline(const char *Directory)
+{
+    f=NULL;
+    error=false;
+    count=0;
+    fps=0;
+    entries=NULL;
+    memset(&lastaudio,0,sizeof(lastaudio));
+    if (asprintf(&filename,"%s/%s",Directory,TIMELINE_FILE)==-1) filename=NULL;
+    if (asprintf(&tmpname,"%s/%s.tmp",Directory,TIMELINE_FILE)==-1) tmpname=NULL;
+}
+
+cMarkAdTimeline::~cMarkAdTimeline()
+{
+    // an unfinished timeline is kept for the checkpoint
+    if (f) fclose(f);
+    if (filename) free(filename);
+    if (tmpname) free(tmpname);
+    if (entries) free(entries);
+}
+
+bool cMarkAdTimeline::readheader(FILE *F, struct header *Header)
+{
+    if (fread(Header,sizeof(*Header),1,F)!=1) return false;
+    if (Header->Magic!=TL_MAGIC) return false;
+    if (Header->Version!=TL_VERSION) return false;
+    if (Header->EntrySize!=(int) sizeof(struct entry)) return false;
+    return true;
+}
+
+bool cMarkAdTimeline::Create()
+{
+    if (f) fclose(f);
+    f=NULL;
+    count=0;
+    error=false;
+    if (!tmpname) return false;
+    f=fopen(tmpname,"w");
+    if (!f)
+    {
+        esyslog("failed to create %s (%i)",tmpname,errno);
+        return false;
+    }
+    // the header is completed in Commit
+    struct header header;
+    memset(&header,0,sizeof(header));
+    if (fwrite(&header,sizeof(header),1,f)!=1) error=true;
+    return !error;
+}
+
+bool cMarkAdTimeline::Resume(int Count)
+{
+    // continue after the first Count entries (from a checkpoint)
+    if (f) fclose(f);
+    f=NULL;
+    error=false;
+    if ((!tmpname) || (Count<0)) return false;
+    f=fopen(tmpname,"r+");
+    if (!f) return false;
+    struct header header;
+    bool ok=(fread(&header,sizeof(header),1,f)==1);
+    long size=sizeof(header)+(long) Count*sizeof(struct entry);
+    if ((ok) && (fseek(f,0,SEEK_END)==-1)) ok=false;
+    if ((ok) && (ftell(f)<size)) ok=false;
+    if ((ok) && (ftruncate(fileno(f),size)==-1)) ok=false;
+    if ((ok) && (fseek(f,size,SEEK_SET)==-1)) ok=false;
+    if (!ok)
+    {
+        fclose(f);
+        f=NULL;
+        return false;
+    }
+    count=Count;
+    return true;
+}
+
+void cMarkAdTimeline::Add(const struct entry *Entry)
+{
+    if ((!f) || (error)) return;
+    if (Entry->Type==tAUDIO)
+    {
+        // audio is processed several times per iframe
+        if ((Entry->LastIFrame==lastaudio.LastIFrame) && (Entry->IFrame==lastaudio.IFrame) &&
+                (Entry->Channels==lastaudio.Channels)) return;
+        lastaudio=*Entry;
+    }
+    if (fwrite(Entry,sizeof(*Entry),1,f)!=1)
+    {
+        esyslog("failed to write %s (%i)",tmpname,errno);
+        error=true;
+        return;
+    }
+    count++;
+}
+
+bool cMarkAdTimeline::Flush()
+{
+    if (!f) return false;
+    if (fflush(f)) error=true;
+    return !error;
+}
+
+bool cMarkAdTimeline::Commit(double FramesPerSecond)
+{
+    if (!f) return false;
+    struct header header;
+    memset(&header,0,sizeof(header));
+    header.Magic=TL_MAGIC;
+    header.Version=TL_VERSION;
+    header.EntrySize=sizeof(struct entry);
+    header.Count=count;
+    header.FramesPerSecond=FramesPerSecond;
+    if (fseek(f,0,SEEK_SET)==-1) error=true;
+    if ((!error) && (fwrite(&header,sizeof(header),1,f)!=1)) error=true;
+    if (fclose(f)) error=true;
+    f=NULL;
+    if ((error) || (rename(tmpname,filename)==-1))
+    {
+        esyslog("failed to write %s",filename);
+        unlink(tmpname);
+        return false;
+    }
+    fps=FramesPerSecond;
+    return true;
+}
+
+bool cMarkAdTimeline::Load()
+{
+    if (!filename) return false;
+    FILE *file=fopen(filename,"r");
+    if (!file) return false;
+
+    struct header header;
+    bool ok=((readheader(file,&header)) && (header.Count>=0));
+    if (ok)
+    {
+        if (entries) free(entries);
+        entries=(struct entry *) malloc((header.Count ? header.Count : 1)*sizeof(struct entry));
+        ok=((entries) && (fread(entries,sizeof(struct entry),header.Count,file)==(size_t) header.Count));
+    }
+    fclose(file);
+    if (!ok)
+    {
+        esyslog("invalid %s",filename);
+        count=0;
+        return false;
+    }
+    count=header.Count;
+    fps=header.FramesPerSecond;
+    return true;
+}
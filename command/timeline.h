@@ -0,0 +1,78 @@
+/*
+ * timeline.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __timeline_h_
+#define __timeline_h_
+
+#include <stdio.h>
+
+#include "global.h"
+
+#define TIMELINE_FILE "markad.timeline"
+
+// --- cMarkAdTimeline
+// what the detectors have seen in the first pass, one entry per
+// iframe, processed picture and processed audio frame. Enough to
+// make all decisions again without decoding (--pass3only).
+// Written to a temporary file while the first pass runs, renamed
+// when it's complete.
+class cMarkAdTimeline
+{
+public:
+    enum { tIFRAME=1, tVIDEO, tAUDIO };
+    struct entry
+    {
+        int Type;
+        int Framecnt;
+        int LastIFrame;
+        int IFrame;
+        int Channels;
+        MarkAdVideoFeatures Video;
+    };
+private:
+    struct header
+    {
+        int Magic;
+        int Version;
+        int EntrySize;
+        int Count;
+        double FramesPerSecond;
+    };
+    char *filename;
+    char *tmpname;
+    FILE *f;
+    bool error;
+    int count;
+    double fps;
+    struct entry *entries;
+    struct entry lastaudio;
+    bool readheader(FILE *F, struct header *Header);
+public:
+    cMarkAdTimeline(const char *Directory);
+    ~cMarkAdTimeline();
+    bool Create();
+    bool Resume(int Count);
+    void Add(const struct entry *Entry);
+    bool Flush();
+    bool Commit(double FramesPerSecond);
+    bool Load();
+    int Count()
+    {
+        return count;
+    }
+    double FramesPerSecond()
+    {
+        return fps;
+    }
+    const struct entry *Get(int Index)
+    {
+        if ((!entries) || (Index<0) || (Index>=count)) return NULL;
+        return &entries[Index];
+    }
+};
+
+#endif
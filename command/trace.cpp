@@ -0,0 +1,142 @@
+/*
+ * trace.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "profile.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+volatile bool cMarkAdTrace::enabled=false;
+bool cMarkAdTrace::recording=false;
+bool cMarkAdTrace::profiling=false;
+char *cMarkAdTrace::filename=NULL;
+struct cMarkAdTrace::buffer *cMarkAdTrace::buffers=NULL;
+__thread struct cMarkAdTrace::buffer *cMarkAdTrace::local=NULL;
+
+bool cMarkAdTrace::Start(const char *File)
+{
+    if (!File) return false;
+    if (filename) free(filename);
+    filename=strdup(File);
+    if (!filename) return false;
+    recording=true;
+    enabled=true;
+    return true;
+}
+
+void cMarkAdTrace::Profile(bool On)
+{
+    profiling=On;
+    enabled=(recording || profiling);
+}
+
+struct cMarkAdTrace::buffer *cMarkAdTrace::attach()
+{
+    struct buffer *buf=(struct buffer *) calloc(1,sizeof(struct buffer));
+    if (!buf) return NULL;
+    buf->tid=(pid_t) syscall(SYS_gettid);
+    // push onto the list, other threads may do the same
+    do
+    {
+        buf->next=buffers;
+    }
+    while (!__sync_bool_compare_and_swap(&buffers,buf->next,buf));
+    return buf;
+}
+
+bool cMarkAdTrace::grow(struct buffer *Buf)
+{
+    if (Buf->max>=TRACE_MAXEVENTS) return false;
+    int nmax=Buf->max ? Buf->max*2 : 65536;
+    if (nmax>TRACE_MAXEVENTS) nmax=TRACE_MAXEVENTS;
+    struct event *nevents=(struct event *) realloc(Buf->events,nmax*sizeof(struct event));
+    if (!nevents) return false;
+    Buf->events=nevents;
+    Buf->max=nmax;
+    return true;
+}
+
+void cMarkAdTrace::Add(char Phase, const char *Name, int Arg)
+{
+    if (profiling) cMarkAdProfile::Add(Phase,Name);
+    if (!recording) return;
+    if (!local) local=attach();
+    struct buffer *buf=local;
+    if (!buf) return;
+    if ((buf->count>=buf->max) && (!grow(buf)))
+    {
+        buf->dropped++;
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    struct event *ev=&buf->events[buf->count];
+    ev->ts=(int64_t) now.tv_sec*1000000+now.tv_nsec/1000;
+    ev->name=Name;
+    ev->arg=Arg;
+    ev->phase=Phase;
+    buf->count++;
+}
+
+bool cMarkAdTrace::Stop()
+{
+    if (!recording) return false;
+    recording=false;
+    enabled=profiling;
+
+    bool ret=true;
+    FILE *f=fopen(filename,"w");
+    if (!f)
+    {
+        esyslog("failed to create %s",filename);
+        ret=false;
+    }
+    else
+    {
+        pid_t pid=getpid();
+        bool first=true;
+        fprintf(f,"{\"traceEvents\":[\n");
+        for (struct buffer *buf=buffers; buf; buf=buf->next)
+        {
+            for (int i=0; i<buf->count; i++)
+            {
+                struct event *ev=&buf->events[i];
+                fprintf(f,"%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lli,\"pid\":%i,\"tid\":%i,"
+                        "%s\"args\":{\"arg\":%i}}",first ? "" : ",\n",ev->name,ev->phase,
+                        (long long) ev->ts,(int) pid,(int) buf->tid,
+                        (ev->phase=='i') ? "\"s\":\"t\"," : "",ev->arg);
+                first=false;
+            }
+            if (buf->dropped) isyslog("trace: %i events of thread %i dropped",buf->dropped,(int) buf->tid);
+        }
+        fprintf(f,"\n],\"displayTimeUnit\":\"ms\"}\n");
+        if (fclose(f)==EOF) ret=false;
+        if (ret) isyslog("trace written to %s",filename);
+    }
+
+    while (buffers)
+    {
+        struct buffer *next=buffers->next;
+        if (buffers->events) free(buffers->events);
+        free(buffers);
+        buffers=next;
+    }
+    local=NULL;
+    free(filename);
+    filename=NULL;
+    return ret;
+}
@@ -0,0 +1,78 @@
+/*
+ * trace.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __trace_h_
+#define __trace_h_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// static tracepoints (provider markad) for perf, bpftrace or
+// systemtap, a single nop each if nobody is attached
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define MARKAD_PROBE1(name,a) DTRACE_PROBE1(markad,name,a)
+#else
+#define MARKAD_PROBE1(name,a) do { } while (0)
+#endif
+
+// stage boundaries, each is a tracepoint and an event for the
+// recorder (--trace) and the profiler (--profile) if they are running
+#define TRACE_BEGIN(name,arg) do { MARKAD_PROBE1(name##_start,arg); \
+    if (__builtin_expect(cMarkAdTrace::Enabled(),0)) cMarkAdTrace::Add('B',#name,arg); } while (0)
+#define TRACE_END(name,arg) do { MARKAD_PROBE1(name##_end,arg); \
+    if (__builtin_expect(cMarkAdTrace::Enabled(),0)) cMarkAdTrace::Add('E',#name,arg); } while (0)
+#define TRACE_EVENT(name,arg) do { MARKAD_PROBE1(name,arg); \
+    if (__builtin_expect(cMarkAdTrace::Enabled(),0)) cMarkAdTrace::Add('i',#name,arg); } while (0)
+
+#define TRACE_MAXEVENTS 4194304 // per thread, later events are dropped
+
+// --- cMarkAdTrace
+// records the events in memory and writes them as a Chrome trace
+// (chrome://tracing, Perfetto). Every thread appends to its own
+// buffer without locks, the buffers are only linked into a list
+// when a thread adds its first event. Stop must be called when the
+// other threads are done.
+class cMarkAdTrace
+{
+private:
+    struct event
+    {
+        int64_t ts;        // microseconds
+        const char *name;  // string literal
+        int arg;
+        char phase;        // B, E or i
+    };
+    struct buffer
+    {
+        pid_t tid;
+        struct event *events;
+        int count;
+        int max;
+        int dropped;
+        struct buffer *next;
+    };
+    static volatile bool enabled; // recorder or profiler running
+    static bool recording;
+    static bool profiling;
+    static char *filename;
+    static struct buffer *buffers;
+    static __thread struct buffer *local;
+    static struct buffer *attach();
+    static bool grow(struct buffer *Buf);
+public:
+    static bool Start(const char *File);
+    static bool Stop();
+    static void Profile(bool On);
+    static bool Enabled()
+    {
+        return enabled;
+    }
+    static void Add(char Phase, const char *Name, int Arg);
+};
+
+#endif
@@ -10,6 +10,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 extern "C"
 {
@@ -17,34 +22,14 @@ extern "C"
 }
 
 #include "video.h"
+#include "sobel.h"
+#include "trace.h"
 
 cMarkAdLogo::cMarkAdLogo(MarkAdContext *maContext)
 {
     macontext=maContext;
 
-    // 3x3 GX Sobel mask
-    GX[0][0] = -1;
-    GX[0][1] =  0;
-    GX[0][2] =  1;
-    GX[1][0] = -2;
-    GX[1][1] =  0;
-    GX[1][2] =  2;
-    GX[2][0] = -1;
-    GX[2][1] =  0;
-    GX[2][2] =  1;
-
-    // 3x3 GY Sobel mask
-    GY[0][0] =  1;
-    GY[0][1] =  2;
-    GY[0][2] =  1;
-    GY[1][0] =  0;
-    GY[1][1] =  0;
-    GY[1][2] =  0;
-    GY[2][0] = -1;
-    GY[2][1] = -2;
-    GY[2][2] = -1;
-
-    if (maContext->Info.VPid.Type==MARKAD_PIDTYPE_VIDEO_H264)
+    if (maContext->Info.VPid.Type!=MARKAD_PIDTYPE_VIDEO_H262)
     {
         LOGOHEIGHT=LOGO_DEFHDHEIGHT;
         LOGOWIDTH=LOGO_DEFHDWIDTH;
@@ -56,6 +41,8 @@ cMarkAdLogo::cMarkAdLogo(MarkAdContext *maContext)
     }
 
     pixfmt_info=false;
+    kernelpixfmt=-1;
+    memset(kernel,0,sizeof(kernel));
     Clear();
 }
 
@@ -65,6 +52,36 @@ void cMarkAdLogo::Clear()
     area.status=LOGO_UNINITIALIZED;
 }
 
+void cMarkAdLogo::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    // mask is loaded again with the next frame
+    Ckp->Put(&area.status,sizeof(area.status));
+    Ckp->Put(&area.framenumber,sizeof(area.framenumber));
+    Ckp->Put(&area.counter,sizeof(area.counter));
+    Ckp->Put(&area.intensity,sizeof(area.intensity));
+}
+
+bool cMarkAdLogo::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Clear();
+    Ckp->Get(&area.status,sizeof(area.status));
+    Ckp->Get(&area.framenumber,sizeof(area.framenumber));
+    Ckp->Get(&area.counter,sizeof(area.counter));
+    Ckp->Get(&area.intensity,sizeof(area.intensity));
+    return !Ckp->Error();
+}
+
+bool cMarkAdLogo::Equal(cMarkAdLogo *Other)
+{
+    // same result for the following frames? the start frame
+    // is only used while a change is counted
+    if (area.status!=Other->area.status) return false;
+    if (area.counter!=Other->area.counter) return false;
+    if (area.intensity!=Other->area.intensity) return false;
+    if ((area.counter) && (area.framenumber!=Other->area.framenumber)) return false;
+    return true;
+}
+
 int cMarkAdLogo::Load(const char *directory, char *file, int plane)
 {
     if ((plane<0) || (plane>3)) return -3;
@@ -176,148 +193,149 @@ void cMarkAdLogo::Save(int framenumber, uchar picture[4][MAXPIXEL], int plane)
     free(buf);
 }
 
+bool cMarkAdLogo::selectKernels()
+{
+    // once per stream, YUV420P and YUVJ420P only differ in the range
+    if (kernelpixfmt==macontext->Video.Info.Pix_Fmt) return (kernel[0]!=NULL);
+    kernelpixfmt=macontext->Video.Info.Pix_Fmt;
+    switch (kernelpixfmt)
+    {
+    case 0:  // YUV420P
+    case 12: // YUVJ420P
+        kernel[0]=sobelkernel<0>;
+        kernel[1]=kernel[2]=kernel[3]=sobelkernel<1>;
+        return true;
+    default:
+        memset(kernel,0,sizeof(kernel));
+        if (!pixfmt_info)
+        {
+            esyslog("unknown pix_fmt %i, please report!",kernelpixfmt);
+            pixfmt_info=true;
+        }
+        return false;
+    }
+}
+
 int cMarkAdLogo::SobelPlane(int plane)
 {
     if ((plane<0) || (plane>3)) return 0;
     if (!macontext->Video.Data.PlaneLinesize[plane]) return 0;
+    if (!selectKernels()) return 0;
 
-    int xstart,xend,ystart,yend;
+    int xstart,ystart;
 
     switch (area.corner)
     {
     case TOP_LEFT:
         xstart=0;
-        xend=LOGOWIDTH;
         ystart=0;
-        yend=LOGOHEIGHT;
         break;
     case TOP_RIGHT:
         xstart=macontext->Video.Info.Width-LOGOWIDTH;
-        xend=macontext->Video.Info.Width;
         ystart=0;
-        yend=LOGOHEIGHT;
         break;
     case BOTTOM_LEFT:
         xstart=0;
-        xend=LOGOWIDTH;
         ystart=macontext->Video.Info.Height-LOGOHEIGHT;
-        yend=macontext->Video.Info.Height;
         break;
     case BOTTOM_RIGHT:
         xstart=macontext->Video.Info.Width-LOGOWIDTH;
-        xend=macontext->Video.Info.Width;
         ystart=macontext->Video.Info.Height-LOGOHEIGHT;
-        yend=macontext->Video.Info.Height;
         break;
     default:
         return 0;
     }
+    if ((xstart<0) || (ystart<0)) return 0; // picture smaller than the logo
 
-    if ((macontext->Video.Info.Pix_Fmt!=0) && (macontext->Video.Info.Pix_Fmt!=12))
-    {
-        if (!pixfmt_info)
-        {
-            esyslog("unknown pix_fmt %i, please report!",macontext->Video.Info.Pix_Fmt);
-            pixfmt_info=true;
-        }
-        return 0;
-    }
-
-    int boundary=6;
-    int cutval=127;
-    //int cutval=32;
     int width=LOGOWIDTH;
-
+    int height=LOGOHEIGHT;
     if (plane>0)
     {
         xstart/=2;
-        xend/=2;
         ystart/=2;
-        yend/=2;
-        boundary/=2;
-        cutval/=2;
         width/=2;
+        height/=2;
     }
 
-    int SUM;
-    int sumX,sumY;
-    area.rpixel[plane]=0;
-    if (!plane) area.intensity=0;
-    for (int Y=ystart; Y<=yend-1; Y++)
+    int linesize=macontext->Video.Data.PlaneLinesize[plane];
+    const uchar *src=macontext->Video.Data.Plane[plane]+xstart+ystart*linesize;
+    int intensity=0;
+    area.rpixel[plane]=kernel[plane](src,linesize,width,height,area.mask[plane],
+                                     area.sobel[plane],area.result[plane],&intensity);
+    if (!plane) area.intensity=intensity/(LOGOHEIGHT*width);
+#ifdef VDRDEBUG
+    for (int y=0; y<height; y++)
     {
-        for (int X=xstart; X<=xend-1; X++)
+        memcpy(&area.source[plane][y*width],src+y*linesize,width);
+    }
+#endif
+    return 1;
+}
+
+void cMarkAdLogo::Measure(int FrameNumber, MarkAdVideoFeatures *Features)
+{
+    Features->LogoResult=LOGO_ERROR;
+    Features->LogoRPixel=Features->LogoMPixel=0;
+    Features->LogoPlanes=Features->LogoIntensity=0;
+    if (!macontext) return;
+    if (!macontext->Video.Data.Valid) return;
+    if (!macontext->Video.Info.Width) return;
+    if (!macontext->Video.Info.Height) return;
+    if (!macontext->Config->logoDirectory[0]) return;
+    if (!macontext->Info.ChannelName) return;
+
+    if (macontext->Config->logoExtraction==-1)
+    {
+        if ((area.aspectratio.Num!=macontext->Video.Info.AspectRatio.Num) ||
+                (area.aspectratio.Den!=macontext->Video.Info.AspectRatio.Den))
         {
-            if (!plane)
-            {
-                area.intensity+=macontext->Video.Data.Plane[plane][X+(Y*macontext->Video.Data.PlaneLinesize[plane])];
-            }
-            sumX=0;
-            sumY=0;
-
-            // image boundaries
-            if (Y<(ystart+boundary) || Y>(yend-boundary))
-                SUM=0;
-            else if (X<(xstart+boundary) || X>(xend-boundary))
-                SUM=0;
-            // convolution starts here
-            else
+            char *buf=NULL;
+            if (asprintf(&buf,"%s-A%i_%i",macontext->Info.ChannelName,
+                         macontext->Video.Info.AspectRatio.Num,macontext->Video.Info.AspectRatio.Den)!=-1)
             {
-                // X Gradient approximation
-                for (int I=-1; I<=1; I++)
-                {
-                    for (int J=-1; J<=1; J++)
-                    {
-                        sumX=sumX+ (int) ((*(macontext->Video.Data.Plane[plane]+X+I+
-                                             (Y+J)*macontext->Video.Data.PlaneLinesize[plane]))
-                                          *GX[I+1][J+1]);
-                    }
-                }
-
-                // Y Gradient approximation
-                for (int I=-1; I<=1; I++)
+                area.corner=-1;
+                for (int plane=0; plane<4; plane++)
                 {
-                    for (int J=-1; J<=1; J++)
+                    int ret=Load(macontext->Config->logoDirectory,buf,plane);
+                    switch (ret)
                     {
-                        sumY=sumY+ (int) ((*(macontext->Video.Data.Plane[plane]+X+I+
-                                             (Y+J)*macontext->Video.Data.PlaneLinesize[plane]))*
-                                          GY[I+1][J+1]);
+                    case -1:
+                        isyslog("no logo for %s",buf);
+                        break;
+                    case -2:
+                        esyslog("format error in %s",buf);
+                        break;
+                    case -3:
+                        esyslog("cannot load %s",buf);
+                        break;
                     }
                 }
-
-                // Gradient Magnitude approximation
-                SUM = abs(sumX) + abs(sumY);
+                free(buf);
             }
-
-            if (SUM>=cutval) SUM=255;
-            if (SUM<cutval) SUM=0;
-
-            int val = 255-(uchar) SUM;
-
-            area.sobel[plane][(X-xstart)+(Y-ystart)*width]=val;
-
-            area.result[plane][(X-xstart)+(Y-ystart)*width]=
-                (area.mask[plane][(X-xstart)+(Y-ystart)*width] + val) & 255;
-
-            if (!area.result[plane][(X-xstart)+(Y-ystart)*width]) area.rpixel[plane]++;
-#ifdef VDRDEBUG
-            val=macontext->Video.Data.Plane[plane][X+(Y*macontext->Video.Data.PlaneLinesize[plane])];
-            area.source[plane][(X-xstart)+(Y-ystart)*width]=val;
-#endif
-
+            area.aspectratio.Num=macontext->Video.Info.AspectRatio.Num;
+            area.aspectratio.Den=macontext->Video.Info.AspectRatio.Den;
+        }
+    }
+    else
+    {
+        area.aspectratio.Num=macontext->Video.Info.AspectRatio.Num;
+        area.aspectratio.Den=macontext->Video.Info.AspectRatio.Den;
+        area.corner=macontext->Config->logoExtraction;
+        if (macontext->Config->logoWidth!=-1)
+        {
+            LOGOWIDTH=macontext->Config->logoWidth;
+        }
+        if (macontext->Config->logoHeight!=-1)
+        {
+            LOGOHEIGHT=macontext->Config->logoHeight;
         }
     }
-    if (!plane) area.intensity/=(LOGOHEIGHT*width);
-
-    return 1;
-}
 
-int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
-{
     bool extract=(macontext->Config->logoExtraction!=-1);
     int rpixel=0,mpixel=0;
     int processed=0;
-    *logoframenumber=-1;
-    if (area.corner==-1) return LOGO_NOCHANGE;
+    Features->LogoResult=LOGO_NOCHANGE;
+    if (area.corner==-1) return;
 
     for (int plane=0; plane<4; plane++)
     {
@@ -327,7 +345,7 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
         }
         if (extract)
         {
-            Save(framenumber,area.sobel,plane);
+            Save(FrameNumber,area.sobel,plane);
         }
         else
         {
@@ -335,16 +353,39 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
             mpixel+=area.mpixel[plane];
         }
     }
-    if (extract) return LOGO_NOCHANGE;
-    if (!processed) return LOGO_ERROR;
+    if (extract) return;
+    if (!processed)
+    {
+        Features->LogoResult=LOGO_ERROR;
+        return;
+    }
+    Features->LogoResult=LOGO_VISIBLE;
+    Features->LogoRPixel=rpixel;
+    Features->LogoMPixel=mpixel;
+    Features->LogoPlanes=processed;
+    Features->LogoIntensity=area.intensity;
+}
 
-    //tsyslog("rp=%5i mp=%5i mpV=%5.f mpI=%5.f i=%3i s=%i",rpixel,mpixel,(mpixel*LOGO_VMARK),(mpixel*LOGO_IMARK),area.intensity,area.status);
+int cMarkAdLogo::Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *LogoFrameNumber)
+{
+    *LogoFrameNumber=-1;
+    if (!Features->Valid)
+    {
+        area.status=LOGO_UNINITIALIZED;
+        return LOGO_ERROR;
+    }
+    if (Features->LogoResult!=LOGO_VISIBLE) return Features->LogoResult;
 
-    if (processed==1)
+    int rpixel=Features->LogoRPixel;
+    int mpixel=Features->LogoMPixel;
+
+    //tsyslog("rp=%5i mp=%5i mpV=%5.f mpI=%5.f i=%3i s=%i",rpixel,mpixel,(mpixel*LOGO_VMARK),(mpixel*LOGO_IMARK),Features->LogoIntensity,area.status);
+
+    if (Features->LogoPlanes==1)
     {
         // if we only have one plane we are "vulnerable"
         // to very bright pictures, so ignore them...
-        if (area.intensity>180) return LOGO_NOCHANGE;
+        if (Features->LogoIntensity>180) return LOGO_NOCHANGE;
     }
 
     int ret=LOGO_NOCHANGE;
@@ -359,8 +400,8 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
         {
             area.status=LOGO_INVISIBLE;
         }
-        area.framenumber=framenumber;
-        *logoframenumber=framenumber;
+        area.framenumber=FrameNumber;
+        *LogoFrameNumber=FrameNumber;
     }
 
     if (rpixel>=(mpixel*LOGO_VMARK))
@@ -370,18 +411,18 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
             if (area.counter>=LOGO_VMAXCOUNT)
             {
                 area.status=ret=LOGO_VISIBLE;
-                *logoframenumber=area.framenumber;
+                *LogoFrameNumber=area.framenumber;
                 area.counter=0;
             }
             else
             {
-                if (!area.counter) area.framenumber=framenumber;
+                if (!area.counter) area.framenumber=FrameNumber;
                 area.counter++;
             }
         }
         else
         {
-            area.framenumber=framenumber;
+            area.framenumber=FrameNumber;
             area.counter=0;
         }
     }
@@ -393,12 +434,12 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
             if (area.counter>=LOGO_IMAXCOUNT)
             {
                 area.status=ret=LOGO_INVISIBLE;
-                *logoframenumber=area.framenumber;
+                *LogoFrameNumber=area.framenumber;
                 area.counter=0;
             }
             else
             {
-                if (!area.counter) area.framenumber=framenumber;
+                if (!area.counter) area.framenumber=FrameNumber;
                 area.counter++;
             }
         }
@@ -415,68 +456,6 @@ int cMarkAdLogo::Detect(int framenumber, int *logoframenumber)
     return ret;
 }
 
-int cMarkAdLogo::Process(int FrameNumber, int *LogoFrameNumber)
-{
-    if (!macontext) return LOGO_ERROR;
-    if (!macontext->Video.Data.Valid)
-    {
-        area.status=LOGO_UNINITIALIZED;
-        return LOGO_ERROR;
-    }
-    if (!macontext->Video.Info.Width) return LOGO_ERROR;
-    if (!macontext->Video.Info.Height) return LOGO_ERROR;
-    if (!macontext->Config->logoDirectory[0]) return LOGO_ERROR;
-    if (!macontext->Info.ChannelName) return LOGO_ERROR;
-
-    if (macontext->Config->logoExtraction==-1)
-    {
-        if ((area.aspectratio.Num!=macontext->Video.Info.AspectRatio.Num) ||
-                (area.aspectratio.Den!=macontext->Video.Info.AspectRatio.Den))
-        {
-            char *buf=NULL;
-            if (asprintf(&buf,"%s-A%i_%i",macontext->Info.ChannelName,
-                         macontext->Video.Info.AspectRatio.Num,macontext->Video.Info.AspectRatio.Den)!=-1)
-            {
-                area.corner=-1;
-                for (int plane=0; plane<4; plane++)
-                {
-                    int ret=Load(macontext->Config->logoDirectory,buf,plane);
-                    switch (ret)
-                    {
-                    case -1:
-                        isyslog("no logo for %s",buf);
-                        break;
-                    case -2:
-                        esyslog("format error in %s",buf);
-                        break;
-                    case -3:
-                        esyslog("cannot load %s",buf);
-                        break;
-                    }
-                }
-                free(buf);
-            }
-            area.aspectratio.Num=macontext->Video.Info.AspectRatio.Num;
-            area.aspectratio.Den=macontext->Video.Info.AspectRatio.Den;
-        }
-    }
-    else
-    {
-        area.aspectratio.Num=macontext->Video.Info.AspectRatio.Num;
-        area.aspectratio.Den=macontext->Video.Info.AspectRatio.Den;
-        area.corner=macontext->Config->logoExtraction;
-        if (macontext->Config->logoWidth!=-1)
-        {
-            LOGOWIDTH=macontext->Config->logoWidth;
-        }
-        if (macontext->Config->logoHeight!=-1)
-        {
-            LOGOHEIGHT=macontext->Config->logoHeight;
-        }
-    }
-    return Detect(FrameNumber,LogoFrameNumber);
-}
-
 cMarkAdBlackBordersHoriz::cMarkAdBlackBordersHoriz(MarkAdContext *maContext)
 {
     macontext=maContext;
@@ -489,58 +468,69 @@ void cMarkAdBlackBordersHoriz::Clear()
     borderframenumber=-1;
 }
 
-int cMarkAdBlackBordersHoriz::Process(int FrameNumber, int *BorderIFrame)
+void cMarkAdBlackBordersHoriz::SaveState(cMarkAdCheckpoint *Ckp)
 {
-#define CHECKHEIGHT 20
-#define BRIGHTNESS 20
-#define VOFFSET 5
-    if (!macontext) return 0;
-    if (!macontext->Video.Data.Valid) return 0;
-    if (macontext->Video.Info.FramesPerSecond==0) return 0;
-    // Assumption: If we have 4:3, we should have aspectratio-changes!
-    //if (macontext->Video.Info.AspectRatio.Num==4) return 0; // seems not to be true in all countries?
-    *BorderIFrame=0;
+    Ckp->Put(&borderstatus,sizeof(borderstatus));
+    Ckp->Put(&borderframenumber,sizeof(borderframenumber));
+}
 
-    int height=macontext->Video.Info.Height-VOFFSET;
+bool cMarkAdBlackBordersHoriz::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Get(&borderstatus,sizeof(borderstatus));
+    Ckp->Get(&borderframenumber,sizeof(borderframenumber));
+    return !Ckp->Error();
+}
 
-    int start=(height-CHECKHEIGHT)*macontext->Video.Data.PlaneLinesize[0];
-    int end=height*macontext->Video.Data.PlaneLinesize[0];
-    bool ftop=true,fbottom=true;
-    int val=0,cnt=0,xz=0;
+bool cMarkAdBlackBordersHoriz::Equal(cMarkAdBlackBordersHoriz *Other)
+{
+    // uninitialized and invisible behave the same, the start
+    // of a visible border isn't used anymore
+    if ((borderstatus==HBORDER_VISIBLE)!=(Other->borderstatus==HBORDER_VISIBLE)) return false;
+    if (borderstatus==HBORDER_VISIBLE) return true;
+    return (borderframenumber==Other->borderframenumber);
+}
 
-    for (int x=start; x<end; x++)
+int cMarkAdBlackBordersHoriz::rowsum(int From, int To)
+{
+    // sum of the visible pixels of rows From..To-1, the padding
+    // up to the linesize is skipped per row instead of per pixel
+    int linesize=macontext->Video.Data.PlaneLinesize[0];
+    int width=macontext->Video.Info.Width;
+    int val=0;
+    for (int y=From; y<To; y++)
     {
-        if (xz<macontext->Video.Info.Width)
-        {
-            val+=macontext->Video.Data.Plane[0][x];
-            cnt++;
-        }
-        xz++;
-        if (xz>=macontext->Video.Data.PlaneLinesize[0]) xz=0;
+        const uchar *p=macontext->Video.Data.Plane[0]+y*linesize;
+        for (int x=0; x<width; x++) val+=p[x];
     }
-    val/=cnt;
-    if (val>BRIGHTNESS) fbottom=false;
+    return val;
+}
 
-    if (fbottom)
-    {
-        start=VOFFSET*macontext->Video.Data.PlaneLinesize[0];
-        end=macontext->Video.Data.PlaneLinesize[0]*(CHECKHEIGHT+VOFFSET);
-        val=0;
-        cnt=0;
-        xz=0;
-        for (int x=start; x<end; x++)
-        {
-            if (xz<macontext->Video.Info.Width)
-            {
-                val+=macontext->Video.Data.Plane[0][x];
-                cnt++;
-            }
-            xz++;
-            if (xz>=macontext->Video.Data.PlaneLinesize[0]) xz=0;
-        }
-        val/=cnt;
-        if (val>BRIGHTNESS) ftop=false;
-    }
+void cMarkAdBlackBordersHoriz::Measure(MarkAdVideoFeatures *Features)
+{
+#define BRIGHTNESS 20
+    Features->HBorderBottom=Features->HBorderTop=-1;
+    if (!macontext) return;
+    if (!macontext->Video.Data.Valid) return;
+    if (macontext->Video.Info.FramesPerSecond==0) return;
+    // Assumption: If we have 4:3, we should have aspectratio-changes!
+    //if (macontext->Video.Info.AspectRatio.Num==4) return; // seems not to be true in all countries?
+
+    int height=macontext->Video.Info.Height-HBORDER_OFFSET;
+    int cnt=HBORDER_HEIGHT*macontext->Video.Info.Width;
+    if (!cnt) return;
+
+    Features->HBorderBottom=rowsum(height-HBORDER_HEIGHT,height)/cnt;
+    Features->HBorderTop=rowsum(HBORDER_OFFSET,HBORDER_HEIGHT+HBORDER_OFFSET)/cnt;
+}
+
+int cMarkAdBlackBordersHoriz::Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BorderIFrame)
+{
+    if (!Features->Valid) return 0;
+    if ((Features->HBorderBottom<0) || (Features->HBorderTop<0)) return 0;
+    *BorderIFrame=0;
+
+    bool fbottom=(Features->HBorderBottom<=BRIGHTNESS);
+    bool ftop=(Features->HBorderTop<=BRIGHTNESS);
 
     if ((fbottom) && (ftop)) {
         if (borderframenumber==-1) {
@@ -581,51 +571,78 @@ void cMarkAdBlackBordersVert::Clear()
     borderframenumber=-1;
 }
 
-int cMarkAdBlackBordersVert::Process(int FrameNumber, int *BorderIFrame)
+void cMarkAdBlackBordersVert::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&borderstatus,sizeof(borderstatus));
+    Ckp->Put(&borderframenumber,sizeof(borderframenumber));
+}
+
+bool cMarkAdBlackBordersVert::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Get(&borderstatus,sizeof(borderstatus));
+    Ckp->Get(&borderframenumber,sizeof(borderframenumber));
+    return !Ckp->Error();
+}
+
+bool cMarkAdBlackBordersVert::Equal(cMarkAdBlackBordersVert *Other)
+{
+    // uninitialized and invisible behave the same, the start
+    // of a visible border isn't used anymore
+    if ((borderstatus==VBORDER_VISIBLE)!=(Other->borderstatus==VBORDER_VISIBLE)) return false;
+    if (borderstatus==VBORDER_VISIBLE) return true;
+    return (borderframenumber==Other->borderframenumber);
+}
+
+void cMarkAdBlackBordersVert::Measure(MarkAdVideoFeatures *Features)
 {
-#define CHECKWIDTH 32
 #define BRIGHTNESS 20
-#define HOFFSET 50
-#define VOFFSET_ 120
-    if (!macontext) return 0;
-    if (!macontext->Video.Data.Valid) return 0;
-    if (macontext->Video.Info.FramesPerSecond==0) return 0;
+    Features->VBorderLeft=Features->VBorderRight=-1;
+    if (!macontext) return;
+    if (!macontext->Video.Data.Valid) return;
+    if (macontext->Video.Info.FramesPerSecond==0) return;
     // Assumption: If we have 4:3, we should have aspectratio-changes!
-    //if (macontext->Video.Info.AspectRatio.Num==4) return 0; // seems not to be true in all countries?
-    *BorderIFrame=0;
+    //if (macontext->Video.Info.AspectRatio.Num==4) return; // seems not to be true in all countries?
+
+    // small pictures (y4m replay) have no room for the columns
+    if ((macontext->Video.Info.Height<=2*VBORDER_MARGIN) ||
+            (macontext->Video.Info.Width<2*(VBORDER_OFFSET+VBORDER_WIDTH))) return;
 
-    bool fleft=true,fright=true;
     int val=0,cnt=0;
 
-    int end=macontext->Video.Data.PlaneLinesize[0]*(macontext->Video.Info.Height-VOFFSET_);
-    int i=VOFFSET_*macontext->Video.Data.PlaneLinesize[0];
+    int end=macontext->Video.Data.PlaneLinesize[0]*(macontext->Video.Info.Height-VBORDER_MARGIN);
+    int i=VBORDER_MARGIN*macontext->Video.Data.PlaneLinesize[0];
     while (i<end) {
-        for (int x=0; x<CHECKWIDTH; x++)
+        for (int x=0; x<VBORDER_WIDTH; x++)
         {
-            val+=macontext->Video.Data.Plane[0][HOFFSET+x+i];
+            val+=macontext->Video.Data.Plane[0][VBORDER_OFFSET+x+i];
             cnt++;
         }
         i+=macontext->Video.Data.PlaneLinesize[0];
     }
-    val/=cnt;
-    if (val>BRIGHTNESS) fleft=false;
+    Features->VBorderLeft=val/cnt;
 
-    if (fleft)
-    {
-        val=cnt=0;
-        i=VOFFSET_*macontext->Video.Data.PlaneLinesize[0];
-        int w=macontext->Video.Info.Width-HOFFSET-CHECKWIDTH;
-        while (i<end) {
-            for (int x=0; x<CHECKWIDTH; x++)
-            {
-                val+=macontext->Video.Data.Plane[0][w+x+i];
-                cnt++;
-            }
-            i+=macontext->Video.Data.PlaneLinesize[0];
+    val=cnt=0;
+    i=VBORDER_MARGIN*macontext->Video.Data.PlaneLinesize[0];
+    int w=macontext->Video.Info.Width-VBORDER_OFFSET-VBORDER_WIDTH;
+    while (i<end) {
+        for (int x=0; x<VBORDER_WIDTH; x++)
+        {
+            val+=macontext->Video.Data.Plane[0][w+x+i];
+            cnt++;
         }
-        val/=cnt;
-        if (val>BRIGHTNESS) fright=false;
+        i+=macontext->Video.Data.PlaneLinesize[0];
     }
+    Features->VBorderRight=val/cnt;
+}
+
+int cMarkAdBlackBordersVert::Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BorderIFrame)
+{
+    if (!Features->Valid) return 0;
+    if ((Features->VBorderLeft<0) || (Features->VBorderRight<0)) return 0;
+    *BorderIFrame=0;
+
+    bool fleft=(Features->VBorderLeft<=BRIGHTNESS);
+    bool fright=(Features->VBorderRight<=BRIGHTNESS);
 
     if ((fleft) && (fright)) {
         if (borderframenumber==-1) {
@@ -654,12 +671,146 @@ int cMarkAdBlackBordersVert::Process(int FrameNumber, int *BorderIFrame)
     return 0;
 }
 
+static void rowstats_c(const uchar *Src, int Count, uint64_t *Sum, uint64_t *SumSq)
+{
+    uint32_t sum=0,sumsq=0;
+    for (int i=0; i<Count; i++)
+    {
+        sum+=Src[i];
+        sumsq+=Src[i]*Src[i];
+    }
+    *Sum+=sum;
+    *SumSq+=sumsq;
+}
+
+#if defined(__SSE2__)
+static int rowstats_sse2(const uchar *Src, int Count, uint64_t *Sum, uint64_t *SumSq)
+{
+    // sum with psadbw, squares with pmaddwd in 32 bit lanes, which
+    // can't overflow within one row
+    const __m128i zero=_mm_setzero_si128();
+    __m128i sum=zero,sumsq=zero;
+    int i=0;
+    for (; i+16<=Count; i+=16)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *) (Src+i));
+        sum=_mm_add_epi64(sum,_mm_sad_epu8(v,zero));
+        __m128i lo=_mm_unpacklo_epi8(v,zero);
+        __m128i hi=_mm_unpackhi_epi8(v,zero);
+        sumsq=_mm_add_epi32(sumsq,_mm_add_epi32(_mm_madd_epi16(lo,lo),_mm_madd_epi16(hi,hi)));
+    }
+    uint64_t s[2];
+    uint32_t q[4];
+    _mm_storeu_si128((__m128i *) s,sum);
+    _mm_storeu_si128((__m128i *) q,sumsq);
+    *Sum+=s[0]+s[1];
+    *SumSq+=(uint64_t) q[0]+q[1]+q[2]+q[3];
+    return i;
+}
+#endif
+
+cMarkAdBlackFrame::cMarkAdBlackFrame(MarkAdContext *maContext)
+{
+    macontext=maContext;
+    Clear();
+}
+
+void cMarkAdBlackFrame::Clear()
+{
+    blackstatus=BLACKFRAME_UNINITIALIZED;
+}
+
+void cMarkAdBlackFrame::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&blackstatus,sizeof(blackstatus));
+}
+
+bool cMarkAdBlackFrame::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Get(&blackstatus,sizeof(blackstatus));
+    return !Ckp->Error();
+}
+
+bool cMarkAdBlackFrame::Equal(cMarkAdBlackFrame *Other)
+{
+    // uninitialized and invisible behave the same
+    return ((blackstatus==BLACKFRAME_VISIBLE)==(Other->blackstatus==BLACKFRAME_VISIBLE));
+}
+
+void cMarkAdBlackFrame::Measure(MarkAdVideoFeatures *Features)
+{
+    Features->FrameMean=Features->FrameVariance=-1;
+    if (!macontext) return;
+    if (!macontext->Video.Data.Valid) return;
+    int width=macontext->Video.Info.Width;
+    int height=macontext->Video.Info.Height;
+    if ((width<8) || (height<4*BLACKFRAME_STEP)) return;
+
+    // middle three quarters of the width and half of the height
+    int x=width/8;
+    int w=width-2*x;
+    int y=((height/4)+BLACKFRAME_STEP-1)/BLACKFRAME_STEP*BLACKFRAME_STEP;
+    int end=height-(height/4);
+    int linesize=macontext->Video.Data.PlaneLinesize[0];
+
+    uint64_t sum=0,sumsq=0,cnt=0;
+    for (; y<end; y+=BLACKFRAME_STEP)
+    {
+        const uchar *p=macontext->Video.Data.Plane[0]+y*linesize+x;
+        int done=0;
+#if defined(__SSE2__)
+        done=rowstats_sse2(p,w,&sum,&sumsq);
+#endif
+        rowstats_c(p+done,w-done,&sum,&sumsq);
+        cnt+=w;
+    }
+    if (!cnt) return;
+
+    double mean=(double) sum/cnt;
+    double variance=(double) sumsq/cnt-mean*mean;
+    Features->FrameMean=(int) (mean+0.5);
+    Features->FrameVariance=(variance>0) ? (int) (variance+0.5) : 0;
+}
+
+int cMarkAdBlackFrame::Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BlackFrameNumber)
+{
+    if (!Features->Valid) return 0;
+    if ((Features->FrameMean<0) || (Features->FrameVariance<0)) return 0;
+    *BlackFrameNumber=0;
+
+    // uniform pictures, dark ones may be a bit noisier
+    bool black=(Features->FrameVariance<=BLACKFRAME_VARIANCE) ||
+               ((Features->FrameMean<=BLACKFRAME_BRIGHTNESS) &&
+                (Features->FrameVariance<=4*BLACKFRAME_VARIANCE));
+
+    if (black)
+    {
+        if (blackstatus!=BLACKFRAME_VISIBLE)
+        {
+            *BlackFrameNumber=FrameNumber;
+            blackstatus=BLACKFRAME_VISIBLE;
+            return 1; // first black picture
+        }
+    }
+    else
+    {
+        if (blackstatus==BLACKFRAME_VISIBLE)
+        {
+            *BlackFrameNumber=FrameNumber;
+            blackstatus=BLACKFRAME_INVISIBLE;
+            return -1; // first picture after the black ones
+        }
+        blackstatus=BLACKFRAME_INVISIBLE;
+    }
+    return 0;
+}
+
 cMarkAdOverlap::cMarkAdOverlap(MarkAdContext *maContext)
 {
     macontext=maContext;
 
-    histbuf[OV_BEFORE]=NULL;
-    histbuf[OV_AFTER]=NULL;
+    histbuf=NULL;
+    simcnt=NULL;
     Clear();
 }
 
@@ -670,158 +821,164 @@ cMarkAdOverlap::~cMarkAdOverlap()
 
 void cMarkAdOverlap::Clear()
 {
-    histcnt[OV_BEFORE]=0;
-    histcnt[OV_AFTER]=0;
-    histframes[OV_BEFORE]=0;
-    histframes[OV_AFTER]=0;
-    if (histbuf[OV_BEFORE])
+    histcnt=0;
+    histframes=0;
+    histshift=0;
+    aftercnt=0;
+    afterframes=0;
+    done=false;
+    if (histbuf)
     {
-        delete[] histbuf[OV_BEFORE];
-        histbuf[OV_BEFORE]=NULL;
+        delete[] histbuf;
+        histbuf=NULL;
     }
-    if (histbuf[OV_AFTER])
+    if (simcnt)
     {
-        delete[] histbuf[OV_AFTER];
-        histbuf[OV_AFTER]=NULL;
+        delete[] simcnt;
+        simcnt=NULL;
     }
-    memset(&result,0,sizeof(result));
+    result.FrameNumberBefore=-1;
+    result.FrameNumberAfter=-1;
     similarCutOff=0;
     similarMaxCnt=0;
 
     lastframenumber=-1;
 }
 
-void cMarkAdOverlap::getHistogram(simpleHistogram &dest)
+void cMarkAdOverlap::getHistogram(const MarkAdFrame *Frame, simpleHistogram &dest)
 {
-    memset(dest,0,sizeof(simpleHistogram));
-    for (int Y=0; Y<macontext->Video.Info.Height;Y++)
+    // every pixel of a subsampled frame stands for 1<<(2*Shift) pixels
+    int weight=1<<(2*Frame->Shift);
+    // four counters, so runs of equal pixels don't wait for
+    // the increment of the previous one
+    int cnt[4][256];
+    memset(cnt,0,sizeof(cnt));
+    const uchar *p=Frame->Plane;
+    int len=Frame->Width*Frame->Height;
+    int i;
+    for (i=0; i<len-3; i+=4)
     {
-        for (int X=0; X<macontext->Video.Info.Width;X++)
-        {
-            uchar val=macontext->Video.Data.Plane[0][X+(Y*macontext->Video.Data.PlaneLinesize[0])];
-            dest[val]++;
-        }
+        cnt[0][p[i]]++;
+        cnt[1][p[i+1]]++;
+        cnt[2][p[i+2]]++;
+        cnt[3][p[i+3]]++;
+    }
+    for (; i<len; i++) cnt[0][p[i]]++;
+    for (int v=0; v<256; v++)
+    {
+        dest[v]=(cnt[0][v]+cnt[1][v]+cnt[2][v]+cnt[3][v])*weight;
     }
 }
 
-bool cMarkAdOverlap::areSimilar(simpleHistogram &hist1, simpleHistogram &hist2)
+void cMarkAdOverlap::compactHist(simpleHistogram &src, compactHistogram &dest)
 {
-    int similar=0;
+    int round=(1<<histshift)>>1;
     for (int i=0; i<256; i++)
     {
-        similar+=abs(hist1[i]-hist2[i]);
+        int val=(src[i]+round)>>histshift;
+        if (val>0xFFFF) val=0xFFFF;
+        dest[i]=(unsigned short) val;
     }
-    //printf("%6i\n",similar);
-    if (similar<similarCutOff) return true;
-    return false;
 }
 
-MarkAdPos *cMarkAdOverlap::Detect()
+bool cMarkAdOverlap::areSimilar(simpleHistogram &hist1, compactHistogram &hist2)
 {
-    int start=0,simcnt=0;
-    int tmpA=0,tmpB=0;
-    if (result.FrameNumberBefore==-1) return NULL;
-    result.FrameNumberBefore=-1;
-    for (int B=0; B<histcnt[OV_BEFORE]; B++)
+    int similar=0;
+    for (int i=0; i<256; i++)
     {
-        for (int A=start; A<histcnt[OV_AFTER]; A++)
-        {
-            //printf("%6i %6i ",histbuf[OV_BEFORE][B].framenumber,histbuf[OV_AFTER][A].framenumber);
-            bool simil=areSimilar(histbuf[OV_BEFORE][B].histogram,histbuf[OV_AFTER][A].histogram);
-            if (simil)
-            {
-                tmpA=A;
-                tmpB=B;
-                start=A+1;
-                if (simil<(similarCutOff/2)) simcnt+=2;
-                else if (simil<(similarCutOff/4)) simcnt+=4;
-                else if (simil<(similarCutOff/6)) simcnt+=6;
-                else simcnt++;
-                break;
-            }
-            else
-            {
-                //if (simcnt) printf("simcnt=%i\n",simcnt);
-
-                if (simcnt>similarMaxCnt)
-                {
-                    if ((histbuf[OV_BEFORE][tmpB].framenumber>result.FrameNumberBefore) &&
-                            (histbuf[OV_AFTER][tmpA].framenumber>result.FrameNumberAfter))
-                    {
-                        result.FrameNumberBefore=histbuf[OV_BEFORE][tmpB].framenumber;
-                        result.FrameNumberAfter=histbuf[OV_AFTER][tmpA].framenumber;
-                    }
-                }
-                else
-                {
-                    start=0;
-                }
-                simcnt=0;
-            }
-        }
+        similar+=abs(hist1[i]-(hist2[i]<<histshift));
+        if (similar>=similarCutOff) return false;
     }
-    if (result.FrameNumberBefore==-1)
+    return true;
+}
+
+void cMarkAdOverlap::addResult(int Before, int FrameNumberAfter)
+{
+    // prefer the sequence nearest to the ad
+    if ((histbuf[Before].framenumber>result.FrameNumberBefore) &&
+            (FrameNumberAfter>result.FrameNumberAfter))
     {
-        if (simcnt>similarMaxCnt)
-        {
-            result.FrameNumberBefore=histbuf[OV_BEFORE][tmpB].framenumber;
-            result.FrameNumberAfter=histbuf[OV_AFTER][tmpA].framenumber;
-        }
-        else
-        {
-            return NULL;
-        }
+        result.FrameNumberBefore=histbuf[Before].framenumber;
+        result.FrameNumberAfter=FrameNumberAfter;
     }
-    return &result;
 }
 
-MarkAdPos *cMarkAdOverlap::Process(int FrameNumber, int Frames, bool BeforeAd, bool H264)
+MarkAdPos *cMarkAdOverlap::Process(const MarkAdFrame *Frame, int Frames, bool BeforeAd, bool H264)
 {
-    if ((lastframenumber>0) && (!similarMaxCnt))
+    if (!Frame) return NULL;
+    int FrameNumber=Frame->FrameNumber;
+
+    if (!similarMaxCnt)
     {
         similarCutOff=50000; // lower is harder!
         if (H264) similarCutOff*=6;
         similarMaxCnt=4;
     }
 
+    simpleHistogram hist;
     if (BeforeAd)
     {
-        if ((histframes[OV_BEFORE]) && (histcnt[OV_BEFORE]>=histframes[OV_BEFORE]))
-        {
-            if (result.FrameNumberBefore)
-            {
-                Clear();
-            }
-            else
-            {
-                return NULL;
-            }
-        }
-        if (!histbuf[OV_BEFORE])
+        // new frames before an ad -> new pair of marks
+        if ((aftercnt) || (done)) Clear();
+        if ((histframes) && (histcnt>=histframes)) return NULL;
+        if (!histbuf)
         {
-            histframes[OV_BEFORE]=Frames;
-            histbuf[OV_BEFORE]=new histbuffer[Frames+1];
+            if (Frames<=0) return NULL;
+            histframes=Frames;
+            histbuf=new histbuffer[Frames];
+            simcnt=new int[Frames];
+            memset(simcnt,0,sizeof(int)*Frames);
+            // scale down, so that all pixels fit into one bin
+            int pixel=(Frame->Height<<Frame->Shift)*(Frame->Width<<Frame->Shift);
+            while ((pixel>>histshift)>0xFFFF) histshift++;
         }
-        getHistogram(histbuf[OV_BEFORE][histcnt[OV_BEFORE]].histogram);
-        histbuf[OV_BEFORE][histcnt[OV_BEFORE]].framenumber=FrameNumber;
-        histcnt[OV_BEFORE]++;
+        getHistogram(Frame,hist);
+        compactHist(hist,histbuf[histcnt].histogram);
+        histbuf[histcnt].framenumber=FrameNumber;
+        histcnt++;
     }
     else
     {
-        if (!histbuf[OV_AFTER])
+        if ((done) || (!histcnt)) return NULL;
+        if (!afterframes) afterframes=Frames;
+
+        if (aftercnt>=afterframes-1)
         {
-            histframes[OV_AFTER]=Frames;
-            histbuf[OV_AFTER]=new histbuffer[Frames+1];
+            // end of range, take the best of the remaining sequences
+            done=true;
+            for (int B=0; B<histcnt; B++)
+            {
+                if (simcnt[B]>similarMaxCnt) addResult(B,lastframenumber);
+            }
+            if (result.FrameNumberBefore==-1) return NULL;
+            return &result;
         }
 
-        if (histcnt[OV_AFTER]>=histframes[OV_AFTER]-1)
+        // compare the frame against all frames before the ad, a sequence
+        // of similar frames continues diagonal (B-1,A-1) -> (B,A)
+        getHistogram(Frame,hist);
+        for (int B=histcnt-1; B>=0; B--)
         {
-            if (result.FrameNumberBefore) return NULL;
-            return Detect();
+            int prev=B ? simcnt[B-1] : 0;
+            if (areSimilar(hist,histbuf[B].histogram))
+            {
+                simcnt[B]=prev+2;
+            }
+            else
+            {
+                if (prev>similarMaxCnt) addResult(B-1,lastframenumber);
+                simcnt[B]=0;
+            }
+        }
+        aftercnt++;
+        if (simcnt[histcnt-1]>similarMaxCnt)
+        {
+            // sequence reaches the last frame before the ad,
+            // no better overlap possible
+            addResult(histcnt-1,FrameNumber);
+            done=true;
+            return &result;
         }
-        getHistogram(histbuf[OV_AFTER][histcnt[OV_AFTER]].histogram);
-        histbuf[OV_AFTER][histcnt[OV_AFTER]].framenumber=FrameNumber;
-        histcnt[OV_AFTER]++;
     }
     lastframenumber=FrameNumber;
     return NULL;
@@ -835,6 +992,7 @@ cMarkAdVideo::cMarkAdVideo(MarkAdContext *maContext)
 
     hborder=new cMarkAdBlackBordersHoriz(maContext);
     vborder=new cMarkAdBlackBordersVert(maContext);
+    blackframe=new cMarkAdBlackFrame(maContext);
     logo = new cMarkAdLogo(maContext);
     overlap = NULL;
     Clear();
@@ -845,10 +1003,45 @@ cMarkAdVideo::~cMarkAdVideo()
     resetmarks();
     if (hborder) delete hborder;
     if (vborder) delete vborder;
+    if (blackframe) delete blackframe;
     if (logo) delete logo;
     if (overlap) delete overlap;
 }
 
+void cMarkAdVideo::SaveState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Put(&aspectratio,sizeof(aspectratio));
+    Ckp->Put(&framelast,sizeof(framelast));
+    Ckp->Put(&framebeforelast,sizeof(framebeforelast));
+    hborder->SaveState(Ckp);
+    vborder->SaveState(Ckp);
+    blackframe->SaveState(Ckp);
+    logo->SaveState(Ckp);
+}
+
+bool cMarkAdVideo::LoadState(cMarkAdCheckpoint *Ckp)
+{
+    Ckp->Get(&aspectratio,sizeof(aspectratio));
+    Ckp->Get(&framelast,sizeof(framelast));
+    Ckp->Get(&framebeforelast,sizeof(framebeforelast));
+    if (!hborder->LoadState(Ckp)) return false;
+    if (!vborder->LoadState(Ckp)) return false;
+    if (!blackframe->LoadState(Ckp)) return false;
+    return logo->LoadState(Ckp);
+}
+
+bool cMarkAdVideo::Equal(cMarkAdVideo *Other)
+{
+    if ((aspectratio.Num!=Other->aspectratio.Num) ||
+            (aspectratio.Den!=Other->aspectratio.Den)) return false;
+    if (framelast!=Other->framelast) return false;
+    if (framebeforelast!=Other->framebeforelast) return false;
+    if (!hborder->Equal(Other->hborder)) return false;
+    if (!vborder->Equal(Other->vborder)) return false;
+    if (!blackframe->Equal(Other->blackframe)) return false;
+    return logo->Equal(Other->logo);
+}
+
 void cMarkAdVideo::Clear()
 {
     aspectratio.Num=0;
@@ -857,6 +1050,7 @@ void cMarkAdVideo::Clear()
     framebeforelast=0;
     if (hborder) hborder->Clear();
     if (vborder) vborder->Clear();
+    if (blackframe) blackframe->Clear();
     if (logo) logo->Clear();
 }
 
@@ -868,7 +1062,7 @@ void cMarkAdVideo::resetmarks()
 bool cMarkAdVideo::addmark(int type, int position, MarkAdAspectRatio *before,
                            MarkAdAspectRatio *after)
 {
-    if (marks.Count>marks.maxCount) return false;
+    if (marks.Count>=marks.maxCount) return false;
     if (before)
     {
         marks.Number[marks.Count].AspectRatioBefore.Num=before->Num;
@@ -904,23 +1098,26 @@ bool cMarkAdVideo::aspectratiochange(MarkAdAspectRatio &a, MarkAdAspectRatio &b,
 
 }
 
-MarkAdPos *cMarkAdVideo::ProcessOverlap(int FrameNumber, int Frames, bool BeforeAd, bool H264)
+MarkAdPos *cMarkAdVideo::ProcessOverlap(const MarkAdFrame *Frame, int Frames, bool BeforeAd, bool H264)
 {
-    if (!FrameNumber) return NULL;
+    if ((!Frame) || (!Frame->FrameNumber)) return NULL;
     if (!overlap) overlap=new cMarkAdOverlap(macontext);
     if (!overlap) return NULL;
 
-    return overlap->Process(FrameNumber, Frames, BeforeAd, H264);
+    TRACE_BEGIN(overlap,Frame->FrameNumber);
+    MarkAdPos *ret=overlap->Process(Frame, Frames, BeforeAd, H264);
+    TRACE_END(overlap,Frame->FrameNumber);
+    return ret;
 }
 
-MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext)
+MarkAdMarks *cMarkAdVideo::Decide(int FrameNumber, int FrameNumberNext, const MarkAdVideoFeatures *Features)
 {
     if ((!FrameNumber) && (!FrameNumberNext)) return NULL;
 
     resetmarks();
 
     int hborderframenumber;
-    int hret=hborder->Process(FrameNumber,&hborderframenumber);
+    int hret=hborder->Decide(FrameNumber,Features,&hborderframenumber);
 
     if ((hret>0) && (hborderframenumber!=-1))
     {
@@ -933,7 +1130,7 @@ MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext)
     }
 
     int vborderframenumber;
-    int vret=vborder->Process(FrameNumber,&vborderframenumber);
+    int vret=vborder->Decide(FrameNumber,Features,&vborderframenumber);
 
     if ((vret>0) && (vborderframenumber!=-1))
     {
@@ -945,10 +1142,24 @@ MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext)
         addmark(MT_VBORDERSTOP,vborderframenumber);
     }
 
+    int blackframenumber;
+    int bret=blackframe->Decide(FrameNumber,Features,&blackframenumber);
+
+    if (bret>0)
+    {
+        addmark(MT_BLACKSTART,blackframenumber);
+    }
+
+    if (bret<0)
+    {
+        addmark(MT_BLACKSTOP,blackframenumber);
+    }
+
     if (!macontext->Video.Options.IgnoreAspectRatio)
     {
         bool start;
-        if (aspectratiochange(macontext->Video.Info.AspectRatio,aspectratio,start))
+        MarkAdAspectRatio actual=Features->AspectRatio;
+        if (aspectratiochange(actual,aspectratio,start))
         {
             if ((logo->Status()==LOGO_VISIBLE) && (!start))
             {
@@ -968,27 +1179,24 @@ MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext)
                 hborder->SetStatusBorderInvisible();
             }
 
-            if ((macontext->Video.Info.AspectRatio.Num==4) &&
-                    (macontext->Video.Info.AspectRatio.Den==3))
+            if ((actual.Num==4) && (actual.Den==3))
             {
                 addmark(MT_ASPECTSTART,start ? FrameNumber : FrameNumberNext,
-                        &aspectratio,&macontext->Video.Info.AspectRatio);
+                        &aspectratio,&actual);
             }
             else
             {
-                addmark(MT_ASPECTSTOP,framelast,&aspectratio,
-                        &macontext->Video.Info.AspectRatio);
+                addmark(MT_ASPECTSTOP,framelast,&aspectratio,&actual);
             }
         }
 
-        aspectratio.Num=macontext->Video.Info.AspectRatio.Num;
-        aspectratio.Den=macontext->Video.Info.AspectRatio.Den;
+        aspectratio=actual;
     }
 
     if (!macontext->Video.Options.IgnoreLogoDetection)
     {
         int logoframenumber;
-        int lret=logo->Process(FrameNumber,&logoframenumber);
+        int lret=logo->Decide(FrameNumber,Features,&logoframenumber);
         if ((lret>=-1) && (lret!=0) && (logoframenumber!=-1))
         {
             if (lret>0)
@@ -1017,3 +1225,45 @@ MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext)
         return NULL;
     }
 }
+
+void cMarkAdVideo::Measure(int FrameNumber, MarkAdVideoFeatures *Features)
+{
+    memset(Features,0,sizeof(*Features));
+    Features->Valid=macontext->Video.Data.Valid;
+    Features->AspectRatio=macontext->Video.Info.AspectRatio;
+    TRACE_BEGIN(hborder,FrameNumber);
+    hborder->Measure(Features);
+    TRACE_END(hborder,FrameNumber);
+    TRACE_BEGIN(vborder,FrameNumber);
+    vborder->Measure(Features);
+    TRACE_END(vborder,FrameNumber);
+    TRACE_BEGIN(blackframe,FrameNumber);
+    blackframe->Measure(Features);
+    TRACE_END(blackframe,FrameNumber);
+    if (macontext->Video.Options.IgnoreLogoDetection)
+    {
+        Features->LogoResult=LOGO_ERROR;
+    }
+    else
+    {
+        TRACE_BEGIN(logo,FrameNumber);
+        logo->Measure(FrameNumber,Features);
+        TRACE_END(logo,FrameNumber);
+    }
+}
+
+MarkAdMarks *cMarkAdVideo::Process(int FrameNumber, int FrameNumberNext, MarkAdVideoFeatures *Features)
+{
+    MarkAdVideoFeatures features;
+    if (!Features) Features=&features;
+    if ((!FrameNumber) && (!FrameNumberNext))
+    {
+        memset(Features,0,sizeof(*Features));
+        return NULL;
+    }
+    Measure(FrameNumber,Features);
+    TRACE_BEGIN(decide,FrameNumber);
+    MarkAdMarks *ret=Decide(FrameNumber,FrameNumberNext,Features);
+    TRACE_END(decide,FrameNumber);
+    return ret;
+}
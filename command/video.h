@@ -9,6 +9,7 @@
 #define __video_h_
 
 #include "global.h"
+#include "checkpoint.h"
 
 #define LOGO_MAXHEIGHT   250
 #define LOGO_MAXWIDTH    480
@@ -18,6 +19,13 @@
 #define LOGO_DEFHDWIDTH  288
 #define LOGO_DEFHDHEIGHT 180
 
+// areas of the border detectors, also used by the normalization
+#define HBORDER_HEIGHT 20  // rows checked at the top and bottom
+#define HBORDER_OFFSET 5   // distance of the rows from the edge
+#define VBORDER_WIDTH 32   // columns checked left and right
+#define VBORDER_OFFSET 50  // distance of the columns from the edge
+#define VBORDER_MARGIN 120 // rows skipped at the top and bottom
+
 #define LOGO_VMAXCOUNT 3  // count of IFrames for detection of "logo visible"
 #define LOGO_IMAXCOUNT 5  // count of IFrames for detection of "logo invisible"
 #define LOGO_VMARK 0.5    // percantage of pixels for visible
@@ -48,10 +56,17 @@ enum
 
 #define MINBORDERSECS 60
 
+// separator frames, measured in the middle of the picture (the logo
+// corners are left out) on every BLACKFRAME_STEP'th row
+#define BLACKFRAME_STEP 4
+#define BLACKFRAME_BRIGHTNESS 32 // max. mean of a black picture
+#define BLACKFRAME_VARIANCE 16   // max. variance of a uniform picture
+
 enum
 {
-    OV_BEFORE=0,
-    OV_AFTER=1
+    BLACKFRAME_UNINITIALIZED=-2,
+    BLACKFRAME_INVISIBLE=-1,
+    BLACKFRAME_VISIBLE=1
 };
 
 class cMarkAdOverlap
@@ -59,15 +74,25 @@ class cMarkAdOverlap
 private:
     MarkAdContext *macontext;
     typedef int simpleHistogram[256];
+    // histogram scaled down to 16 bit, only kept for the frames before the ad
+    typedef unsigned short compactHistogram[256];
 
     typedef struct
     {
         int framenumber;
-        simpleHistogram histogram;
+        compactHistogram histogram;
     } histbuffer;
-    histbuffer *histbuf[2];
-    int histcnt[2];
-    int histframes[2];
+    histbuffer *histbuf;
+    int histcnt;
+    int histframes;
+    int histshift;
+
+    // score of the sequence of similar frames ending with
+    // before frame n and the last frame after the ad
+    int *simcnt;
+    int aftercnt;
+    int afterframes;
+    bool done;
 
     int lastframenumber;
 
@@ -75,14 +100,15 @@ private:
 
     int similarCutOff;
     int similarMaxCnt;
-    bool areSimilar(simpleHistogram &hist1, simpleHistogram &hist2);
-    void getHistogram(simpleHistogram &dest);
-    MarkAdPos *Detect();
+    bool areSimilar(simpleHistogram &hist1, compactHistogram &hist2);
+    void getHistogram(const MarkAdFrame *Frame, simpleHistogram &dest);
+    void compactHist(simpleHistogram &src, compactHistogram &dest);
+    void addResult(int Before, int FrameNumberAfter);
     void Clear();
 public:
     cMarkAdOverlap(MarkAdContext *maContext);
     ~cMarkAdOverlap();
-    MarkAdPos *Process(int FrameNumber, int Frames, bool BeforeAd, bool H264);
+    MarkAdPos *Process(const MarkAdFrame *Frame, int Frames, bool BeforeAd, bool H264);
 };
 
 class cMarkAdLogo
@@ -121,18 +147,22 @@ private:
         bool valid[4];             // logo mask valid?
     } area;
 
-    int GX[3][3];
-    int GY[3][3];
+    // sobel of one plane, selected per pixel format
+    typedef int (*sobelkernel_t)(const uchar *Src, int Linesize, int Width, int Height,
+                                 const uchar *Mask, uchar *Sobel, uchar *Result, int *Intensity);
+    sobelkernel_t kernel[4];
+    int kernelpixfmt;
 
     MarkAdContext *macontext;
     bool pixfmt_info;
+    bool selectKernels();
     int SobelPlane(int plane); // do sobel operation on plane
-    int Detect(int framenumber, int *logoframenumber); // ret 1 = logo, 0 = unknown, -1 = no logo
     int Load(const char *directory, char *file, int plane);
     void Save(int framenumber, uchar picture[4][MAXPIXEL], int plane);
 public:
     cMarkAdLogo(MarkAdContext *maContext);
-    int Process(int FrameNumber, int *LogoFrameNumber);
+    void Measure(int FrameNumber, MarkAdVideoFeatures *Features);
+    int Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *LogoFrameNumber); // ret 1 = logo, 0 = unknown, -1 = no logo
     int Status()
     {
         return area.status;
@@ -148,6 +178,9 @@ public:
             area.status=LOGO_UNINITIALIZED;
     }
     void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdLogo *Other);
 };
 
 class cMarkAdBlackBordersHoriz
@@ -156,9 +189,11 @@ private:
     int borderstatus;
     int borderframenumber;
     MarkAdContext *macontext;
+    int rowsum(int From, int To);
 public:
     cMarkAdBlackBordersHoriz(MarkAdContext *maContext);
-    int Process(int FrameNumber,int *BorderFrameNumber);
+    void Measure(MarkAdVideoFeatures *Features);
+    int Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BorderFrameNumber);
     int Status()
     {
         return borderstatus;
@@ -168,6 +203,9 @@ public:
         borderframenumber=-1;
     }
     void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdBlackBordersHoriz *Other);
 };
 
 class cMarkAdBlackBordersVert
@@ -178,7 +216,8 @@ private:
     MarkAdContext *macontext;
 public:
     cMarkAdBlackBordersVert(MarkAdContext *maContext);
-    int Process(int FrameNumber,int *BorderFrameNumber);
+    void Measure(MarkAdVideoFeatures *Features);
+    int Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BorderFrameNumber);
     int Status()
     {
         return borderstatus;
@@ -188,6 +227,28 @@ public:
         borderframenumber=-1;
     }
     void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdBlackBordersVert *Other);
+};
+
+class cMarkAdBlackFrame
+{
+private:
+    int blackstatus;
+    MarkAdContext *macontext;
+public:
+    cMarkAdBlackFrame(MarkAdContext *maContext);
+    void Measure(MarkAdVideoFeatures *Features);
+    int Decide(int FrameNumber, const MarkAdVideoFeatures *Features, int *BlackFrameNumber);
+    int Status()
+    {
+        return blackstatus;
+    }
+    void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdBlackFrame *Other);
 };
 
 class cMarkAdVideo
@@ -199,6 +260,7 @@ private:
     MarkAdAspectRatio aspectratio;
     cMarkAdBlackBordersHoriz *hborder;
     cMarkAdBlackBordersVert *vborder;
+    cMarkAdBlackFrame *blackframe;
     cMarkAdLogo *logo;
     cMarkAdOverlap *overlap;
 
@@ -213,9 +275,14 @@ private:
 public:
     cMarkAdVideo(MarkAdContext *maContext);
     ~cMarkAdVideo();
-    MarkAdPos *ProcessOverlap(int FrameNumber, int Frames, bool BeforeAd, bool H264);
-    MarkAdMarks *Process(int FrameNumber, int FrameNumberNext);
+    MarkAdPos *ProcessOverlap(const MarkAdFrame *Frame, int Frames, bool BeforeAd, bool H264);
+    void Measure(int FrameNumber, MarkAdVideoFeatures *Features);
+    MarkAdMarks *Decide(int FrameNumber, int FrameNumberNext, const MarkAdVideoFeatures *Features);
+    MarkAdMarks *Process(int FrameNumber, int FrameNumberNext, MarkAdVideoFeatures *Features=NULL);
     void Clear();
+    void SaveState(cMarkAdCheckpoint *Ckp);
+    bool LoadState(cMarkAdCheckpoint *Ckp);
+    bool Equal(cMarkAdVideo *Other);
 };
 
 #endif
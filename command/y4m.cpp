@@ -0,0 +1,315 @@
+/*
+ * y4m.cpp: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y4m.h"
+
+extern "C"
+{
+#include "debug.h"
+}
+
+static int gcd(int a, int b)
+{
+    while (b)
+    {
+        int t=a % b;
+        a=b;
+        b=t;
+    }
+    return a;
+}
+
+cMarkAdY4M::cMarkAdY4M()
+{
+    f=NULL;
+    channel=NULL;
+    for (int i=0; i<3; i++)
+    {
+        plane[i]=NULL;
+        linesize[i]=0;
+    }
+    Close();
+}
+
+cMarkAdY4M::~cMarkAdY4M()
+{
+    Close();
+}
+
+void cMarkAdY4M::Close()
+{
+    if (f)
+    {
+        if ((fclose(f)==EOF) && (writing)) esyslog("failed to write frame dump");
+        f=NULL;
+    }
+    if (channel) free(channel);
+    channel=NULL;
+    for (int i=0; i<3; i++)
+    {
+        if (plane[i]) free(plane[i]);
+        plane[i]=NULL;
+        linesize[i]=0;
+    }
+    writing=false;
+    width=height=0;
+    fpsnum=25;
+    fpsden=1;
+    pixfmt=0;
+    interlaced=false;
+    aspectratio.Num=aspectratio.Den=0;
+    framecnt=0;
+}
+
+bool cMarkAdY4M::Create(const char *File)
+{
+    Close();
+    if (!File) return false;
+    f=fopen(File,"w");
+    if (!f)
+    {
+        esyslog("failed to create %s",File);
+        return false;
+    }
+    writing=true;
+    return true;
+}
+
+bool cMarkAdY4M::Write(MarkAdContext *maContext, int FrameNumber, int FrameNumberNext)
+{
+    if ((!f) || (!writing)) return false;
+    if (!maContext) return false;
+    if (!maContext->Video.Data.Valid) return false;
+    if ((!maContext->Video.Data.Plane[0]) || (!maContext->Video.Data.Plane[1]) ||
+            (!maContext->Video.Data.Plane[2])) return false;
+
+    int w=maContext->Video.Info.Width;
+    int h=maContext->Video.Info.Height;
+    if ((w<=0) || (h<=0)) return false;
+    if (!framecnt)
+    {
+        // stream header, the first frame decides
+        width=w;
+        height=h;
+        double fps=maContext->Video.Info.FramesPerSecond;
+        if (fps>0)
+        {
+            fpsnum=(int) (fps*1000+0.5);
+            fpsden=1000;
+            int g=gcd(fpsnum,fpsden);
+            fpsnum/=g;
+            fpsden/=g;
+        }
+        fprintf(f,"YUV4MPEG2 W%i H%i F%i:%i I%c A0:0 C420jpeg%s",width,height,fpsnum,fpsden,
+                maContext->Video.Info.Interlaced ? 't' : 'p',
+                (maContext->Video.Info.Pix_Fmt==12) ? " XCOLORRANGE=FULL" : "");
+        if (maContext->Info.ChannelName) fprintf(f," XMARKAD_CHANNEL=%s",maContext->Info.ChannelName);
+        fputc('\n',f);
+    }
+    if ((w!=width) || (h!=height))
+    {
+        // a stream has one size
+        esyslog("frame size changed to %ix%i, stopped frame dump",w,h);
+        fclose(f);
+        f=NULL;
+        return false;
+    }
+
+    fprintf(f,"FRAME XMARKAD=%i,%i,%i:%i\n",FrameNumber,FrameNumberNext,
+            maContext->Video.Info.AspectRatio.Num,maContext->Video.Info.AspectRatio.Den);
+    for (int i=0; i<3; i++)
+    {
+        int pw=i ? (width+1)/2 : width;
+        int ph=i ? (height+1)/2 : height;
+        uchar *src=maContext->Video.Data.Plane[i];
+        for (int y=0; y<ph; y++)
+        {
+            if (fwrite(src+y*maContext->Video.Data.PlaneLinesize[i],1,pw,f)!=(size_t) pw)
+            {
+                esyslog("failed to write frame dump");
+                fclose(f);
+                f=NULL;
+                return false;
+            }
+        }
+    }
+    framecnt++;
+    return true;
+}
+
+bool cMarkAdY4M::readline(char *Line, int Size)
+{
+    int len=0;
+    int c;
+    while ((c=fgetc(f))!=EOF)
+    {
+        if (c=='\n')
+        {
+            Line[len]=0;
+            return true;
+        }
+        if (len>=Size-1) return false;
+        Line[len++]=c;
+    }
+    return false;
+}
+
+bool cMarkAdY4M::parseheader(char *Line)
+{
+    if (strncmp(Line,"YUV4MPEG2",9)) return false;
+    int parnum=0,parden=0;
+    char *save=NULL;
+    for (char *tok=strtok_r(Line+9," ",&save); tok; tok=strtok_r(NULL," ",&save))
+    {
+        switch (tok[0])
+        {
+        case 'W':
+            width=atoi(tok+1);
+            break;
+        case 'H':
+            height=atoi(tok+1);
+            break;
+        case 'F':
+            if ((sscanf(tok+1,"%i:%i",&fpsnum,&fpsden)!=2) || (fpsnum<=0) || (fpsden<=0)) return false;
+            break;
+        case 'I':
+            interlaced=(tok[1]!='p');
+            break;
+        case 'A':
+            if (sscanf(tok+1,"%i:%i",&parnum,&parden)!=2) parnum=parden=0;
+            break;
+        case 'C':
+            // 420p10, 420p12 ... are 16 bit per sample
+            if ((strcmp(tok+1,"420")) && (strcmp(tok+1,"420jpeg")) &&
+                    (strcmp(tok+1,"420mpeg2")) && (strcmp(tok+1,"420paldv")))
+            {
+                esyslog("y4m colorspace %s not supported, only 8 bit 4:2:0",tok+1);
+                return false;
+            }
+            break;
+        case 'X':
+            if (!strcmp(tok,"XCOLORRANGE=FULL")) pixfmt=12; // YUVJ420P
+            if (!strncmp(tok,"XMARKAD_CHANNEL=",16))
+            {
+                if (channel) free(channel);
+                channel=strdup(tok+16);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if ((width<=0) || (height<=0)) return false;
+
+    // display aspect, square pixels if unknown
+    if ((parnum<=0) || (parden<=0)) parnum=parden=1;
+    aspectratio.Num=width*parnum;
+    aspectratio.Den=height*parden;
+    int g=gcd(aspectratio.Num,aspectratio.Den);
+    aspectratio.Num/=g;
+    aspectratio.Den/=g;
+    return true;
+}
+
+bool cMarkAdY4M::alloc()
+{
+    // linesize rounded up for the simd loads
+    linesize[0]=(width+15) & ~15;
+    linesize[1]=linesize[2]=(((width+1)/2)+15) & ~15;
+    plane[0]=(uchar *) calloc(linesize[0],height);
+    plane[1]=(uchar *) calloc(linesize[1],(height+1)/2);
+    plane[2]=(uchar *) calloc(linesize[2],(height+1)/2);
+    if ((!plane[0]) || (!plane[1]) || (!plane[2]))
+    {
+        esyslog("out of memory");
+        return false;
+    }
+    return true;
+}
+
+bool cMarkAdY4M::Open(const char *File)
+{
+    Close();
+    if (!File) return false;
+    f=fopen(File,"r");
+    if (!f)
+    {
+        esyslog("failed to open %s",File);
+        return false;
+    }
+    char line[Y4M_MAXLINE];
+    if ((!readline(line,sizeof(line))) || (!parseheader(line)))
+    {
+        esyslog("%s is no YUV4MPEG2 stream",File);
+        Close();
+        return false;
+    }
+    if (!alloc())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+int cMarkAdY4M::Read(MarkAdContext *maContext, int *FrameNumber, int *FrameNumberNext)
+{
+    if ((!f) || (writing)) return -1;
+    if ((!maContext) || (!FrameNumber) || (!FrameNumberNext)) return -1;
+
+    char line[Y4M_MAXLINE];
+    if (!readline(line,sizeof(line))) return feof(f) ? 0 : -1;
+    if (strncmp(line,"FRAME",5)) return -1;
+
+    *FrameNumber=framecnt;
+    *FrameNumberNext=framecnt+1;
+    MarkAdAspectRatio aspect=aspectratio;
+    char *param=strstr(line+5," XMARKAD=");
+    if (param)
+    {
+        int fn,fnext,num,den;
+        if (sscanf(param+9,"%i,%i,%i:%i",&fn,&fnext,&num,&den)==4)
+        {
+            *FrameNumber=fn;
+            *FrameNumberNext=fnext;
+            aspect.Num=num;
+            aspect.Den=den;
+        }
+    }
+
+    for (int i=0; i<3; i++)
+    {
+        int pw=i ? (width+1)/2 : width;
+        int ph=i ? (height+1)/2 : height;
+        for (int y=0; y<ph; y++)
+        {
+            if (fread(plane[i]+y*linesize[i],1,pw,f)!=(size_t) pw) return -1;
+        }
+    }
+
+    maContext->Video.Info.Width=width;
+    maContext->Video.Info.Height=height;
+    maContext->Video.Info.Pix_Fmt=pixfmt;
+    maContext->Video.Info.Pict_Type=MA_I_TYPE;
+    maContext->Video.Info.AspectRatio=aspect;
+    maContext->Video.Info.FramesPerSecond=(double) fpsnum/fpsden;
+    maContext->Video.Info.Interlaced=interlaced;
+    for (int i=0; i<3; i++)
+    {
+        maContext->Video.Data.Plane[i]=plane[i];
+        maContext->Video.Data.PlaneLinesize[i]=linesize[i];
+    }
+    maContext->Video.Data.Plane[3]=NULL;
+    maContext->Video.Data.PlaneLinesize[3]=0;
+    maContext->Video.Data.Valid=true;
+    framecnt++;
+    return 1;
+}
@@ -0,0 +1,62 @@
+/*
+ * y4m.h: A program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __y4m_h_
+#define __y4m_h_
+
+#include <stdio.h>
+
+#include "global.h"
+
+#define Y4M_MAXLINE 1024 // stream and frame header
+
+// --- cMarkAdY4M
+// decoded frames as YUV4MPEG2 (8 bit 4:2:0), the frames the
+// detectors see. Each FRAME header has an XMARKAD=<frame>,<next>,
+// <aspect> parameter with the frame numbers given to
+// cMarkAdVideo::Process and the display aspect ratio, the channel
+// for the logo detection is in the stream header. Streams from
+// other programs are read too, then every frame is an iframe and
+// the aspect ratio comes from the size and the pixel aspect.
+class cMarkAdY4M
+{
+private:
+    FILE *f;
+    bool writing;
+    int width;
+    int height;
+    int fpsnum;
+    int fpsden;
+    int pixfmt;
+    bool interlaced;
+    MarkAdAspectRatio aspectratio;  // of the stream, if frames have none
+    char *channel;
+    uchar *plane[3];
+    int linesize[3];
+    int framecnt;
+    bool readline(char *Line, int Size);
+    bool parseheader(char *Line);
+    bool alloc();
+public:
+    cMarkAdY4M();
+    ~cMarkAdY4M();
+    bool Create(const char *File);
+    bool Open(const char *File);
+    void Close();
+    bool Write(MarkAdContext *maContext, int FrameNumber, int FrameNumberNext);
+    int Read(MarkAdContext *maContext, int *FrameNumber, int *FrameNumberNext); // 1 frame, 0 end, -1 error
+    const char *Channel()
+    {
+        return channel;
+    }
+    int Frames()
+    {
+        return framecnt;
+    }
+};
+
+#endif
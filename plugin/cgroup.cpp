@@ -0,0 +1,149 @@
+/*
+ * cgroup.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdarg.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <vdr/tools.h>
+
+#include "cgroup.h"
+
+cCgroupMarkAd::cCgroupMarkAd(const char *Base)
+{
+    base=NULL;
+    available=false;
+    if (!Base) return;
+
+    if (access(Base,W_OK)==-1)
+    {
+        esyslog("markad: cannot access cgroup %s",Base);
+        return;
+    }
+    // controllers must be enabled for the job cgroups,
+    // io is optional (needs an io scheduler with weights)
+    if (!write(Base,"cgroup.subtree_control","+cpu +io"))
+    {
+        if (!write(Base,"cgroup.subtree_control","+cpu"))
+        {
+            esyslog("markad: cannot enable cpu controller in %s",Base);
+            return;
+        }
+        isyslog("markad: io controller not available in %s",Base);
+    }
+    base=strdup(Base);
+    available=(base!=NULL);
+
+    // remove leftovers from markads which were still alive on removal
+    DIR *dir=opendir(Base);
+    if (!dir) return;
+    struct dirent *dirent;
+    while ((dirent=readdir(dir)))
+    {
+        if (strncmp(dirent->d_name,"markad-",7)) continue;
+        char *buf;
+        if (asprintf(&buf,"%s/%s",Base,dirent->d_name)==-1) continue;
+        rmdir(buf);
+        free(buf);
+    }
+    closedir(dir);
+}
+
+cCgroupMarkAd::~cCgroupMarkAd()
+{
+    if (base) free(base);
+}
+
+char *cCgroupMarkAd::path(pid_t Pid)
+{
+    char *buf;
+    if (asprintf(&buf,"%s/markad-%i",base,(int) Pid)==-1) return NULL;
+    return buf;
+}
+
+bool cCgroupMarkAd::write(const char *Dir, const char *File, const char *format, ...)
+{
+    char *fname;
+    if (asprintf(&fname,"%s/%s",Dir,File)==-1) return false;
+
+    char buf[128];
+    va_list ap;
+    va_start(ap, format);
+    int len=vsnprintf(buf,sizeof(buf),format,ap);
+    va_end(ap);
+
+    bool ret=false;
+    int fd=open(fname,O_WRONLY);
+    if (fd!=-1)
+    {
+        ret=(::write(fd,buf,len)==len);
+        close(fd);
+    }
+    if (!ret) dsyslog("markad: failed to write '%s' to %s (%i)",buf,fname,errno);
+    free(fname);
+    return ret;
+}
+
+bool cCgroupMarkAd::Add(pid_t Pid)
+{
+    if ((!available) || (!Pid)) return false;
+    char *dir=path(Pid);
+    if (!dir) return false;
+    if ((mkdir(dir,0755)==-1) && (errno!=EEXIST))
+    {
+        esyslog("markad: cannot create cgroup %s (%i)",dir,errno);
+        free(dir);
+        return false;
+    }
+    bool ret=write(dir,"cgroup.procs","%i",(int) Pid);
+    if (ret) dsyslog("markad: moved pid %i to %s",(int) Pid,dir);
+    free(dir);
+    return ret;
+}
+
+bool cCgroupMarkAd::Throttle(pid_t Pid, int Level)
+{
+    if ((!available) || (!Pid)) return false;
+    char *dir=path(Pid);
+    if (!dir) return false;
+
+    bool ret;
+    if (Level<=0)
+    {
+        ret=write(dir,"cpu.max","max 100000");
+        write(dir,"cpu.weight","100");
+        write(dir,"io.weight","default 100");
+    }
+    else
+    {
+        // 50% of one cpu with one recording/replay,
+        // shared by all further ones, but at least 10%
+        int quota=50000/Level;
+        if (quota<10000) quota=10000;
+        int weight=20/Level;
+        if (weight<1) weight=1;
+        ret=write(dir,"cpu.max","%i 100000",quota);
+        write(dir,"cpu.weight","%i",weight);
+        write(dir,"io.weight","default %i",weight);
+    }
+    if (ret) dsyslog("markad: throttle level of pid %i set to %i",(int) Pid,Level);
+    free(dir);
+    return ret;
+}
+
+void cCgroupMarkAd::Remove(pid_t Pid)
+{
+    if ((!available) || (!Pid)) return;
+    char *dir=path(Pid);
+    if (!dir) return;
+    if (rmdir(dir)==-1)
+    {
+        // still populated, markad is not gone yet
+        if (errno!=ENOENT) dsyslog("markad: cannot remove cgroup %s (%i)",dir,errno);
+    }
+    free(dir);
+}
@@ -0,0 +1,34 @@
+/*
+ * cgroup.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+#ifndef __cgroup_h_
+#define __cgroup_h_
+
+#include <sys/types.h>
+
+// --- cCgroupMarkAd
+// every markad gets its own cgroup (v2) below Base, instead of stopping
+// markad with SIGTSTP its cpu/io share is lowered
+class cCgroupMarkAd
+{
+private:
+    char *base;
+    bool available;
+    char *path(pid_t Pid);
+    bool write(const char *Dir, const char *File, const char *format, ...) __attribute__ ((format (printf, 4, 5)));
+public:
+    cCgroupMarkAd(const char *Base);
+    ~cCgroupMarkAd();
+    bool Available()
+    {
+        return available;
+    }
+    bool Add(pid_t Pid);
+    bool Throttle(pid_t Pid, int Level);
+    void Remove(pid_t Pid);
+};
+
+#endif
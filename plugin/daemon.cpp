@@ -0,0 +1,403 @@
+/*
+ * daemon.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdarg.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vdr/tools.h>
+
+#include "daemon.h"
+
+#define STATINTERVAL 2 // seconds between the STAT of the jobs
+
+cDaemonMarkAd::cDaemonMarkAd(const char *BinDir, const char *LogoDir, struct setup *Setup):cThread("markad daemon client")
+{
+    bindir=BinDir;
+    logodir=LogoDir;
+    setup=Setup;
+    memset(&jobs,0,sizeof(jobs));
+    memset(&requests,0,sizeof(requests));
+    requestcnt=0;
+    pid=0;
+    if (pipe2(wakeup,O_CLOEXEC|O_NONBLOCK)==-1) wakeup[0]=wakeup[1]=-1;
+}
+
+cDaemonMarkAd::~cDaemonMarkAd()
+{
+    cThread::Cancel(-1);
+    if (wakeup[1]!=-1)
+    {
+        if (write(wakeup[1],"x",1)) {};
+    }
+    cThread::Cancel(3);
+    for (int i=0; i<DAEMON_MAXJOBS; i++) forget(&jobs[i]);
+    for (int i=0; i<requestcnt; i++)
+    {
+        free(requests[i].Line);
+        if (requests[i].FileName) free(requests[i].FileName);
+    }
+    if (wakeup[0]!=-1) close(wakeup[0]);
+    if (wakeup[1]!=-1) close(wakeup[1]);
+}
+
+int cDaemonMarkAd::connect()
+{
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    strncpy(addr.sun_path,setup->SocketPath,sizeof(addr.sun_path)-1);
+
+    int fd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+    if (fd==-1) return -1;
+    if (::connect(fd,(struct sockaddr *) &addr,sizeof(addr))==-1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool cDaemonMarkAd::spawn()
+{
+    cString cmd = cString::sprintf("\"%s\"/markad -b %s%s --daemon=\"%s\" -l \"%s\"",
+                                   bindir,
+                                   setup->Verbose ? " -v " : "",
+#if VDRVERSNUM < 10715
+                                   setup->OSDMessage ? " --svdrpport=2001 " : "",
+#else
+                                   setup->OSDMessage ? " --svdrpport=6419 " : "",
+#endif
+                                   setup->SocketPath,logodir);
+    if (SystemExec(cmd)==-1) return false;
+    dsyslog("markad: executing %s",*cmd);
+
+    // wait till the daemon listens
+    for (int i=0; i<50; i++)
+    {
+        int fd=connect();
+        if (fd!=-1)
+        {
+            close(fd);
+            return true;
+        }
+        usleep(100000);
+    }
+    esyslog("markad: daemon not listening on %s",setup->SocketPath);
+    return false;
+}
+
+int cDaemonMarkAd::command(char *Reply, int ReplySize, const char *format, ...)
+{
+    if (Reply) *Reply=0;
+    int fd=connect();
+    if (fd==-1) return -1;
+
+    char buf[2048];
+    va_list ap;
+    va_start(ap, format);
+    int len=vsnprintf(buf,sizeof(buf)-1,format,ap);
+    va_end(ap);
+    if ((len<0) || (len>=(int) sizeof(buf)-1))
+    {
+        close(fd);
+        return -1;
+    }
+    buf[len++]='\n';
+    if (send(fd,buf,len,MSG_NOSIGNAL)!=len)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // read till the last line of the reply ("250 ...", not "250-...")
+    int code=-1;
+    len=0;
+    for (;;)
+    {
+        struct pollfd fds;
+        fds.fd=fd;
+        fds.events=POLLIN;
+        fds.revents=0;
+        if (poll(&fds,1,2000)<=0) break;
+        int ret=read(fd,buf+len,sizeof(buf)-len-1);
+        if (ret<=0) break;
+        len+=ret;
+        buf[len]=0;
+        char *line=buf,*lf;
+        while ((lf=strchr(line,'\n')))
+        {
+            *lf=0;
+            if ((strlen(line)>=4) && (line[3]==' '))
+            {
+                code=atoi(line);
+                if (Reply) strn0cpy(Reply,line+4,ReplySize);
+                close(fd);
+                return code;
+            }
+            line=lf+1;
+        }
+        len-=(line-buf);
+        memmove(buf,line,len);
+        if (len>=(int) sizeof(buf)-1) break;
+    }
+    close(fd);
+    return code;
+}
+
+struct cDaemonMarkAd::job *cDaemonMarkAd::get(const char *FileName)
+{
+    for (int i=0; i<DAEMON_MAXJOBS; i++)
+    {
+        if ((jobs[i].FileName) && (!strcmp(jobs[i].FileName,FileName))) return &jobs[i];
+    }
+    return NULL;
+}
+
+void cDaemonMarkAd::forget(struct job *Job)
+{
+    if (Job->FileName) free(Job->FileName);
+    memset(Job,0,sizeof(*Job));
+}
+
+bool cDaemonMarkAd::request(const char *FileName, const char *format, ...)
+{
+    if (wakeup[0]==-1) return false;
+    char *line;
+    va_list ap;
+    va_start(ap, format);
+    int len=vasprintf(&line,format,ap);
+    va_end(ap);
+    if (len==-1) return false;
+
+    mutex.Lock();
+    bool ret=(requestcnt<DAEMON_MAXREQUESTS);
+    if (ret)
+    {
+        requests[requestcnt].Line=line;
+        requests[requestcnt].FileName=FileName ? strdup(FileName) : NULL;
+        requestcnt++;
+    }
+    mutex.Unlock();
+    if (!ret)
+    {
+        esyslog("markad: too many requests, dropping \"%s\"",line);
+        free(line);
+        return false;
+    }
+    if (!Active()) Start();
+    if (write(wakeup[1],"x",1)) {};
+    return true;
+}
+
+void cDaemonMarkAd::process(struct request *Request)
+{
+    char reply[256];
+    int code=command(reply,sizeof(reply),"%s",Request->Line);
+    if (code==-1)
+    {
+        setpid(0);
+        // only a new job is worth starting the daemon
+        if ((Request->FileName) && (spawn())) code=command(reply,sizeof(reply),"%s",Request->Line);
+    }
+    if (!Request->FileName) return;
+    if (code==250)
+    {
+        dsyslog("markad: job %s for %s",reply,Request->FileName);
+    }
+    else
+    {
+        esyslog("markad: daemon refused %s: %s",Request->FileName,reply);
+    }
+    mutex.Lock();
+    struct job *job=get(Request->FileName);
+    if (job)
+    {
+        job->Pending=false;
+        if (code!=250) job->State=0;
+    }
+    mutex.Unlock();
+}
+
+void cDaemonMarkAd::query()
+{
+    // the job may be forgotten while we ask, so look for it again
+    for (int i=0; i<DAEMON_MAXJOBS; i++)
+    {
+        mutex.Lock();
+        char *filename=NULL;
+        if ((jobs[i].FileName) && (!jobs[i].Pending) && (jobs[i].State)) filename=strdup(jobs[i].FileName);
+        mutex.Unlock();
+        if (!filename) continue;
+
+        // map job state to the process state letters used in the menu
+        char reply[2048];
+        char state=0;
+        int code=command(reply,sizeof(reply),"STAT %s",filename);
+        if (code==-1)
+        {
+            setpid(0);
+        }
+        else if (code==250)
+        {
+            char st[16];
+            if (sscanf(reply,"%*d %15s",st)==1)
+            {
+                if (!strcmp(st,"queued")) state='S';
+                if (!strcmp(st,"paused")) state='T';
+                if (!strcmp(st,"running")) state='R';
+            }
+        }
+        mutex.Lock();
+        struct job *job=get(filename);
+        if ((job) && (!job->Pending)) job->State=state;
+        mutex.Unlock();
+        free(filename);
+    }
+}
+
+void cDaemonMarkAd::Action()
+{
+    time_t laststat=0;
+    while (Running())
+    {
+        struct pollfd fds;
+        fds.fd=wakeup[0];
+        fds.events=POLLIN;
+        fds.revents=0;
+        if ((poll(&fds,1,STATINTERVAL*1000)==-1) && (errno!=EINTR))
+        {
+            esyslog("markad: poll failed (%i)",errno);
+            cCondWait::SleepMs(1000);
+        }
+        if (fds.revents & POLLIN)
+        {
+            char buf[64];
+            while (read(wakeup[0],buf,sizeof(buf))>0);
+        }
+
+        bool sent=false;
+        while (Running())
+        {
+            struct request req;
+            mutex.Lock();
+            bool got=(requestcnt>0);
+            if (got)
+            {
+                req=requests[0];
+                requestcnt--;
+                memmove(&requests[0],&requests[1],requestcnt*sizeof(struct request));
+            }
+            mutex.Unlock();
+            if (!got) break;
+            process(&req);
+            free(req.Line);
+            if (req.FileName) free(req.FileName);
+            sent=true;
+        }
+        if (!Running()) break;
+
+        mutex.Lock();
+        bool known=false;
+        for (int i=0; i<DAEMON_MAXJOBS; i++)
+        {
+            if ((jobs[i].FileName) && (!jobs[i].Pending) && (jobs[i].State)) known=true;
+        }
+        mutex.Unlock();
+        if (!known) continue;
+
+        if (!Pid())
+        {
+            char reply[64];
+            if (command(reply,sizeof(reply),"PID")==250) setpid((pid_t) atoi(reply));
+        }
+        // at once after a change, the menu shows it
+        time_t now=time(NULL);
+        if ((sent) || (now>=laststat+STATINTERVAL))
+        {
+            laststat=now;
+            query();
+        }
+    }
+}
+
+bool cDaemonMarkAd::Enqueue(const char *FileName, int Priority, const char *Flags)
+{
+    if (!FileName) return false;
+    mutex.Lock();
+    struct job *job=get(FileName);
+    for (int i=0; (!job) && (i<DAEMON_MAXJOBS); i++)
+    {
+        if (!jobs[i].FileName) job=&jobs[i];
+    }
+    if (job)
+    {
+        forget(job);
+        job->FileName=strdup(FileName);
+        job->State='S';
+        job->Pending=true;
+    }
+    bool ret=((job) && (job->FileName));
+    mutex.Unlock();
+    if (!ret) return false;
+    // jobs started by hand are preferred
+    return request(FileName,"ENQUEUE %i %s %s",Priority,(Flags && *Flags) ? Flags : "-",FileName);
+}
+
+bool cDaemonMarkAd::Cancel(const char *FileName)
+{
+    Forget(FileName);
+    return request(NULL,"CANCEL %s",FileName);
+}
+
+bool cDaemonMarkAd::Pause(const char *FileName, bool Pause)
+{
+    return request(NULL,"%s %s",Pause ? "PAUSE" : "CONTINUE",FileName);
+}
+
+void cDaemonMarkAd::Forget(const char *FileName)
+{
+    if (!FileName) return;
+    cMutexLock lock(&mutex);
+    struct job *job=get(FileName);
+    if (job) forget(job);
+}
+
+char cDaemonMarkAd::Status(const char *FileName)
+{
+    // called from the main thread, just the last known state
+    if (!FileName) return 0;
+    cMutexLock lock(&mutex);
+    struct job *job=get(FileName);
+    return job ? job->State : 0;
+}
+
+void cDaemonMarkAd::setpid(pid_t Pid)
+{
+    cMutexLock lock(&mutex);
+    pid=Pid;
+}
+
+pid_t cDaemonMarkAd::Pid()
+{
+    // 0 till the daemon has answered
+    cMutexLock lock(&mutex);
+    return pid;
+}
+
+void cDaemonMarkAd::Shutdown()
+{
+    // when vdr ends, waiting is allowed here
+    cThread::Cancel(-1);
+    if (wakeup[1]!=-1)
+    {
+        if (write(wakeup[1],"x",1)) {};
+    }
+    cThread::Cancel(3);
+    command(NULL,0,"SHUTDOWN");
+}
@@ -0,0 +1,71 @@
+/*
+ * daemon.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+#ifndef __daemon_h_
+#define __daemon_h_
+
+#include <sys/types.h>
+#include <vdr/thread.h>
+#include <vdr/device.h>
+
+#include "setup.h"
+
+#define DEF_SOCKET "markad.socket" // in the cache directory of the plugin
+
+#define DAEMON_MAXJOBS (MAXDEVICES*MAXRECEIVERS)
+#define DAEMON_MAXREQUESTS 64
+
+// --- cDaemonMarkAd
+// client for the markad daemon (markad --daemon). The socket is only
+// used in a thread: the requests of the main thread are queued and sent
+// there, the daemon is started there if it doesn't answer and the state
+// of the jobs is asked for every few seconds. The main thread reads the
+// states with Status and never waits for the daemon.
+class cDaemonMarkAd : public cThread
+{
+private:
+    struct job
+    {
+        char *FileName;
+        char State;                // like Status, 0 if done or refused
+        bool Pending;              // ENQUEUE not answered yet
+    } jobs[DAEMON_MAXJOBS];
+    struct request
+    {
+        char *Line;
+        char *FileName;            // of an ENQUEUE
+    } requests[DAEMON_MAXREQUESTS];
+    int requestcnt;
+    pid_t pid;
+    cMutex mutex;
+    int wakeup[2];
+    const char *bindir;
+    const char *logodir;
+    struct setup *setup;
+    int connect();
+    bool spawn();
+    int command(char *Reply, int ReplySize, const char *format, ...) __attribute__ ((format (printf, 4, 5)));
+    bool request(const char *FileName, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+    struct job *get(const char *FileName);
+    void forget(struct job *Job);
+    void process(struct request *Request);
+    void query();
+    void setpid(pid_t Pid);
+protected:
+    virtual void Action();
+public:
+    cDaemonMarkAd(const char *BinDir, const char *LogoDir, struct setup *Setup);
+    ~cDaemonMarkAd();
+    bool Enqueue(const char *FileName, int Priority, const char *Flags);
+    bool Cancel(const char *FileName);
+    bool Pause(const char *FileName, bool Pause=true);
+    void Forget(const char *FileName);
+    char Status(const char *FileName);
+    pid_t Pid();
+    void Shutdown();
+};
+
+#endif
@@ -26,6 +26,8 @@ cPluginMarkAd::cPluginMarkAd(void)
     statusMonitor=NULL;
     bindir=strdup(DEF_BINDIR);
     logodir=strdup(DEF_LOGODIR);
+    socketpath=NULL;
+    cgroupdir=NULL;
     title[0]=0;
 
     setup.ProcessDuring=true;
@@ -41,6 +43,10 @@ cPluginMarkAd::cPluginMarkAd(void)
     setup.LogoOnly=true;
     setup.SaveInfo=false;
     setup.DeferredShutdown=true;
+    setup.Daemon=false;
+    setup.PauseMode=0;
+    setup.MaxJobs=0;
+    setup.LiveStream=false;
 }
 
 cPluginMarkAd::~cPluginMarkAd()
@@ -49,6 +55,8 @@ cPluginMarkAd::~cPluginMarkAd()
     if (statusMonitor) delete statusMonitor;
     if (bindir) free(bindir);
     if (logodir) free(logodir);
+    if (socketpath) free(socketpath);
+    if (cgroupdir) free(cgroupdir);
 }
 
 const char *cPluginMarkAd::CommandLineHelp(void)
@@ -57,7 +65,12 @@ const char *cPluginMarkAd::CommandLineHelp(void)
     return "  -b DIR,   --bindir=DIR        use DIR as location for markad executable\n"
            "                                (default: /usr/bin)\n"
            "  -l DIR    --logocachedir=DIR  use DIR as location for markad logos\n"
-           "                                (default: /var/lib/markad)\n";
+           "                                (default: /var/lib/markad)\n"
+           "  -s FILE   --socket=FILE       use FILE as socket of the markad daemon\n"
+           "                                (default: " DEF_SOCKET " in the cache\n"
+           "                                directory of the plugin)\n"
+           "  -c DIR    --cgroup=DIR        use cgroup (v2) DIR to throttle markad\n"
+           "                                instead of stopping it\n";
 }
 
 bool cPluginMarkAd::ProcessArgs(int argc, char *argv[])
@@ -68,11 +81,13 @@ bool cPluginMarkAd::ProcessArgs(int argc, char *argv[])
         { "bindir",      required_argument, NULL, 'b'
         },
         { "logocachedir",      required_argument, NULL, 'l'},
+        { "socket",      required_argument, NULL, 's'},
+        { "cgroup",      required_argument, NULL, 'c'},
         { NULL, 0, NULL, 0 }
     };
 
     int c;
-    while ((c = getopt_long(argc, argv, "b:l:", long_options, NULL)) != -1)
+    while ((c = getopt_long(argc, argv, "b:l:s:c:", long_options, NULL)) != -1)
     {
         switch (c)
         {
@@ -103,6 +118,25 @@ bool cPluginMarkAd::ProcessArgs(int argc, char *argv[])
                 return false;
             }
             break;
+
+        case 's':
+            if (socketpath) free(socketpath);
+            socketpath=strdup(optarg);
+            break;
+
+        case 'c':
+            if ((access(optarg,W_OK))!=-1)
+            {
+                if (cgroupdir) free(cgroupdir);
+                cgroupdir=strdup(optarg);
+            }
+            else
+            {
+                fprintf(stderr,"markad: can't access cgroup directory: %s\n",
+                        optarg);
+                return false;
+            }
+            break;
         default:
             return false;
         }
@@ -124,6 +158,21 @@ bool cPluginMarkAd::Initialize(void)
     }
     free(path);
 
+    if (!socketpath)
+    {
+        // a private directory, not /tmp where others can take the name
+#if APIVERSNUM >= 10730
+        const char *dir=CacheDirectory(PLUGIN_NAME_I18N);
+#else
+        const char *dir=ConfigDirectory(PLUGIN_NAME_I18N);
+#endif
+        if ((!dir) || (asprintf(&socketpath,"%s/%s",dir,DEF_SOCKET)==-1))
+        {
+            esyslog("markad: no directory for the socket");
+            socketpath=NULL;
+            return false;
+        }
+    }
     return true;
 }
 
@@ -133,6 +182,8 @@ bool cPluginMarkAd::Start(void)
     lastcheck=0;
     setup.PluginName=Name();
     setup.LogoDir=logodir;
+    setup.SocketPath=socketpath;
+    setup.CgroupDir=cgroupdir;
     statusMonitor = new cStatusMarkAd(bindir,logodir,&setup);
     return (statusMonitor!=NULL);
 }
@@ -151,6 +202,7 @@ void cPluginMarkAd::MainThreadHook(void)
 {
     // Perform actions in the context of the main program thread.
     // WARNING: Use with great care - see PLUGINS.html!
+    statusMonitor->Events();
     time_t now=time(NULL);
     if (now>(lastcheck+5))
     {
@@ -201,6 +253,10 @@ bool cPluginMarkAd::SetupParse(const char *Name, const char *Value)
     else if (!strcasecmp(Name,"LogoOnly")) setup.LogoOnly=atoi(Value);
     else if (!strcasecmp(Name,"SaveInfo")) setup.SaveInfo=atoi(Value);
     else if (!strcasecmp(Name,"DeferredShutdown")) setup.DeferredShutdown=atoi(Value);
+    else if (!strcasecmp(Name,"Daemon")) setup.Daemon=atoi(Value);
+    else if (!strcasecmp(Name,"PauseMode")) setup.PauseMode=atoi(Value);
+    else if (!strcasecmp(Name,"MaxJobs")) setup.MaxJobs=atoi(Value);
+    else if (!strcasecmp(Name,"LiveStream")) setup.LiveStream=atoi(Value);
     else return false;
     return true;
 }
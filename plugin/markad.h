@@ -23,6 +23,8 @@ private:
     cStatusMarkAd *statusMonitor;
     char *bindir;
     char *logodir;
+    char *socketpath;
+    char *cgroupdir;
     struct setup setup;
     char title[80];
     time_t lastcheck;
@@ -5,7 +5,6 @@
  *
  */
 
-#include <signal.h>
 #include <vdr/menu.h>
 #include <vdr/font.h>
 
@@ -34,13 +33,32 @@ cOsdMarkAd::cOsdMarkAd(struct recs *Entry)
     case 'T':
         status=tr("stopped");
         break;
+    case 'Q':
+        status=tr("queued");
+        break;
     default:
         status=tr("unknown");
         break;
     }
 
+    MarkAdProgress progress;
     char *buf=NULL;
-    if (asprintf(&buf,"%s\t %s",entry->Name ? entry->Name : entry->FileName,status)!=-1)
+    int ret;
+    if ((entry->Progress) && (entry->Progress->Get(&progress)) && (progress.Pass>0))
+    {
+        char eta[32]="";
+        if (progress.Eta>=0) snprintf(eta,sizeof(eta),", %i:%02i %s",progress.Eta/60,
+                                          progress.Eta%60,tr("left"));
+        ret=asprintf(&buf,"%s\t %s %i%% (%s %i, %i fps, %.1f MB/s%s)",
+                     entry->Name ? entry->Name : entry->FileName,status,progress.Percent,
+                     tr("pass"),progress.Pass,progress.FramesPerSecond,
+                     progress.KBytesPerSecond/1024.0,eta);
+    }
+    else
+    {
+        ret=asprintf(&buf,"%s\t %s",entry->Name ? entry->Name : entry->FileName,status);
+    }
+    if (ret!=-1)
     {
         SetText(buf,true);
         free(buf);
@@ -162,11 +180,9 @@ eOSState cMenuMarkAd::ProcessKey(eKeys Key)
         if ((osd) && (osd->Selectable()))
         {
             struct recs *entry=osd->GetEntry();
-            if ((entry) && (entry->Pid) && (entry->Status!='T'))
+            if ((entry) && ((entry->Pid) || (entry->Daemon)) && (entry->Status!='T'))
             {
-                dsyslog("sending TSTP to %i",entry->Pid);
-                kill(entry->Pid,SIGTSTP);
-                entry->ChangedbyUser=true;
+                status->Suspend(entry);
                 SetHelp(NULL,tr("Continue"));
             }
         }
@@ -177,11 +193,9 @@ eOSState cMenuMarkAd::ProcessKey(eKeys Key)
         if ((osd) && (osd->Selectable()))
         {
             struct recs *entry=osd->GetEntry();
-            if ((entry) && (entry->Pid))
+            if ((entry) && ((entry->Pid) || (entry->Daemon)))
             {
-                dsyslog("sending CONT to %i",entry->Pid);
-                kill(entry->Pid,SIGCONT);
-                entry->ChangedbyUser=true;
+                status->Resume(entry);
                 SetHelp(tr("Pause"),NULL);
             }
         }
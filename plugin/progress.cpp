@@ -0,0 +1,83 @@
+/*
+ * progress.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vdr/tools.h>
+
+#include "progress.h"
+
+cProgressMarkAd::cProgressMarkAd(const char *FileName)
+{
+    rec=NULL;
+    if (asprintf(&filename,"%s/%s",FileName,PROGRESS_FILE)==-1) filename=NULL;
+}
+
+cProgressMarkAd::~cProgressMarkAd()
+{
+    unmap();
+    if (filename) free(filename);
+}
+
+void cProgressMarkAd::unmap()
+{
+    if (rec) munmap((void *) rec,sizeof(*rec));
+    rec=NULL;
+}
+
+bool cProgressMarkAd::Get(MarkAdProgress *Progress)
+{
+    if (!Progress) return false;
+    if (!filename) return false;
+    if (!rec)
+    {
+        // markad renames the complete file to its name
+        int fd=open(filename,O_RDONLY|O_CLOEXEC);
+        if (fd==-1) return false;
+        struct stat statbuf;
+        void *map=MAP_FAILED;
+        if ((fstat(fd,&statbuf)!=-1) && (statbuf.st_size>=(off_t) sizeof(MarkAdProgress)))
+            map=mmap(NULL,sizeof(MarkAdProgress),PROT_READ,MAP_SHARED,fd,0);
+        close(fd);
+        if (map==MAP_FAILED) return false;
+        rec=(const MarkAdProgress *) map;
+        if ((rec->Magic!=PROGRESS_MAGIC) || (rec->Version!=PROGRESS_VERSION))
+        {
+            unmap();
+            return false;
+        }
+    }
+
+    // copy while markad doesn't write, give up if it's too busy
+    for (int i=0; i<10; i++)
+    {
+        unsigned int seq=rec->Seq;
+        __sync_synchronize();
+        if (seq & 1) continue;
+        memcpy(Progress,(const void *) rec,sizeof(*Progress));
+        __sync_synchronize();
+        if (rec->Seq!=seq) continue;
+        if (Progress->Pass==-1)
+        {
+            // this markad is gone, the next one creates a new file
+            unmap();
+            return false;
+        }
+        if ((time(NULL)-Progress->Updated>=PROGRESS_STALE) &&
+                (kill((pid_t) Progress->Pid,0)==-1) && (errno==ESRCH))
+        {
+            // markad crashed or was killed before it could finish the record
+            unmap();
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+/*
+ * progress.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+#ifndef __progress_h_
+#define __progress_h_
+
+#include <stdint.h>
+
+#include "progressrec.h"
+
+#define PROGRESS_STALE 10 // seconds without update until markad is looked for
+
+// --- cProgressMarkAd
+// reads the progress markad publishes in the recording directory,
+// the file is mapped once, reading it needs no system call as long as
+// markad updates it
+class cProgressMarkAd
+{
+private:
+    char *filename;
+    const MarkAdProgress *rec;
+    void unmap();
+public:
+    cProgressMarkAd(const char *FileName);
+    ~cProgressMarkAd();
+    bool Get(MarkAdProgress *Progress);
+};
+
+#endif
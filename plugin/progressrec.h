@@ -0,0 +1 @@
+../progressrec.h
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*
+ * receiver.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <vdr/tools.h>
+
+#include "receiver.h"
+
+cReceiverMarkAd::cReceiverMarkAd(const cChannel *Channel, const char *FileName)
+        :cReceiver(Channel)
+{
+    ring=NULL;
+    name[0]=0;
+    if (!markad_ring_name(FileName,name,sizeof(name)))
+    {
+        name[0]=0;
+        return;
+    }
+
+    int fd=shm_open(name,O_RDWR|O_CREAT|O_TRUNC,0600);
+    if (fd==-1)
+    {
+        esyslog("markad: cannot create %s (%i)",name,errno);
+        name[0]=0;
+        return;
+    }
+    if (ftruncate(fd,sizeof(struct markad_ring))==-1)
+    {
+        esyslog("markad: cannot resize %s (%i)",name,errno);
+        close(fd);
+        shm_unlink(name);
+        name[0]=0;
+        return;
+    }
+    void *p=mmap(NULL,sizeof(struct markad_ring),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED)
+    {
+        esyslog("markad: cannot map %s (%i)",name,errno);
+        shm_unlink(name);
+        name[0]=0;
+        return;
+    }
+    ring=(struct markad_ring *) p;
+    ring->size=MARKAD_RING_SIZE;
+    __sync_synchronize();
+    ring->magic=MARKAD_RING_MAGIC;
+    dsyslog("markad: live stream %s for %s",name,FileName);
+}
+
+cReceiverMarkAd::~cReceiverMarkAd()
+{
+    Detach();
+    if (ring)
+    {
+        __sync_synchronize();
+        ring->flags|=MARKAD_RING_DONE;
+        munmap(ring,sizeof(struct markad_ring));
+    }
+    // markad keeps its mapping
+    if (name[0]) shm_unlink(name);
+}
+
+#if APIVERSNUM >= 20104
+void cReceiverMarkAd::Receive(const uchar *Data, int Length)
+#else
+void cReceiverMarkAd::Receive(uchar *Data, int Length)
+#endif
+{
+    if (!ring) return;
+    if ((uint32_t) Length>ring->size) return;
+
+    // we never wait for markad, if it is too slow
+    // it has to continue from disk
+    uint64_t head=ring->head;
+    if ((ring->attached) && (head+Length-ring->tail>ring->size))
+    {
+        ring->attached=0;
+        __sync_synchronize();
+    }
+
+    int pos=head % ring->size;
+    int len=ring->size-pos;
+    if (len>Length) len=Length;
+    memcpy(ring->data+pos,Data,len);
+    if (len<Length) memcpy(ring->data,Data+len,Length-len);
+    __sync_synchronize();
+    ring->head=head+Length;
+}
@@ -0,0 +1,36 @@
+/*
+ * receiver.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+#ifndef __receiver_h_
+#define __receiver_h_
+
+#include <vdr/receiver.h>
+#include "ring.h"
+
+// --- cReceiverMarkAd
+// passes the TS packets of a live recording to markad through a shared
+// memory ring, so markad doesn't have to read them again from disk
+class cReceiverMarkAd : public cReceiver
+{
+private:
+    struct markad_ring *ring;
+    char name[64];
+protected:
+#if APIVERSNUM >= 20104
+    virtual void Receive(const uchar *Data, int Length);
+#else
+    virtual void Receive(uchar *Data, int Length);
+#endif
+public:
+    cReceiverMarkAd(const cChannel *Channel, const char *FileName);
+    virtual ~cReceiverMarkAd();
+    bool Ok()
+    {
+        return (ring!=NULL);
+    }
+};
+
+#endif
@@ -24,11 +24,18 @@ cSetupMarkAd::cSetupMarkAd(struct setup *Setup)
     logoonly=setup->LogoOnly;
     saveinfo=setup->SaveInfo;
     deferredshutdown=setup->DeferredShutdown;
+    usedaemon=setup->Daemon;
+    pausemode=setup->PauseMode;
+    maxjobs=setup->MaxJobs;
+    livestream=setup->LiveStream;
 
     processTexts[0]=tr("after");
     processTexts[1]=tr("during");
     processTexts[2]=tr("never");
 
+    pauseTexts[0]=tr("stop");
+    pauseTexts[1]=tr("throttle");
+
     lpos=0;
 
     write();
@@ -46,10 +53,14 @@ void cSetupMarkAd::write(void)
         {
             Add(new cMenuEditBoolItem(tr("  during another recording"),&whilerecording));
             Add(new cMenuEditBoolItem(tr("  while replaying"),&whilereplaying));
+            if (setup->CgroupDir) Add(new cMenuEditStraItem(tr("  pause method"),&pausemode,2,pauseTexts));
         }
         Add(new cMenuEditBoolItem(tr("scan only channels with logo"),&logoonly),true);
         lpos=Current();
         Add(new cMenuEditBoolItem(tr("deferred shutdown"),&deferredshutdown));
+        Add(new cMenuEditBoolItem(tr("use markad daemon"),&usedaemon));
+        Add(new cMenuEditIntItem(tr("max. concurrent jobs"),&maxjobs,0,16,tr("unlimited")));
+        Add(new cMenuEditBoolItem(tr("read live recordings from vdr"),&livestream));
         Add(new cMenuEditBoolItem(tr("ignore timer margins"),&nomargins));
         Add(new cMenuEditBoolItem(tr("detect overlaps"),&secondpass));
         Add(new cMenuEditBoolItem(tr("recreate index"),&genindex));
@@ -130,6 +141,10 @@ void cSetupMarkAd::Store(void)
     SetupStore("LogoOnly",logoonly);
     SetupStore("SaveInfo",saveinfo);
     SetupStore("DeferredShutdown",deferredshutdown);
+    SetupStore("Daemon",usedaemon);
+    SetupStore("PauseMode",pausemode);
+    SetupStore("MaxJobs",maxjobs);
+    SetupStore("LiveStream",livestream);
 
     setup->ProcessDuring=(int) processduring;
     setup->whileRecording=(bool) whilerecording;
@@ -141,6 +156,10 @@ void cSetupMarkAd::Store(void)
     setup->NoMargins=(bool) nomargins;
     setup->HideMainMenuEntry=(bool) hidemainmenuentry;
     setup->DeferredShutdown=(bool) deferredshutdown;
+    setup->Daemon=(bool) usedaemon;
+    setup->PauseMode=pausemode;
+    setup->MaxJobs=maxjobs;
+    setup->LiveStream=(bool) livestream;
     setup->Log2Rec=log2rec;
     setup->LogoOnly=logoonly;
     setup->SaveInfo=saveinfo;
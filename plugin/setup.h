@@ -24,7 +24,13 @@ struct setup
     bool Log2Rec;
     bool LogoOnly;
     bool DeferredShutdown;
+    bool Daemon;
+    int PauseMode;
+    int MaxJobs; // concurrent markad processes, 0 unlimited
+    bool LiveStream;
     const char *LogoDir;
+    const char *SocketPath;
+    const char *CgroupDir;
     const char *PluginName;
 };
 
@@ -32,6 +38,7 @@ class cSetupMarkAd : public cMenuSetupPage
 {
 private:
     const char *processTexts[3];
+    const char *pauseTexts[2];
     struct setup *setup;
     int processduring;
     int whilerecording;
@@ -46,6 +53,10 @@ private:
     int logoonly;
     int saveinfo;
     int deferredshutdown;
+    int usedaemon;
+    int pausemode;
+    int maxjobs;
+    int livestream;
     void write(void);
     int lpos;
 protected:
@@ -6,16 +6,27 @@
  */
 
 #include <signal.h>
+#include <unistd.h>
 
 #include "status.h"
 
+#define MAXPRESSURE 40 // percent of time runnable tasks waited for a cpu
+#define ADMITDELAY 15 // seconds until the pressure shows a started job
+#define AGING 2 // waiting makes a job older by this factor
+#define LENGTHCHECK 60 // seconds until the length of a running recording is read again
+
 cStatusMarkAd::cStatusMarkAd(const char *BinDir, const char *LogoDir, struct setup *Setup)
 {
     setup=Setup;
     bindir=BinDir;
     logodir=LogoDir;
     actpos=0;
+    replaying=NULL;
+    lastadmit=0;
     memset(&recs,0,sizeof(recs));
+    daemon=new cDaemonMarkAd(BinDir,LogoDir,Setup);
+    cgroup=new cCgroupMarkAd(Setup->CgroupDir);
+    supervisor=new cSupervisorMarkAd();
 }
 
 cStatusMarkAd::~cStatusMarkAd()
@@ -24,6 +35,11 @@ cStatusMarkAd::~cStatusMarkAd()
     {
         Remove(i,true);
     }
+    if (setup->Daemon) daemon->Shutdown();
+    delete supervisor;
+    delete daemon;
+    delete cgroup;
+    if (replaying) free(replaying);
 }
 
 int cStatusMarkAd::Recording()
@@ -54,8 +70,13 @@ bool cStatusMarkAd::Replaying()
 }
 
 void cStatusMarkAd::Replaying(const cControl *UNUSED(Control), const char *UNUSED(Name),
-                              const char *UNUSED(FileName), bool On)
+                              const char *FileName, bool On)
 {
+    // the scheduler prefers the replayed recording
+    if (replaying) free(replaying);
+    replaying=((On) && (FileName)) ? strdup(FileName) : NULL;
+    if (On) Schedule();
+
     if (setup->ProcessDuring!=0) return;
     if (setup->whileReplaying) return;
     if (On)
@@ -72,7 +93,55 @@ bool cStatusMarkAd::Start(const char *FileName, const char *Name, const bool Dir
 {
     if ((Direct) && (Get(FileName)!=-1)) return false;
 
-    cString cmd = cString::sprintf("\"%s\"/markad %s%s%s%s%s%s%s -l \"%s\" %s \"%s\"",
+    if (setup->Daemon)
+    {
+        cString flags = cString::sprintf("%s%s%s%s%s%s%s%s",
+                                         setup->SaveInfo ? "I" : "",
+                                         setup->GenIndex ? "G" : "",
+                                         (setup->OSDMessage || Direct) ? "O" : "",
+                                         setup->NoMargins ? "M" : "",
+                                         setup->SecondPass ? "" : "1",
+                                         Direct ? "" : "L",
+                                         setup->Verbose ? "v" : "",
+                                         setup->Log2Rec ? "R" : "");
+        // jobs started by hand are preferred, sent to the daemon in the
+        // thread of cDaemonMarkAd, a refused job is removed later
+        if (!daemon->Enqueue(FileName,Direct ? 1 : 0,flags)) return false;
+        int pos=Add(FileName,Name);
+        if (pos!=-1)
+        {
+            recs[pos].Daemon=true;
+            recs[pos].InProgress=!Direct;
+            if (getStatus(pos)) PauseAfterStart(FileName,Direct);
+        }
+        return true;
+    }
+
+    int pos=Add(FileName,Name);
+    if (pos==-1) return false;
+    recs[pos].Direct=Direct;
+    recs[pos].InProgress=!Direct;
+    recs[pos].Queued=true;
+    recs[pos].Status='Q';
+    recs[pos].Since=time(NULL);
+    Schedule();
+    // gone if markad cannot be executed
+    return (Get(FileName)!=-1);
+}
+
+bool cStatusMarkAd::exec(int Position)
+{
+    const char *FileName=recs[Position].FileName;
+    bool Direct=recs[Position].Direct;
+    char threads[32]="";
+    if (setup->MaxJobs>0)
+    {
+        // the jobs share the cpus instead of using all of them each
+        int cnt=sysconf(_SC_NPROCESSORS_ONLN)/setup->MaxJobs;
+        if (cnt<1) cnt=1;
+        snprintf(threads,sizeof(threads)," --threads=%i ",cnt);
+    }
+    cString cmd = cString::sprintf("\"%s\"/markad %s%s%s%s%s%s%s%s -l \"%s\" %s \"%s\"",
                                    bindir,
                                    setup->Verbose ? " -v " : "",
                                    setup->SaveInfo ? " -I " : "",
@@ -85,47 +154,205 @@ bool cStatusMarkAd::Start(const char *FileName, const char *Name, const bool Dir
                                    setup->NoMargins ? " -i 4 " : "",
                                    setup->SecondPass ? "" : " --pass1only ",
                                    setup->Log2Rec ? " -R " : "",
-                                   logodir,Direct ? "-O after" : "--online=2 before",
+                                   threads,logodir,Direct ? "-O after" :
+                                   recs[Position].InProgress ? "--online=2 before" : "after",
                                    FileName);
-    usleep(1000000); // wait 1 second
-    if (SystemExec(cmd)!=-1)
+    if (SystemExec(cmd)==-1) return false;
+    dsyslog("markad: executing %s",*cmd);
+    recs[Position].Queued=false;
+    recs[Position].Status=0;
+    // the pid is known when markad has written markad.pid, see Events
+    return supervisor->Watch(FileName);
+}
+
+int cStatusMarkAd::jobs()
+{
+    int cnt=0;
+    for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
     {
-        dsyslog("markad: executing %s",*cmd);
-        usleep(200000);
-        int pos=Add(FileName,Name);
-        if (getPid(pos) && getStatus(pos))
+        if ((recs[i].FileName) && (!recs[i].Daemon) && (!recs[i].Queued)) cnt++;
+    }
+    return cnt;
+}
+
+bool cStatusMarkAd::overloaded()
+{
+    // pressure stall information (linux 4.20 and later)
+    FILE *f=fopen("/proc/pressure/cpu","r");
+    if (f)
+    {
+        float avg10;
+        int ret=fscanf(f,"some avg10=%f",&avg10);
+        fclose(f);
+        if (ret==1) return (avg10>=MAXPRESSURE);
+    }
+    f=fopen("/proc/loadavg","r");
+    if (!f) return false;
+    float load;
+    int ret=fscanf(f,"%f",&load);
+    fclose(f);
+    if (ret!=1) return false;
+    return (load>=sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+int cStatusMarkAd::length(const char *FileName)
+{
+    // seconds from the size of the index, 8 bytes per frame
+    char *buf;
+    if (asprintf(&buf,"%s/index",FileName)==-1) return 0;
+    struct stat statbuf;
+    int ret=stat(buf,&statbuf);
+    free(buf);
+    if (ret==-1) return 0;
+
+    int fps=25;
+    if (asprintf(&buf,"%s/info",FileName)==-1) return 0;
+    FILE *f=fopen(buf,"r");
+    free(buf);
+    if (f)
+    {
+        char line[256];
+        while (fgets(line,sizeof(line),f))
+        {
+            if ((line[0]=='F') && (line[1]==' ')) fps=atoi(line+2);
+        }
+        fclose(f);
+    }
+    if (fps<=0) fps=25;
+    return (int) (statbuf.st_size/8/fps);
+}
+
+int cStatusMarkAd::rank(int Position, time_t Now, int *Score)
+{
+    // lower ranks first: the recording the user is replaying, jobs
+    // started by hand, finished recordings and at last recordings
+    // which would be paused right away.  Within a rank short
+    // recordings are preferred, waiting jobs get older.
+    if ((!recs[Position].LengthChecked) || ((recs[Position].InProgress) &&
+            (Now>=recs[Position].LengthChecked+LENGTHCHECK)))
+    {
+        recs[Position].Length=length(recs[Position].FileName);
+        recs[Position].LengthChecked=Now;
+    }
+    *Score=recs[Position].Length-AGING*(int) (Now-recs[Position].Since);
+    if ((replaying) && (!strcmp(replaying,recs[Position].FileName))) return 0;
+    if (recs[Position].Direct) return 1;
+    if ((recs[Position].InProgress) && (!setup->ProcessDuring)) return 3;
+    return 2;
+}
+
+void cStatusMarkAd::Schedule()
+{
+    time_t now=time(NULL);
+    for (;;)
+    {
+        int best=-1,bestrank=0,bestscore=0;
+        for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
         {
-            if (setup->ProcessDuring==0)
+            if ((!recs[i].FileName) || (!recs[i].Queued)) continue;
+            int score;
+            int r=rank(i,now,&score);
+            if ((best==-1) || (r<bestrank) || ((r==bestrank) && (score<bestscore)))
             {
-                if (!Direct)
-                {
-                    if (!setup->whileRecording)
-                    {
-                        Pause(NULL);
-                    }
-                    else
-                    {
-                        Pause(FileName);
-                    }
-                }
-                else
-                {
-                    if (!setup->whileRecording && Recording())
-                    {
-                        Pause(FileName);
-                    }
-                    if (!setup->whileReplaying && Replaying())
-                    {
-                        Pause(FileName);
-                    }
-                }
+                best=i;
+                bestrank=r;
+                bestscore=score;
             }
-        } else {
-            isyslog("markad: cannot find running process");
         }
-        return true;
+        if (best==-1) return;
+        // markad would be stopped until the recording has finished
+        if (bestrank==3) return;
+
+        int running=jobs();
+        // unlimited starts all jobs at once
+        if ((setup->MaxJobs>0) && (running))
+        {
+            if (running>=setup->MaxJobs) return;
+            // one more job only if the cpus are not saturated yet
+            if (now<(lastadmit+ADMITDELAY)) return;
+            if (overloaded()) return;
+        }
+        dsyslog("markad: starting queued job for %s (rank %i, %i)",recs[best].FileName,
+                bestrank,bestscore);
+        if (!exec(best))
+        {
+            esyslog("markad: failed starting on %s",recs[best].FileName);
+            Remove(best);
+            continue;
+        }
+        lastadmit=now;
+    }
+}
+
+bool cStatusMarkAd::Throttling()
+{
+    return ((setup->PauseMode==1) && (cgroup->Available()));
+}
+
+int cStatusMarkAd::Load(int Position)
+{
+    // same conditions as for pausing markad
+    if (setup->ProcessDuring!=0) return 0;
+    int load=0;
+    if (!setup->whileRecording)
+    {
+        load=Recording();
+    }
+    else
+    {
+        // only its own recording
+        if (recs[Position].InProgress) load++;
+    }
+    if ((!setup->whileReplaying) && (Replaying())) load++;
+    return load;
+}
+
+void cStatusMarkAd::Throttle(const char *FileName)
+{
+    // the jobs of the daemon share its cgroup, the highest level wins
+    int daemonlevel=0;
+    for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
+    {
+        if ((!recs[i].CgroupPid) || (!recs[i].Daemon) || (recs[i].ChangedbyUser)) continue;
+        int level=Load(i);
+        if (level>daemonlevel) daemonlevel=level;
+    }
+    for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
+    {
+        if (!recs[i].CgroupPid) continue;
+        if (recs[i].ChangedbyUser) continue;
+        if ((FileName) && ((!recs[i].FileName) || (strcmp(recs[i].FileName,FileName)))) continue;
+        int level=recs[i].Daemon ? daemonlevel : Load(i);
+        if (recs[i].Throttle==level) continue;
+        if (cgroup->Throttle(recs[i].CgroupPid,level)) recs[i].Throttle=level;
+    }
+}
+
+void cStatusMarkAd::PauseAfterStart(const char *FileName, const bool Direct)
+{
+    if (setup->ProcessDuring!=0) return;
+    if (!Direct)
+    {
+        if (!setup->whileRecording)
+        {
+            Pause(NULL);
+        }
+        else
+        {
+            Pause(FileName);
+        }
+    }
+    else
+    {
+        if (!setup->whileRecording && Recording())
+        {
+            Pause(FileName);
+        }
+        if (!setup->whileReplaying && Replaying())
+        {
+            Pause(FileName);
+        }
     }
-    return false;
 }
 
 void cStatusMarkAd::TimerChange(const cTimer *Timer, eTimerChange Change)
@@ -220,6 +447,44 @@ bool cStatusMarkAd::LogoExists(const cDevice *Device,const char *FileName)
     return true;
 }
 
+cReceiverMarkAd *cStatusMarkAd::AttachReceiver(const cDevice *Device, const char *FileName)
+{
+    cReceiverMarkAd *receiver=NULL;
+#if APIVERSNUM>=20301
+    cStateKey StateKey;
+    if (const cTimers *Timers = cTimers::GetTimersRead(StateKey)) {
+        for (const cTimer *Timer=Timers->First(); Timer; Timer=Timers->Next(Timer))
+#else
+    for (cTimer *Timer = Timers.First(); Timer; Timer=Timers.Next(Timer))
+#endif
+        {
+#if APIVERSNUM>=10722
+            if (Timer->Recording() && const_cast<cDevice *>(Device)->IsTunedToTransponder(Timer->Channel()) &&
+            (difftime(time(NULL),Timer->StartTime())<60))
+#else
+            if (Timer->Recording() && Device->IsTunedToTransponder(Timer->Channel()) &&
+                    (difftime(time(NULL),Timer->StartTime())<60))
+#endif
+            {
+                receiver=new cReceiverMarkAd(Timer->Channel(),FileName);
+                break;
+            }
+        }
+#if APIVERSNUM>=20301
+        StateKey.Remove();
+    }
+#endif
+
+    if (!receiver) return NULL;
+    if ((!receiver->Ok()) || (!const_cast<cDevice *>(Device)->AttachReceiver(receiver)))
+    {
+        esyslog("markad: cannot attach receiver for %s",FileName);
+        delete receiver;
+        return NULL;
+    }
+    return receiver;
+}
+
 void cStatusMarkAd::Recording(const cDevice *Device, const char *Name,
                               const char *FileName, bool On)
 {
@@ -238,13 +503,38 @@ void cStatusMarkAd::Recording(const cDevice *Device, const char *Name,
             dsyslog("markad: no logo found for %s",Name);
             return;
         }
+        cReceiverMarkAd *receiver=NULL;
+        if (setup->LiveStream) receiver=AttachReceiver(Device,FileName);
         // Start markad with recording
         if (!Start(FileName,Name,false)) {
             esyslog("markad: failed starting on %s",FileName);
         }
+        int pos=Get(FileName);
+        if (pos!=-1)
+        {
+            // a queued markad attaches to the ring when it is started
+            recs[pos].Receiver=receiver;
+        }
+        else
+        {
+            if (receiver) delete receiver;
+        }
     }
     else
     {
+        int pos=Get(FileName);
+        if ((pos!=-1) && (recs[pos].Receiver))
+        {
+            // markad reads the rest from disk
+            delete recs[pos].Receiver;
+            recs[pos].Receiver=NULL;
+        }
+        if (pos!=-1)
+        {
+            recs[pos].InProgress=false;
+            recs[pos].LengthChecked=0; // final length
+            Schedule();
+        }
         if (!setup->ProcessDuring)
         {
             if (!setup->whileRecording)
@@ -269,58 +559,27 @@ void cStatusMarkAd::Recording(const cDevice *Device, const char *Name,
 bool cStatusMarkAd::getStatus(int Position)
 {
     if (Position<0) return false;
-    if (!recs[Position].Pid) return false;
-    int ret=0;
-    char procname[256]="";
-    snprintf(procname,sizeof(procname),"/proc/%i/stat",recs[Position].Pid);
-    FILE *fstat=fopen(procname,"r");
-    if (fstat)
-    {
-        // found a running markad
-        ret=fscanf(fstat,"%*10d %*255s %c",&recs[Position].Status);
-        fclose(fstat);
-    }
-    else
+    if (recs[Position].Daemon)
     {
-        if (errno==ENOENT)
+        recs[Position].Status=daemon->Status(recs[Position].FileName);
+        if (!recs[Position].Status)
         {
-            // no such file or directory -> markad done or crashed
-            // remove filename from list
+            // job done or daemon gone
             Remove(Position);
+            return false;
         }
-    }
-    return (ret==1);
-}
-
-bool cStatusMarkAd::getPid(int Position)
-{
-    if (Position<0) return false;
-    if (!recs[Position].FileName) return false;
-    if (recs[Position].Pid) return true;
-    int ret=0;
-    char *buf;
-    if (asprintf(&buf,"%s/markad.pid",recs[Position].FileName)==-1) return false;
-
-    FILE *fpid=fopen(buf,"r");
-    if (fpid)
-    {
-        free(buf);
-        int pid;
-        ret=fscanf(fpid,"%10i\n",&pid);
-        if (ret==1) recs[Position].Pid=pid;
-        fclose(fpid);
-    }
-    else
-    {
-        if (errno==ENOENT)
+        if (!recs[Position].CgroupPid)
         {
-            // no such file or directory -> markad done or crashed
-            // remove entry from list
-            Remove(Position);
+            // all jobs of the daemon share its cgroup, the pid is known
+            // once the daemon has answered
+            pid_t pid=daemon->Pid();
+            if (cgroup->Add(pid)) recs[Position].CgroupPid=pid;
         }
-        free(buf);
+        return true;
     }
-    return (ret==1);
+    if (recs[Position].Queued) return true;
+    // the state is kept up to date by the events of the supervisor
+    return (recs[Position].Pid!=0);
 }
 
 bool cStatusMarkAd::GetNextActive(struct recs **RecEntry)
@@ -332,7 +591,8 @@ bool cStatusMarkAd::GetNextActive(struct recs **RecEntry)
 
     do
     {
-        if ((recs[actpos].FileName) && (recs[actpos].Pid))
+        if ((recs[actpos].FileName) && ((recs[actpos].Pid) || (recs[actpos].Daemon) ||
+                                        (recs[actpos].Queued)))
         {
             if (getStatus(actpos))
             {
@@ -352,11 +612,61 @@ bool cStatusMarkAd::GetNextActive(struct recs **RecEntry)
     return false;
 }
 
+void cStatusMarkAd::Events()
+{
+    struct cSupervisorMarkAd::event event;
+    bool freed=false;
+    while (supervisor->GetEvent(&event))
+    {
+        int pos=Get(event.FileName);
+        if ((pos!=-1) && (recs[pos].Daemon)) pos=-1;
+        if ((pos!=-1) && (event.Type!=cSupervisorMarkAd::eSTARTED) &&
+                (event.Type!=cSupervisorMarkAd::eLOST) && (recs[pos].Pid!=event.Pid)) pos=-1;
+        switch (event.Type)
+        {
+        case cSupervisorMarkAd::eSTARTED:
+            if (pos==-1) break;
+            dsyslog("markad: pid %i for %s",(int) event.Pid,event.FileName);
+            recs[pos].Pid=event.Pid;
+            recs[pos].Status='R';
+            if (cgroup->Add(recs[pos].Pid)) recs[pos].CgroupPid=recs[pos].Pid;
+            PauseAfterStart(event.FileName,recs[pos].Direct);
+            break;
+        case cSupervisorMarkAd::eSTOPPED:
+            if (pos!=-1) recs[pos].Status='T';
+            break;
+        case cSupervisorMarkAd::eCONTINUED:
+            if (pos!=-1) recs[pos].Status='R';
+            break;
+        case cSupervisorMarkAd::eEXITED:
+            dsyslog("markad: pid %i for %s exited",(int) event.Pid,event.FileName);
+            if (pos!=-1) Remove(pos);
+            freed=true;
+            break;
+        case cSupervisorMarkAd::eCRASHED:
+            esyslog("markad: pid %i for %s crashed",(int) event.Pid,event.FileName);
+            if (pos!=-1) Remove(pos);
+            freed=true;
+            break;
+        case cSupervisorMarkAd::eLOST:
+            isyslog("markad: cannot find running process for %s",event.FileName);
+            if (pos!=-1) Remove(pos);
+            freed=true;
+            break;
+        }
+        free(event.FileName);
+    }
+    // a finished job frees a slot
+    if (freed) Schedule();
+}
+
 void cStatusMarkAd::Check()
 {
     struct recs *tmpRecs=NULL;
     ResetActPos();
     while (GetNextActive(&tmpRecs)) ;
+    if (Throttling()) Throttle();
+    Schedule();
 }
 
 bool cStatusMarkAd::MarkAdRunning()
@@ -387,6 +697,18 @@ void cStatusMarkAd::Remove(const char *Name, bool Kill)
 
 void cStatusMarkAd::Remove(int Position, bool Kill)
 {
+    if ((Kill) && (recs[Position].Daemon) && (recs[Position].FileName))
+    {
+        dsyslog("markad: canceling job for %s",recs[Position].FileName);
+        daemon->Cancel(recs[Position].FileName);
+    }
+    if ((recs[Position].Daemon) && (recs[Position].FileName)) daemon->Forget(recs[Position].FileName);
+    if ((recs[Position].CgroupPid) && (!recs[Position].Daemon)) cgroup->Remove(recs[Position].CgroupPid);
+    if (recs[Position].Receiver) delete recs[Position].Receiver;
+    recs[Position].Receiver=NULL;
+    if (recs[Position].Progress) delete recs[Position].Progress;
+    recs[Position].Progress=NULL;
+    if ((recs[Position].FileName) && (!recs[Position].Daemon) && (!recs[Position].Queued)) supervisor->Forget(recs[Position].FileName);
     if (recs[Position].FileName) free(recs[Position].FileName);
     recs[Position].FileName=NULL;
     if (recs[Position].Name) free(recs[Position].Name);
@@ -411,6 +733,15 @@ void cStatusMarkAd::Remove(int Position, bool Kill)
     recs[Position].Status=0;
     recs[Position].Pid=0;
     recs[Position].ChangedbyUser=false;
+    recs[Position].Daemon=false;
+    recs[Position].Direct=false;
+    recs[Position].Queued=false;
+    recs[Position].Since=0;
+    recs[Position].Length=0;
+    recs[Position].LengthChecked=0;
+    recs[Position].InProgress=false;
+    recs[Position].CgroupPid=0;
+    recs[Position].Throttle=0;
 }
 
 int cStatusMarkAd::Add(const char *FileName, const char *Name)
@@ -431,6 +762,17 @@ int cStatusMarkAd::Add(const char *FileName, const char *Name)
             recs[i].Status=0;
             recs[i].Pid=0;
             recs[i].ChangedbyUser=false;
+            recs[i].Daemon=false;
+            recs[i].Direct=false;
+            recs[i].Queued=false;
+            recs[i].Since=0;
+            recs[i].Length=0;
+            recs[i].LengthChecked=0;
+            recs[i].InProgress=false;
+            recs[i].CgroupPid=0;
+            recs[i].Throttle=-1;
+            recs[i].Receiver=NULL;
+            recs[i].Progress=new cProgressMarkAd(FileName);
             return i;
         }
     }
@@ -439,48 +781,85 @@ int cStatusMarkAd::Add(const char *FileName, const char *Name)
 
 void cStatusMarkAd::Pause(const char *FileName)
 {
+    if (Throttling())
+    {
+        // slow down instead of stopping
+        Throttle(FileName);
+        return;
+    }
     for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
     {
-        if (FileName)
+        if ((!recs[i].Pid) && (!recs[i].Daemon)) continue;
+        if (recs[i].ChangedbyUser) continue;
+        if ((FileName) && ((!recs[i].FileName) || (strcmp(recs[i].FileName,FileName)))) continue;
+        if (recs[i].Daemon)
         {
-            if ((recs[i].FileName) && (!strcmp(recs[i].FileName,FileName)) &&
-                    (recs[i].Pid) && (!recs[i].ChangedbyUser))
-            {
-                dsyslog("markad: pausing pid %i",recs[i].Pid);
-                kill(recs[i].Pid,SIGTSTP);
-            }
+            dsyslog("markad: pausing job for %s",recs[i].FileName);
+            daemon->Pause(recs[i].FileName);
         }
         else
         {
-            if ((recs[i].Pid) && (!recs[i].ChangedbyUser))
-            {
-                dsyslog("markad: pausing pid %i",recs[i].Pid);
-                kill(recs[i].Pid,SIGTSTP);
-            }
+            dsyslog("markad: pausing pid %i",recs[i].Pid);
+            kill(recs[i].Pid,SIGTSTP);
         }
     }
 }
 
 void cStatusMarkAd::Continue(const char *FileName)
 {
+    if (Throttling())
+    {
+        Throttle(FileName);
+        return;
+    }
     for (int i=0; i<(MAXDEVICES*MAXRECEIVERS); i++)
     {
-        if (FileName)
+        if ((!recs[i].Pid) && (!recs[i].Daemon)) continue;
+        if (recs[i].ChangedbyUser) continue;
+        if ((FileName) && ((!recs[i].FileName) || (strcmp(recs[i].FileName,FileName)))) continue;
+        if (recs[i].Daemon)
         {
-            if ((recs[i].FileName) && (!strcmp(recs[i].FileName,FileName)) &&
-                    (recs[i].Pid) && (!recs[i].ChangedbyUser) )
-            {
-                dsyslog("markad: resume pid %i",recs[i].Pid);
-                kill(recs[i].Pid,SIGCONT);
-            }
+            dsyslog("markad: resume job for %s",recs[i].FileName);
+            daemon->Pause(recs[i].FileName,false);
         }
         else
         {
-            if ((recs[i].Pid) && (!recs[i].ChangedbyUser))
-            {
-                dsyslog("markad: resume pid %i",recs[i].Pid);
-                kill(recs[i].Pid,SIGCONT);
-            }
+            dsyslog("markad: resume pid %i",recs[i].Pid);
+            kill(recs[i].Pid,SIGCONT);
         }
     }
 }
+
+void cStatusMarkAd::Suspend(struct recs *Entry)
+{
+    if (!Entry) return;
+    if (Entry->Daemon)
+    {
+        dsyslog("markad: pausing job for %s",Entry->FileName);
+        daemon->Pause(Entry->FileName);
+    }
+    else
+    {
+        if (!Entry->Pid) return;
+        dsyslog("sending TSTP to %i",Entry->Pid);
+        kill(Entry->Pid,SIGTSTP);
+    }
+    Entry->ChangedbyUser=true;
+}
+
+void cStatusMarkAd::Resume(struct recs *Entry)
+{
+    if (!Entry) return;
+    if (Entry->Daemon)
+    {
+        dsyslog("markad: resume job for %s",Entry->FileName);
+        daemon->Pause(Entry->FileName,false);
+    }
+    else
+    {
+        if (!Entry->Pid) return;
+        dsyslog("sending CONT to %i",Entry->Pid);
+        kill(Entry->Pid,SIGCONT);
+    }
+    Entry->ChangedbyUser=true;
+}
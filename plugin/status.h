@@ -9,6 +9,11 @@
 
 #include <vdr/status.h>
 #include "setup.h"
+#include "daemon.h"
+#include "cgroup.h"
+#include "receiver.h"
+#include "progress.h"
+#include "supervisor.h"
 
 #if __GNUC__ > 3
 #define UNUSED(v) UNUSED_ ## v __attribute__((unused))
@@ -23,6 +28,17 @@ struct recs
     pid_t Pid;
     char Status;
     bool ChangedbyUser;
+    bool Daemon; // job is queued in markad daemon
+    bool Direct; // started by hand
+    bool Queued; // waiting for the scheduler
+    time_t Since; // queued since
+    int Length; // seconds, see length()
+    time_t LengthChecked; // when Length was read
+    bool InProgress; // recording still running
+    pid_t CgroupPid; // pid moved into a cgroup
+    int Throttle; // applied throttle level
+    cReceiverMarkAd *Receiver; // live stream for markad
+    cProgressMarkAd *Progress; // published by markad
 };
 
 // --- cStatusMarkAd
@@ -31,14 +47,24 @@ class cStatusMarkAd : public cStatus
 private:
     struct recs recs[MAXDEVICES*MAXRECEIVERS];
     struct setup *setup;
+    cDaemonMarkAd *daemon;
+    cCgroupMarkAd *cgroup;
+    cSupervisorMarkAd *supervisor;
 
     const char *bindir;
     const char *logodir;
 
     int actpos;
+    char *replaying; // recording replayed by the user
+    time_t lastadmit;
 
-    bool getPid(int Position);
     bool getStatus(int Position);
+    bool exec(int Position);
+    int jobs();
+    bool overloaded();
+    int length(const char *FileName);
+    int rank(int Position, time_t Now, int *Score);
+    void Schedule();
     int Recording();
     bool Replaying();
     int Get(const char *FileName, const char *Name=NULL);
@@ -47,7 +73,12 @@ private:
     void Remove(const char *Name, bool Kill=false);
     void Pause(const char *FileName);
     void Continue(const char *FileName);
+    void PauseAfterStart(const char *FileName, const bool Direct);
+    bool Throttling();
+    int Load(int Position);
+    void Throttle(const char *FileName=NULL);
     bool LogoExists(const cDevice *Device, const char *FileName);
+    cReceiverMarkAd *AttachReceiver(const cDevice *Device, const char *FileName);
 protected:
     virtual void Recording(const cDevice *Device, const char *Name, const char *FileName, bool On);
     virtual void Replaying(const cControl *Control, const char *Name, const char *FileName, bool On);
@@ -61,8 +92,11 @@ public:
         actpos=0;
     }
     void Check(void);
+    void Events(void);
     bool GetNextActive(struct recs **RecEntry);
     bool Start(const char *FileName, const char *Name, const bool Direct=false);
+    void Suspend(struct recs *Entry);
+    void Resume(struct recs *Entry);
 };
 
 #endif
@@ -0,0 +1,286 @@
+/*
+ * supervisor.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <vdr/tools.h>
+
+#include "supervisor.h"
+
+#define STARTTIMEOUT 10 // seconds markad may need to write markad.pid
+#define STATEINTERVAL 2 // seconds between checks for stopped processes
+
+cSupervisorMarkAd::cSupervisorMarkAd():cThread("markad supervisor")
+{
+    memset(&watches,0,sizeof(watches));
+    for (int i=0; i<SUPERVISOR_MAXWATCH; i++) watches[i].fd=-1;
+    eventcnt=0;
+    if (pipe2(wakeup,O_CLOEXEC|O_NONBLOCK)==-1) wakeup[0]=wakeup[1]=-1;
+}
+
+cSupervisorMarkAd::~cSupervisorMarkAd()
+{
+    Cancel(-1);
+    if (wakeup[1]!=-1)
+    {
+        if (write(wakeup[1],"x",1)) {};
+    }
+    Cancel(3);
+    for (int i=0; i<SUPERVISOR_MAXWATCH; i++) forget(&watches[i]);
+    for (int i=0; i<eventcnt; i++) free(events[i].FileName);
+    if (wakeup[0]!=-1) close(wakeup[0]);
+    if (wakeup[1]!=-1) close(wakeup[1]);
+}
+
+void cSupervisorMarkAd::push(int Type, struct watch *Watch)
+{
+    if (eventcnt>=SUPERVISOR_MAXEVENTS)
+    {
+        esyslog("markad: too many events, dropping %i for %s",Type,Watch->FileName);
+        return;
+    }
+    events[eventcnt].Type=Type;
+    events[eventcnt].Pid=Watch->Pid;
+    events[eventcnt].FileName=strdup(Watch->FileName);
+    if (events[eventcnt].FileName) eventcnt++;
+}
+
+void cSupervisorMarkAd::forget(struct watch *Watch)
+{
+    if (Watch->fd!=-1) close(Watch->fd);
+    if (Watch->FileName) free(Watch->FileName);
+    memset(Watch,0,sizeof(*Watch));
+    Watch->fd=-1;
+}
+
+bool cSupervisorMarkAd::readpid(struct watch *Watch)
+{
+    char *buf;
+    if (asprintf(&buf,"%s/markad.pid",Watch->FileName)==-1) return false;
+    FILE *fpid=fopen(buf,"r");
+    free(buf);
+    int pid=0;
+    if (fpid)
+    {
+        if (fscanf(fpid,"%10i\n",&pid)!=1) pid=0;
+        fclose(fpid);
+    }
+    if (pid>0)
+    {
+        int fd=-1;
+#ifdef SYS_pidfd_open
+        fd=syscall(SYS_pidfd_open,(pid_t) pid,0);
+#else
+        errno=ENOSYS;
+#endif
+        bool alive;
+        if (fd!=-1)
+        {
+            alive=true;
+        }
+        else
+        {
+            alive=((errno!=ESRCH) && ((kill(pid,0)!=-1) || (errno!=ESRCH)));
+        }
+        if (alive)
+        {
+            // otherwise it's the file of an old markad, ours is not there yet
+            Watch->Pid=pid;
+            Watch->fd=fd;
+            Watch->State='R';
+            push(eSTARTED,Watch);
+            return true;
+        }
+    }
+    if (time(NULL)>Watch->Since+STARTTIMEOUT)
+    {
+        push(eLOST,Watch);
+        forget(Watch);
+    }
+    return false;
+}
+
+char cSupervisorMarkAd::readstate(pid_t Pid)
+{
+    char procname[64];
+    snprintf(procname,sizeof(procname),"/proc/%i/stat",(int) Pid);
+    FILE *fstat=fopen(procname,"r");
+    if (!fstat) return 0;
+    char state=0;
+    if (fscanf(fstat,"%*10d %*255s %c",&state)!=1) state=0;
+    fclose(fstat);
+    return state;
+}
+
+void cSupervisorMarkAd::check(struct watch *Watch, bool Gone, bool State)
+{
+    if (Gone)
+    {
+        // markad removes markad.pid when it ends
+        bool crashed=false;
+        char *buf;
+        if (asprintf(&buf,"%s/markad.pid",Watch->FileName)!=-1)
+        {
+            FILE *fpid=fopen(buf,"r");
+            free(buf);
+            if (fpid)
+            {
+                int pid;
+                crashed=((fscanf(fpid,"%10i\n",&pid)==1) && (pid==Watch->Pid));
+                fclose(fpid);
+            }
+        }
+        push(crashed ? eCRASHED : eEXITED,Watch);
+        forget(Watch);
+        return;
+    }
+    if (!State) return;
+    char state=readstate(Watch->Pid);
+    if (!state) return;
+    bool stopped=((state=='T') || (state=='t'));
+    if ((stopped) && (Watch->State!='T'))
+    {
+        Watch->State='T';
+        push(eSTOPPED,Watch);
+    }
+    if ((!stopped) && (Watch->State=='T'))
+    {
+        Watch->State='R';
+        push(eCONTINUED,Watch);
+    }
+}
+
+void cSupervisorMarkAd::Action()
+{
+    time_t laststate=0;
+    while (Running())
+    {
+        struct pollfd fds[SUPERVISOR_MAXWATCH+1];
+        int watch[SUPERVISOR_MAXWATCH+1];
+        int nfds=0;
+        bool waiting=false;
+
+        fds[nfds].fd=wakeup[0];
+        fds[nfds].events=POLLIN;
+        fds[nfds].revents=0;
+        watch[nfds++]=-1;
+
+        mutex.Lock();
+        for (int i=0; i<SUPERVISOR_MAXWATCH; i++)
+        {
+            if (!watches[i].FileName) continue;
+            if (!watches[i].Pid)
+            {
+                waiting=true;
+                continue;
+            }
+            if (watches[i].fd==-1) continue;
+            fds[nfds].fd=watches[i].fd;
+            fds[nfds].events=POLLIN;
+            fds[nfds].revents=0;
+            watch[nfds++]=i;
+        }
+        mutex.Unlock();
+
+        // markad.pid is written shortly after the start
+        int ret=poll(fds,nfds,waiting ? 100 : STATEINTERVAL*1000);
+        if ((ret==-1) && (errno!=EINTR))
+        {
+            esyslog("markad: poll failed (%i)",errno);
+            cCondWait::SleepMs(1000);
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            char buf[64];
+            while (read(wakeup[0],buf,sizeof(buf))>0);
+        }
+        if (!Running()) break;
+
+        time_t now=time(NULL);
+        bool state=(now>=laststate+STATEINTERVAL);
+        if (state) laststate=now;
+
+        mutex.Lock();
+        bool exited[SUPERVISOR_MAXWATCH];
+        memset(exited,0,sizeof(exited));
+        for (int n=1; n<nfds; n++)
+        {
+            // the watch may have been replaced meanwhile
+            if ((fds[n].revents) && (watches[watch[n]].fd==fds[n].fd)) exited[watch[n]]=true;
+        }
+        for (int i=0; i<SUPERVISOR_MAXWATCH; i++)
+        {
+            struct watch *w=&watches[i];
+            if (!w->FileName) continue;
+            if (!w->Pid)
+            {
+                readpid(w);
+                continue;
+            }
+            bool gone=exited[i];
+            if ((w->fd==-1) && (kill(w->Pid,0)==-1) && (errno==ESRCH)) gone=true;
+            check(w,gone,state);
+        }
+        mutex.Unlock();
+    }
+}
+
+bool cSupervisorMarkAd::Watch(const char *FileName)
+{
+    if (!FileName) return false;
+    if (wakeup[0]==-1) return false;
+    bool ret=false;
+    mutex.Lock();
+    for (int i=0; i<SUPERVISOR_MAXWATCH; i++)
+    {
+        if ((watches[i].FileName) && (!strcmp(watches[i].FileName,FileName))) forget(&watches[i]);
+    }
+    for (int i=0; i<SUPERVISOR_MAXWATCH; i++)
+    {
+        if (watches[i].FileName) continue;
+        watches[i].FileName=strdup(FileName);
+        watches[i].Pid=0;
+        watches[i].fd=-1;
+        watches[i].Since=time(NULL);
+        ret=(watches[i].FileName!=NULL);
+        break;
+    }
+    mutex.Unlock();
+    if (!ret) return false;
+    if (!Active()) Start();
+    if (write(wakeup[1],"x",1)) {};
+    return true;
+}
+
+void cSupervisorMarkAd::Forget(const char *FileName)
+{
+    if (!FileName) return;
+    mutex.Lock();
+    for (int i=0; i<SUPERVISOR_MAXWATCH; i++)
+    {
+        if ((watches[i].FileName) && (!strcmp(watches[i].FileName,FileName))) forget(&watches[i]);
+    }
+    mutex.Unlock();
+    if (wakeup[1]!=-1)
+    {
+        if (write(wakeup[1],"x",1)) {};
+    }
+}
+
+bool cSupervisorMarkAd::GetEvent(struct event *Event)
+{
+    if (!Event) return false;
+    // called often from the main thread, no system call without events
+    cMutexLock lock(&mutex);
+    if (!eventcnt) return false;
+    *Event=events[0];
+    eventcnt--;
+    memmove(&events[0],&events[1],eventcnt*sizeof(struct event));
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+ * supervisor.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+#ifndef __supervisor_h_
+#define __supervisor_h_
+
+#include <sys/types.h>
+#include <vdr/thread.h>
+#include <vdr/device.h>
+
+#define SUPERVISOR_MAXWATCH (MAXDEVICES*MAXRECEIVERS)
+#define SUPERVISOR_MAXEVENTS 64
+
+// --- cSupervisorMarkAd
+// watches the started markad processes in a thread. The pid is taken
+// from markad.pid as soon as markad has written it, the end is noticed
+// with a pidfd (or kill(pid,0) without pidfd support), stopping and
+// continuing from /proc/<pid>/stat. The main thread just fetches the
+// events with GetEvent.
+class cSupervisorMarkAd : public cThread
+{
+public:
+    enum { eSTARTED=1, eSTOPPED, eCONTINUED, eEXITED, eCRASHED, eLOST };
+    struct event
+    {
+        int Type;
+        pid_t Pid;
+        char *FileName;            // to be freed by the caller
+    };
+private:
+    struct watch
+    {
+        char *FileName;
+        pid_t Pid;
+        int fd;                    // pidfd, -1 if not available
+        char State;                // from /proc/<pid>/stat
+        time_t Since;
+    } watches[SUPERVISOR_MAXWATCH];
+    struct event events[SUPERVISOR_MAXEVENTS];
+    int eventcnt;
+    cMutex mutex;
+    int wakeup[2];
+    void push(int Type, struct watch *Watch);
+    void forget(struct watch *Watch);
+    bool readpid(struct watch *Watch);
+    char readstate(pid_t Pid);
+    void check(struct watch *Watch, bool Gone, bool State);
+protected:
+    virtual void Action();
+public:
+    cSupervisorMarkAd();
+    ~cSupervisorMarkAd();
+    bool Watch(const char *FileName);
+    void Forget(const char *FileName);
+    bool GetEvent(struct event *Event);
+};
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * progressrec.h: A plugin/program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __progressrec_h_
+#define __progressrec_h_
+
+#include <stdint.h>
+
+// Record in markad.progress, written by markad (cMarkAdProgress) and
+// read by the plugin (cProgressMarkAd). Seq is odd while the record is
+// written, readers copy the record and retry if Seq was odd or has
+// changed.
+
+#define PROGRESS_FILE "markad.progress"
+#define PROGRESS_MAGIC 0x50474d4d // "MMGP"
+#define PROGRESS_VERSION 1
+
+typedef struct MarkAdProgress
+{
+    int Magic;
+    int Version;
+    volatile unsigned int Seq;
+    int Pid;
+    int Pass;                      // 1-3, 0 not started, -1 finished
+    int File;                      // current file (segment) of the recording
+    int Frame;
+    int Percent;
+    int FramesPerSecond;           // processed frames per second
+    int KBytesPerSecond;           // read from the recording
+    int Eta;                       // seconds till the pass is done, -1 unknown
+    int64_t Updated;               // time of the last update
+} MarkAdProgress;
+
+#endif
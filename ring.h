@@ -0,0 +1,48 @@
+/*
+ * ring.h: A plugin/program for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __ring_h_
+#define __ring_h_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Shared memory ring for live recordings. The plugin (cReceiver) writes
+// the TS packets of the recorded channel, markad reads them instead of
+// re-reading the recording from disk. The writer never waits, if markad
+// is too slow it gets detached and continues from disk.
+
+#define MARKAD_RING_MAGIC  0x4d415231
+#define MARKAD_RING_PACKET 188
+#define MARKAD_RING_SIZE   (MARKAD_RING_PACKET*89240) // ~16MB
+#define MARKAD_RING_MARGIN (MARKAD_RING_PACKET*512)   // kept free to the writer when attaching
+
+#define MARKAD_RING_DONE 1 // recording stopped
+
+struct markad_ring
+{
+    uint32_t magic;
+    uint32_t size;
+    volatile uint64_t head;     // bytes written
+    volatile uint64_t tail;     // bytes read, only valid when attached
+    volatile uint32_t attached; // set by reader, cleared by writer on overflow
+    volatile uint32_t flags;
+    unsigned char data[MARKAD_RING_SIZE];
+};
+
+// plugin and markad derive the name from the recording directory
+static inline bool markad_ring_name(const char *Directory, char *Name, size_t Size)
+{
+    struct stat statbuf;
+    if (stat(Directory,&statbuf)==-1) return false;
+    snprintf(Name,Size,"/markad-%llx-%llx",(unsigned long long) statbuf.st_dev,
+             (unsigned long long) statbuf.st_ino);
+    return true;
+}
+
+#endif